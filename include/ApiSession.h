@@ -0,0 +1,77 @@
+#ifndef APISESSION_H
+#define APISESSION_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <ESP8266HTTPClient.h>
+
+#include "HttpBodyReader.h"
+#include "TextBuffer.h"
+
+#define API_HTTP_TIMEOUT 2000 // ms, caps how long one request can hold up a loop() pass
+#define API_URL_SIZE 96       // bytes for "http://<server><path>"
+#define API_AUTH_SIZE 264     // bytes for "Bearer <JWT>", see TimelineManager::token
+#define API_HOST_SIZE 64      // bytes for the server the open connection goes to
+
+/**
+ * @brief One keep-alive HTTP connection to the magic poi server, shared by every API call.
+ *
+ * Requests reuse the open TCP connection when the server allows it, so a full sync costs
+ * one connection setup instead of one per request. The connection lives in the
+ * HTTPClient: `HTTPClient::begin()` is only called for the first request to a server, or
+ * once the connection has been closed, and later requests just change its URL. If a kept-alive connection turns out
+ * to have been closed by the server the request is sent again on a fresh one. The latency
+ * of each request (from sending it to having the response headers) is recorded, and the
+ * server's clock is tracked from the `Date` header of each response.
+ *
+ * Only one response can be open at a time: read it through `http()`, or with `readBody()`
+ * or `read()`, then call `end()`.
+ *
+ * The URL and `Authorization` header are built in fixed buffers and the body is sent from
+ * the caller's text, so a request allocates nothing that outlives it. Response bodies are
+ * read into the caller's buffer or parsed straight off the connection, since the session
+ * can be passed to `deserializeJson()` as a stream.
+ */
+class ApiSession {
+public:
+    ApiSession(WiFiClient& client, const char* serverIP);
+    int get(const char* path, const char* token);
+    int post(const char* path, const char* json);
+    HTTPClient& http();
+    int readBody(char* buffer, size_t size);
+    int read();
+    size_t readBytes(char* buffer, size_t length);
+    void end();
+    void close();
+    bool serverTime(uint32_t& epoch);
+
+    uint32_t requests();
+    uint32_t connects();
+    uint32_t reconnects();
+    uint32_t lastLatency();
+    uint32_t averageLatency();
+    uint32_t maxLatency();
+
+private:
+    int send(const char* method, const char* path, const char* payload, const char* token);
+    static bool parseHttpDate(const char* date, uint32_t& epoch);
+
+    WiFiClient& client;
+    const char* serverIP;
+    HTTPClient httpClient;
+    HttpBodyReader body; // the current response body, for read()
+    char url[API_URL_SIZE];
+    char authorization[API_AUTH_SIZE];
+    char connectedHost[API_HOST_SIZE]; // server httpClient was begun for, empty after close()
+
+    uint32_t requestCount = 0;
+    uint32_t connectCount = 0;   // TCP connections opened
+    uint32_t reconnectCount = 0; // requests resent after a kept-alive connection was lost
+    uint32_t lastLatencyUs = 0;
+    uint32_t maxLatencyUs = 0;
+    uint64_t totalLatencyUs = 0;
+    uint32_t dateEpoch = 0;     // server time from the last Date header, 0 if none yet
+    unsigned long dateMillis = 0; // millis() when it was received
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef CLOCKSYNC_H
+#define CLOCKSYNC_H
+
+#include <Arduino.h>
+#include <limits.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+#define CLOCK_SYNC_PORT 4210            // UDP port used by leader and followers
+#define CLOCK_SYNC_MAGIC 0x5343504D     // "MPCS" little endian
+#define CLOCK_SYNC_VERSION 1
+#define CLOCK_BEACON_INTERVAL 1000      // ms between leader beacons
+#define CLOCK_REQUEST_INTERVAL 1000     // ms between follower time requests
+#define CLOCK_LEADER_TIMEOUT 5000       // ms without hearing the leader before another may take over
+#define CLOCK_SYNC_SAMPLES 8            // recent exchanges kept, the one with the least delay is used
+#define CLOCK_SYNC_MIN_SAMPLES 4        // exchanges needed before the clock counts as synced
+#define CLOCK_SYNC_MAX_DELAY 10000      // us, round trips slower than this are not trusted to lock
+#define CLOCK_DRIFT_MIN_SPAN 10000000   // us between the two offsets a drift estimate is taken from
+
+#ifndef CLOCK_SYNC_LEADER
+#define CLOCK_SYNC_LEADER false         // define as true in secrets.h on the one poi that leads
+#endif
+
+#ifndef CLOCK_LEADER_MAX_SLEEP
+#define CLOCK_LEADER_MAX_SLEEP 10       // ms the leader may sleep between polls, see maxSleep()
+#endif
+
+/**
+ * @brief Clock sync packet, the same for every message type. All fields little endian.
+ *
+ * A follower sends a request with `originate` set to its own clock. The leader replies with
+ * `originate` echoed, `receive` set to its clock when the request arrived and `transmit` to
+ * its clock when the response was sent. Beacons carry only `transmit`. Times are in
+ * microseconds.
+ */
+struct __attribute__((packed)) ClockPacket {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t type;
+    uint16_t sequence;
+    uint64_t originate;
+    uint64_t receive;
+    uint64_t transmit;
+};
+
+/**
+ * @brief Shares one playback clock between poi on the same LAN.
+ *
+ * One device (or `tools/clock_sync.py leader` on a computer) is the leader: it broadcasts a
+ * beacon every second and answers time requests. Every other device follows the first
+ * leader it hears, sending it a request each second and working out the offset between the
+ * two clocks from the round trip, as NTP does. The exchange with the least delay of the
+ * last few is used, since its offset has the smallest error, and the drift between the two
+ * crystals is estimated from offsets at least ten seconds apart so the clock stays on
+ * between exchanges. The leader's own clock is the shared clock.
+ *
+ * Call `update()` on every `loop()` pass; it handles any waiting packets and never blocks.
+ * `maxSleep()` says how long the loop may sleep before packets would be timestamped late.
+ *
+ * @see TimelineManager::setClock() - Plays timelines on the shared clock.
+ */
+class ClockSync {
+public:
+    enum PacketType : uint8_t {
+        Beacon = 1,
+        Request = 2,
+        Response = 3
+    };
+
+    bool begin(bool leader);
+    void stop();
+    bool started();
+    void update();
+    unsigned long maxSleep();
+    bool leader();
+    bool synced();
+    uint16_t locks();
+    uint64_t localMicros();
+    uint64_t sharedMicros();
+    unsigned long sharedMillis();
+    int64_t offset();
+    float drift();
+    uint32_t roundTrip();
+    uint32_t exchanges();
+    void report(Print& out);
+
+private:
+    struct Sample {
+        uint64_t local;  // follower clock at the middle of the exchange
+        int64_t offset;  // leader clock minus follower clock
+        uint32_t delay;  // round trip, less the leader's processing time
+    };
+
+    void handlePacket(const ClockPacket& packet, uint64_t arrived);
+    void sendPacket(IPAddress address, uint16_t port, ClockPacket& packet);
+    void addSample(const Sample& sample);
+
+    WiFiUDP udp;
+    bool isStarted = false;
+    bool bindFailed = false;          // the last `begin()` could not open the port
+    unsigned long lastBindAttempt = 0; // millis() of that attempt
+    bool isLeader = false;
+    bool leaderKnown = false;
+    IPAddress leaderAddress;
+    uint16_t leaderPort = CLOCK_SYNC_PORT;
+    uint16_t sequence = 0;
+    unsigned long lastSent = 0;    // millis() of the last beacon or request
+    unsigned long leaderHeard = 0; // millis() of the last packet from the leader
+    bool awaitingResponse = false; // a request is out and its response is not yet in
+
+    uint32_t lastMicros = 0;   // micros() when localMicros() last ran
+    uint64_t localHigh = 0;    // micros() wraps counted into the upper bits
+
+    Sample samples[CLOCK_SYNC_SAMPLES];
+    uint8_t sampleCount = 0;
+    uint8_t nextSample = 0;
+    uint32_t exchangeCount = 0;
+    bool ringLocked = false;   // the samples have locked the clock to the current leader
+    uint16_t lockCount = 0;
+    Sample best = {0, 0, 0};   // the sample the clock runs from
+    Sample anchor = {0, 0, 0}; // earlier sample the drift is measured against
+    bool haveDrift = false;
+    float driftRate = 0;       // leader clock rate minus ours, e.g. 0.00002 for 20 ppm
+};
+
+#endif
@@ -2,42 +2,73 @@
 #define colourPATTERNS_H
 
 #include <Arduino.h>
+#include <limits.h>
+#include "LedOutput.h"
 
+// Colours as a bitmask of the LEDs that are on:
+#define COLOUR_OFF 0x0
+#define COLOUR_RED 0x1
+#define COLOUR_GREEN 0x2
+#define COLOUR_BLUE 0x4
+#define COLOUR_YELLOW (COLOUR_RED | COLOUR_GREEN)
+#define COLOUR_CYAN (COLOUR_GREEN | COLOUR_BLUE)
+#define COLOUR_MAGENTA (COLOUR_RED | COLOUR_BLUE)
+#define COLOUR_WHITE (COLOUR_RED | COLOUR_GREEN | COLOUR_BLUE)
+
+#define LED_PWM_RANGE 1023 // analogWrite() full scale: 10 bits, so fades stay smooth when dim
+#define FADE_STEP_MS 10    // ms between brightness updates while a pattern fades
+
+#define PATTERN_COUNT 15 // patterns 0-13, and 14 which is off
+#define PATTERN_OFF 14   // shown for any choice outside 0-13
+
+/**
+ * @brief One step of a pattern: a colour, held for a time.
+ */
+struct PatternFrame {
+    uint8_t colour;    // COLOUR_* bitmask
+    uint16_t duration; // ms, or 0 to hold for as long as the pattern is shown
+};
+
+/**
+ * @brief A pattern: its frames, played in order and repeated.
+ */
+struct Pattern {
+    const PatternFrame* frames;
+    uint8_t count;
+    bool fade; // blend each frame's colour into the next over its duration, with PWM
+};
+
+/**
+ * @brief Shows the colour patterns a timeline signal picks.
+ *
+ * Every pattern is a constant table of frames in ColourPatterns.cpp, so a new pattern is a
+ * new table rather than new code. Each pattern keeps its own place in its table and starts
+ * from its first frame when it is picked, so poi that switch on the same timeline event
+ * flash in step. A fading pattern's brightness is worked out from the time into the frame,
+ * so it looks the same however often it is drawn.
+ */
 class ColourPatterns {
 public:
     ColourPatterns(int redPin, int greenPin, int bluePin); // Constructor that takes pin numbers
 
     void runLoading();
     void changeColours(int choice);
+    unsigned long nextChange(int choice);
+    void report(Print& out);
 
 private:
-    void Red();
-    void Green();
-    void Blue();
-    void Yellow();
-    void Cyan();
-    void Magenta();
-    void White();
-    void Fade();
-    void StrobePlus();
-    void RGBStrobe();
-    void Rainbow();
-    void Halfstrobe();
-    void BGStrobe();
-    void GRStrobe();
-    void Off();
-
-    int redLed;
-    int greenLed;
-    int blueLed;
-    
-    unsigned long previousMillis = 0;
-    int rainbowWay = 0;
-    int threeWay = 0;
-    int ledState = LOW;
-    bool upDownFade = false;
-    unsigned int fadeSpeed = 500;
-    unsigned long interval = 100;
+    struct PatternState {
+        uint8_t frame;           // index of the frame showing
+        unsigned long frameStart; // millis() the frame was due to start
+    };
+
+    static uint8_t patternIndex(int choice);
+    void showBlend(uint8_t from, uint8_t to, uint8_t mix);
+
+    LedOutput output;
+
+    PatternState states[PATTERN_COUNT] = {};
+    int activePattern = -1; // pattern showing, -1 before the first
 };
 
 #endif // colourPATTERNS_H
@@ -0,0 +1,56 @@
+#ifndef EVENTWINDOW_H
+#define EVENTWINDOW_H
+
+#include <Arduino.h>
+#include "Storage.h"
+
+#include "TimelineFile.h"
+
+#define EVENT_WINDOW_SIZE 32  // events held in RAM
+#define EVENT_WINDOW_REFILL 16 // events read from flash per refill
+
+/**
+ * @brief A small RAM ring buffer of upcoming events, streamed from a binary timeline file.
+ *
+ * The timeline can be read from flash, or from a copy of the file already in RAM (see
+ * TimelineCache).
+ *
+ * The window always holds the next events after the playback cursor. When playback reaches
+ * the end of the timeline the window keeps reading from the start, so the first events of
+ * the next pass are already buffered when playback loops. RAM use is fixed at
+ * `EVENT_WINDOW_SIZE` records whatever the length of the timeline.
+ */
+class EventWindow {
+public:
+    bool load(const char* path);
+    bool load(const uint8_t* image, size_t size);
+    void unload();
+    uint16_t size();
+    uint32_t duration();
+
+    const TimelineRecord* current();
+    const TimelineRecord* following();
+    uint16_t position();
+    void advance();
+    void rewind();
+    int seek(long ms, TimelineRecord& active);
+    void refill();
+
+private:
+    bool openReader(TimelineReader& reader);
+    bool fill();
+    bool readAhead(TimelineReader& reader, uint8_t maxRecords);
+
+    char path[32];
+    const uint8_t* image = nullptr; // in-RAM timeline, used instead of path when set
+    size_t imageSize = 0;
+    TimelineRecord ring[EVENT_WINDOW_SIZE];
+    uint8_t head = 0;        // ring slot of the event at the cursor
+    uint8_t buffered = 0;    // events in the ring
+    uint16_t cursor = 0;     // index of the next event to fire; eventCount at the end of a pass
+    TimelinePosition nextRead; // where the event after the last buffered one is decoded from
+    uint16_t eventCount = 0;
+    uint32_t passDuration = 0;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <Arduino.h>
+
+#define HISTOGRAM_BUCKETS 64 // two per power of two, so the whole range of uint32_t fits
+
+/**
+ * @brief Counts values in fixed buckets, for percentiles without keeping the samples.
+ *
+ * Values 0-3 have a bucket each; above that every power of two is split into two buckets,
+ * so a percentile is reported as the top of its bucket, at most 50% above the true value.
+ * `add()` is a few instructions and the histogram never allocates, so it can stay on in a
+ * running show.
+ */
+class Histogram {
+public:
+    void add(uint32_t value);
+    void clear();
+    uint32_t count();
+    uint32_t min();
+    uint32_t max();
+    uint32_t mean();
+    uint32_t percentile(uint8_t percent);
+    void report(Print& out, const char* name, const char* unit);
+
+private:
+    static uint8_t bucket(uint32_t value);
+    static uint32_t bucketTop(uint8_t index);
+
+    uint32_t counts[HISTOGRAM_BUCKETS] = {};
+    uint32_t total = 0;
+    uint64_t sum = 0;
+    uint32_t lowest = UINT32_MAX;
+    uint32_t highest = 0;
+};
+
+#endif
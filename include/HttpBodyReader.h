@@ -0,0 +1,41 @@
+#ifndef HTTPBODYREADER_H
+#define HTTPBODYREADER_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+#define HTTP_CHUNK_SIZE_DIGITS 8 // most hex digits in a chunk size line, enough for any chunk
+
+/**
+ * @brief Reads an HTTP response body straight from the connection stream.
+ *
+ * Handles both `Content-Length` and chunked transfer encoding, and never blocks: `read()`
+ * only returns what has already arrived. Use with `HTTPClient::getStreamPtr()`.
+ */
+class HttpBodyReader {
+public:
+    void begin(WiFiClient* stream, int contentLength, bool chunked);
+    int read(uint8_t* buffer, size_t size);
+    bool finished();
+    bool failed();
+
+private:
+    enum State : uint8_t {
+        Body,
+        ChunkSize,
+        ChunkExtension,
+        ChunkData,
+        ChunkDataEnd,
+        Trailer,
+        Finished,
+        Failed
+    };
+
+    WiFiClient* stream = nullptr;
+    State state = Finished;
+    int32_t remaining = 0; // -1: read until the server closes the connection
+    uint8_t chunkSizeDigits = 0;
+    uint8_t trailerLineLength = 0;
+};
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef JWTTOKEN_H
+#define JWTTOKEN_H
+
+#include <Arduino.h>
+
+#define JWT_REFRESH_MARGIN 60 // seconds before expiry at which the token is renewed
+
+bool jwtNumericClaim(const char* token, const char* claim, uint32_t& value);
+
+#endif
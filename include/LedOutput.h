@@ -0,0 +1,48 @@
+#ifndef LEDOUTPUT_H
+#define LEDOUTPUT_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Drives the red, green and blue LEDs, writing only when what they show changes.
+ *
+ * On/off colours are written to the GPIO output register in one store, so all three
+ * channels switch in the same instant and a strobe never flashes an in-between colour.
+ * PWM duties go through `analogWrite()`, only for the channels that changed. Every write
+ * that was needed is counted, as is every one skipped because the LEDs already showed it.
+ *
+ * @note Pins above GPIO15 are not in the output register; if one is used, on/off colours
+ *       fall back to `digitalWrite()`.
+ */
+class LedOutput {
+public:
+    LedOutput(int redPin, int greenPin, int bluePin);
+
+    void begin();
+    void write(uint8_t colour);
+    void writeDuty(uint16_t red, uint16_t green, uint16_t blue);
+
+    uint32_t writes();
+    uint32_t skips();
+    void report(Print& out);
+
+private:
+    enum Mode : uint8_t {
+        Unknown, // as left by whatever drove the pins before
+        Digital,
+        Pwm
+    };
+
+    int pins[3];
+    uint32_t pinBits[3] = {0, 0, 0}; // each pin's bit in the output register
+    uint32_t registerMask = 0;       // all three, or 0 if any is out of its reach
+
+    Mode mode = Unknown;
+    uint8_t lastColour = 0;
+    uint16_t lastDuty[3] = {0, 0, 0};
+
+    uint32_t writeCount = 0;
+    uint32_t skipCount = 0;
+};
+
+#endif
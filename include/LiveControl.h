@@ -0,0 +1,81 @@
+#ifndef LIVECONTROL_H
+#define LIVECONTROL_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#include "ColourPatterns.h"
+#include "LoopScheduler.h"
+#include "TimelineManager.h"
+
+#define LIVE_CONTROL_PATH "/live" // WebSocket URL on the local API's server
+#define LIVE_MAX_CLIENTS 2        // controllers connected at once; the oldest is closed beyond that
+
+/**
+ * @brief WebSocket channel for controlling the poi live, e.g. from a GUI on a laptop.
+ *
+ * Connect to `ws://<poi>/live` (port 80, the LocalApi server) and send binary frames of
+ * a command byte, a sequence byte the reply echoes, and the command's arguments,
+ * little-endian:
+ *
+ * | Command | Bytes         | Does                                                     |
+ * |---------|---------------|----------------------------------------------------------|
+ * | 0 echo  | 0, seq, any   | nothing: the frame comes straight back, see below        |
+ * | 1       | 1, seq, p     | shows pattern p now, until the timeline's next event     |
+ * | 2       | 2, seq, n:u32 | switches to timeline n (up to 7 digits), if on flash     |
+ * | 3       | 3, seq        | starts playback from where it was stopped                |
+ * | 4       | 4, seq        | stops playback, holding the colour showing               |
+ * | 5       | 5, seq, ms:u32| plays from ms into the timeline                          |
+ *
+ * Every command is answered with `command | 0x80, seq, result` (a Result). An echo frame
+ * is answered with the whole frame, first byte `0x80`, so a client can put its send time
+ * in it and measure the round trip without the poi's clock. Patterns, play and stop are
+ * carried out in the WebSocket callback, as the frame arrives. A switch or a seek reads
+ * flash and changes which events play, so it waits for `update()` in `loop()`, and is
+ * answered from there; the callback wakes `loop()` with LoopScheduler::wake() rather than
+ * leaving it asleep for up to LOOP_MAX_SLEEP.
+ */
+class LiveControl {
+public:
+    enum Command : uint8_t {
+        Echo,
+        Pattern,
+        Switch,
+        Play,
+        Stop,
+        Seek
+    };
+
+    enum Result : uint8_t {
+        Ok,
+        BadFrame,   // unknown command, or arguments missing
+        NoTimeline, // nothing loaded to play, or no such timeline on flash
+        Busy        // a switch or seek is already waiting
+    };
+
+    LiveControl(TimelineManager& manager, ColourPatterns& patterns, LoopScheduler& scheduler);
+    AsyncWebHandler* handler();
+    bool update();
+    const char* switchedNumber();
+
+private:
+    void onEvent(AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t length);
+    Result run(AsyncWebSocketClient* client, const uint8_t* frame, size_t length);
+    void answer(uint32_t clientId, uint8_t command, uint8_t sequence, Result result);
+    static void reply(AsyncWebSocketClient* client, uint8_t command, uint8_t sequence, Result result);
+
+    TimelineManager& manager;
+    ColourPatterns& patterns;
+    LoopScheduler& scheduler;
+    AsyncWebSocket socket;
+    bool switchWaiting = false;   // a switch for update() to carry out
+    uint32_t switchClient = 0;    // client the switch is answered to
+    uint8_t switchSequence = 0;
+    char switchNumber[8] = "";
+    bool seekWaiting = false;     // a seek for update() to carry out
+    uint32_t seekClient = 0;
+    uint8_t seekSequence = 0;
+    uint32_t seekTo = 0;          // ms into the timeline
+};
+
+#endif
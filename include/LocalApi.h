@@ -0,0 +1,61 @@
+#ifndef LOCALAPI_H
+#define LOCALAPI_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#include "TimelineManager.h"
+#include "TimelineSync.h"
+#include "TimelineUpload.h"
+
+#define LOCAL_API_PORT 80 // HTTP port the poi serve the local API on
+
+/**
+ * @brief HTTP API on the poi themselves, for the LAN: timelines can be pushed from a phone
+ *        or laptop without going through the magic poi server, so a venue needs no
+ *        internet.
+ *
+ * - `POST /api/timeline?number=N` with the timeline JSON as the body (as served by
+ *   `load-timeline`, sent as `Content-Type: application/json`) saves it as timeline N.
+ *   Add `&play=1` to switch to it once it is saved. The body is parsed as it arrives and
+ *   its events staged on flash (TimelineUpload), so no more than one TCP segment of it is
+ *   ever in RAM. The reply, `202 Accepted`, comes once the body is in; the timeline is then
+ *   compiled from `loop()`, which takes a few passes.
+ * - `GET /api/status` reports the last upload, so a client can tell when it is ready:
+ *   `{"upload": "done", "number": "N", "received": 200, "compiled": 189, "ms": 120}`.
+ *
+ * Uploads are refused with `503` while a TimelineSync is running, since both write the
+ * same files, and with `409` while another upload is in progress. An uploaded timeline
+ * has no version in the TimelineCatalog, so the next sync replaces it if the server has
+ * a timeline with the same number.
+ *
+ * The server runs on ESPAsyncWebServer, whose callbacks run when `loop()` yields, never in
+ * the middle of it; they only parse and append, and `update()` does the rest.
+ */
+class LocalApi {
+public:
+    LocalApi(TimelineManager& manager, TimelineSync& sync);
+    void addHandler(AsyncWebHandler* handler);
+    void begin();
+    bool started();
+    bool update();
+    bool busy();
+    bool compiling();
+    const char* uploadedNumber();
+
+private:
+    void receiveTimeline(AsyncWebServerRequest* request, uint8_t* data, size_t length, size_t index, size_t total);
+    void finishUpload(AsyncWebServerRequest* request);
+    void sendStatus(AsyncWebServerRequest* request);
+    static bool validNumber(const char* number);
+
+    TimelineManager& manager;
+    TimelineSync& sync;
+    AsyncWebServer server;
+    TimelineUpload upload;
+    AsyncWebServerRequest* uploader = nullptr; // request the upload belongs to, only compared
+    bool playAfterUpload = false;
+    bool isStarted = false;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef LOOPSCHEDULER_H
+#define LOOPSCHEDULER_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#define LOOP_MAX_SLEEP 50             // ms, longest sleep, so switch presses and Wi-Fi changes are noticed
+#define WIFI_OFFLINE_TIMEOUT 60000    // ms without Wi-Fi during playback before the modem is switched off
+
+/**
+ * @brief Lets `loop()` sleep until something is next due instead of spinning.
+ *
+ * Each pass, everything that runs from `loop()` says when it next needs to run with
+ * `wakeBy()` or `wakeIn()`: the timeline's next event, the active pattern's next frame, the
+ * clock sync's next packet. `sleep()` then waits until the earliest of them, and at most
+ * `LOOP_MAX_SLEEP`, in `delay()`, where the CPU idles in the SDK with interrupts and Wi-Fi
+ * still running. Forced light sleep is not used, as `millis()` stops during it and playback
+ * would fall behind the other poi. Network callbacks that leave work for `loop()` call
+ * `wake()` to cut the sleep short.
+ *
+ * During offline playback the Wi-Fi modem, the biggest drain on the battery, can be
+ * switched off with `radioOff()` and back on with `radioOn()`.
+ */
+class LoopScheduler {
+public:
+    void wakeBy(unsigned long deadline);
+    void wakeIn(unsigned long wait);
+    void wake();
+    void sleep();
+
+    void radioOff();
+    void radioOn();
+    bool radioSleeping();
+
+    void report(Print& out);
+
+private:
+    bool wakeSet = false;
+    unsigned long wakeAt = 0;     // millis() the next pass is due, if wakeSet
+    volatile bool woken = false;  // set by wake(), from a callback, until the next sleep()
+
+    bool radioAsleep = false;
+
+    uint32_t passes = 0;          // loop() passes since the last report
+    uint32_t sleeps = 0;          // passes that slept
+    unsigned long sleptMs = 0;    // time spent asleep since the last report
+    unsigned long reportStart = 0;
+};
+
+#endif
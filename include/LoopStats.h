@@ -0,0 +1,48 @@
+#ifndef LOOPSTATS_H
+#define LOOPSTATS_H
+
+#include <Arduino.h>
+
+#include "Histogram.h"
+
+#define STATS_HEAP_INTERVAL 1000 // ms between free heap samples; finding the largest block walks the heap
+
+/**
+ * @brief Histograms of what the firmware spends its time on, kept for the whole show.
+ *
+ * The hot paths add to these as they run: `loop()` its period and the cost of the playback
+ * branch, TimelineManager the lateness of each event, ApiSession each request and Storage
+ * each flash operation. Adding a value costs a few instructions and nothing is allocated,
+ * so the histograms are always on; the `stats` serial command prints them.
+ *
+ * Short times are measured with `ESP.getCycleCount()` and reported in ns, the rest with
+ * `micros()`.
+ */
+class LoopStats {
+public:
+    void loopStarted();
+    uint32_t startTiming();
+    void endPlayback(uint32_t started);
+    void sampleHeap();
+    void clear();
+    void report(Print& out);
+
+    Histogram loopPeriod; // us from one loop() pass to the next
+    Histogram playback;   // ns spent in checkTimelineData() and changeColours()
+    Histogram lateness;   // ms each timeline event fired after its time
+    Histogram http;       // us per API request, headers received
+    Histogram flash;      // us per flash open, read or write
+    Histogram freeHeap;   // bytes of free heap
+    Histogram maxBlock;   // bytes in the largest free block
+
+private:
+    uint32_t lastLoopStart = 0;
+    bool looping = false;
+    unsigned long lastHeapSample = 0;
+    bool heapSampled = false;
+    unsigned long since = 0; // millis() the histograms were last cleared
+};
+
+extern LoopStats loopStats;
+
+#endif
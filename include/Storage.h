@@ -0,0 +1,54 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+/**
+ * @brief Counters for the time spent on flash, in microseconds, and the number of calls.
+ */
+struct StorageStats {
+    uint32_t mounts;
+    uint32_t mountUs;
+    uint32_t opens;
+    uint32_t openUs;
+    uint32_t reads;
+    uint32_t readBytes;
+    uint32_t readUs;
+    uint32_t writes;
+    uint32_t writeBytes;
+    uint32_t writeUs;
+};
+
+/**
+ * @brief The flash filesystem, mounted once and kept mounted.
+ *
+ * Every file access in the firmware goes through the global `storage` instead of calling
+ * `LittleFS` directly, so the filesystem metadata is walked once at boot rather than on
+ * every operation, and the cost of mounting, opening, reading and writing is counted.
+ * Files are ordinary LittleFS `File` handles; use `read()` and `write()` here for the
+ * transfers that should be counted.
+ */
+class Storage {
+public:
+    bool begin();
+    bool mounted();
+    File open(const char* path, const char* mode);
+    bool exists(const char* path);
+    bool remove(const char* path);
+    bool rename(const char* from, const char* to);
+    size_t read(File& file, uint8_t* buffer, size_t length);
+    size_t write(File& file, const uint8_t* data, size_t length);
+    size_t write(File& file, const char* text);
+
+    const StorageStats& stats();
+    void report(Print& out);
+
+private:
+    bool isMounted = false;
+    StorageStats counters = {};
+};
+
+extern Storage storage;
+
+#endif
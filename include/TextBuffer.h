@@ -0,0 +1,40 @@
+#ifndef TEXTBUFFER_H
+#define TEXTBUFFER_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Builds text in a fixed char array, for URLs, headers and request bodies.
+ *
+ * A replacement for `String` concatenation that never allocates: the caller owns the
+ * array, usually on the stack or in the object that sends the text. Anything `Print` can
+ * print can be appended, and `format()` appends printf-style. Text that does not fit is
+ * cut off and `overflowed()` reports it, so the caller can refuse to send it; the array
+ * always holds a terminated string.
+ *
+ * @code
+ * char url[API_URL_SIZE];
+ * TextBuffer text(url, sizeof(url));
+ * text.format("http://%s%s", serverIP, path);
+ * @endcode
+ */
+class TextBuffer : public Print {
+public:
+    TextBuffer(char* buffer, size_t size);
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* data, size_t length) override;
+    using Print::write;
+    bool format(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    void clear();
+    const char* c_str();
+    size_t length();
+    bool overflowed();
+
+private:
+    char* buffer;
+    size_t size;
+    size_t used = 0;
+    bool overflow = false;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef TIMELINEBENCHMARK_H
+#define TIMELINEBENCHMARK_H
+
+#include <Arduino.h>
+
+#include "TimelineManager.h"
+#include "ColourPatterns.h"
+#include "Histogram.h"
+
+#define BENCH_TIMELINE "99"   // timeline number the benchmark writes, removed again afterwards
+#define BENCH_EVENT_GAP 20    // average ms between the synthetic events
+#define BENCH_PLAY_MS 1000    // ms of playback timed for each timeline size
+#define BENCH_BLOCK 64        // bytes of JSON handed to the parser at a time, as a download does
+
+/**
+ * @brief Times the timeline pipeline on synthetic timelines of 10 to 10,000 events.
+ *
+ * For each size a timeline is made up and parsed, compiled, activated twice (the second
+ * time from the RAM cache if it fits) and played for `BENCH_PLAY_MS`. The report gives each
+ * stage's time, the peak and held heap, and percentiles of the time one
+ * `checkTimelineData()` + `changeColours()` tick takes, split into ticks that changed the
+ * signal and ticks that did not.
+ *
+ * Times come from `ESP.getCycleCount()`. In the native env that counts host time, so the
+ * figures are the computer's, not the ESP's, and are for comparing builds on one machine.
+ *
+ * @note Run from the `bench` serial command. It blocks for a few seconds and replaces the
+ *       active timeline while it runs; the caller reloads it afterwards.
+ */
+class TimelineBenchmark {
+public:
+    TimelineBenchmark(TimelineManager& manager, ColourPatterns& patterns);
+
+    void run(Print& out);
+    bool runOne(uint16_t events, Print& out);
+
+private:
+    bool build(uint16_t events, uint32_t& parseUs, uint32_t& compileUs);
+    void play(Histogram& idleTicks, Histogram& eventTicks);
+    void sampleHeap();
+    static uint32_t cyclesToMicros(uint32_t cycles);
+
+    TimelineManager& manager;
+    ColourPatterns& patterns;
+    uint32_t lowestFree = 0; // lowest ESP.getFreeHeap() seen in the current run
+};
+
+#endif
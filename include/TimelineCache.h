@@ -0,0 +1,60 @@
+#ifndef TIMELINECACHE_H
+#define TIMELINECACHE_H
+
+#include <Arduino.h>
+#include "Storage.h"
+
+#include "TimelineFile.h"
+
+#ifndef TIMELINE_CACHE_BUDGET
+#define TIMELINE_CACHE_BUDGET 8192 // bytes of RAM for cached timelines
+#endif
+#ifndef TIMELINE_CACHE_SLOTS
+#define TIMELINE_CACHE_SLOTS 4
+#endif
+
+/**
+ * @brief Least-recently-used cache of compiled timeline files held in RAM.
+ *
+ * Each entry is a verified copy of a binary timeline file, so switching back to a recently
+ * used timeline only means pointing the EventWindow at it. The entry being played is
+ * pinned and never evicted or freed until another timeline has been acquired in its place,
+ * or playback has moved to flash and called `unpin()`.
+ */
+class TimelineCache {
+public:
+    ~TimelineCache();
+    const uint8_t* acquire(const char* timelineNumber, size_t& size);
+    void invalidate(const char* timelineNumber);
+    void unpin();
+    uint32_t hits();
+    uint32_t misses();
+    uint32_t evictions();
+    size_t used();
+
+private:
+    struct Entry {
+        char number[8];
+        uint8_t* data;
+        size_t size;
+        uint32_t lastUsed;
+        bool pinned;
+        bool stale; // replaced on flash while pinned, freed once unpinned
+    };
+
+    Entry* find(const char* timelineNumber);
+    Entry* load(const char* timelineNumber);
+    bool makeRoom(size_t size);
+    bool evictOldest();
+    size_t pinnedBytes();
+    void release(Entry& entry);
+
+    Entry entries[TIMELINE_CACHE_SLOTS] = {};
+    size_t bytesUsed = 0;
+    uint32_t clock = 0;
+    uint32_t hitCount = 0;
+    uint32_t missCount = 0;
+    uint32_t evictionCount = 0;
+};
+
+#endif
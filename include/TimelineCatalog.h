@@ -0,0 +1,49 @@
+#ifndef TIMELINECATALOG_H
+#define TIMELINECATALOG_H
+
+#include <Arduino.h>
+#include "Storage.h"
+
+#include "TimelineFile.h"
+
+#define CATALOG_PATH "/catalog.txt"
+#define CATALOG_SLOTS 16
+#define CATALOG_VERSION_SIZE 41 // a 40 character SHA-1 hex digest plus terminator
+
+/**
+ * @brief The version of each timeline stored on flash, as given by the server's manifest.
+ *
+ * Versions are opaque strings (a content hash or a revision number), compared for equality
+ * only, so any server or local mirror that serves the same manifest gives the same result.
+ * A timeline can also have a scheduled start, in Unix time milliseconds, for shows that
+ * begin at a set time of day. The catalog is kept in `/catalog.txt` as one
+ * `<number> <version> [<start>]` line per timeline (`-` for no version) and is only
+ * written when it has changed.
+ */
+class TimelineCatalog {
+public:
+    bool load();
+    bool save();
+    const char* version(const char* timelineNumber);
+    bool upToDate(const char* timelineNumber, const char* version);
+    bool set(const char* timelineNumber, const char* version);
+    uint64_t start(const char* timelineNumber);
+    bool setStart(const char* timelineNumber, uint64_t start);
+    void remove(const char* timelineNumber);
+
+private:
+    struct Entry {
+        char number[8];
+        char version[CATALOG_VERSION_SIZE];
+        uint64_t start; // scheduled start in Unix time ms, 0 for none
+    };
+
+    Entry* find(const char* timelineNumber);
+    Entry* add(const char* timelineNumber);
+
+    Entry entries[CATALOG_SLOTS] = {};
+    bool loaded = false;
+    bool dirty = false;
+};
+
+#endif
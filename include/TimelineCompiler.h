@@ -0,0 +1,91 @@
+#ifndef TIMELINECOMPILER_H
+#define TIMELINECOMPILER_H
+
+#include <Arduino.h>
+#include "Storage.h"
+
+#include "TimelineFile.h"
+
+#define COMPILER_SORT_RUN 64 // events sorted in RAM at a time when the input is out of order
+
+/**
+ * @brief Turns parsed timeline events into a playable binary timeline file.
+ *
+ * Events are staged on flash as they arrive (it is a TimelineEventSink, so TimelineParser
+ * can write straight into it). `compile()` (or `startCompile()` followed by `sortStep()` and
+ * then `compileStep()` calls, to spread the work over several `loop()` passes) then:
+ * - sorts the events by time (an external merge sort, only if they arrived out of order):
+ *   each `sortStep()` sorts one run of `COMPILER_SORT_RUN` events in RAM, or merges a
+ *   bounded number of events from the sorted runs,
+ * - keeps one event per timing (the last one received, which is the one that would show),
+ *   so exact duplicates are dropped,
+ * - drops events that repeat the colour already showing,
+ * - writes the result with delta-encoded varint timings using TimelineWriter.
+ */
+class TimelineCompiler : public TimelineEventSink {
+public:
+    bool begin(const char* timelineNumber);
+    bool onEvent(const TimelineRecord& record) override;
+    bool compile();
+    bool startCompile();
+    bool sortStep(uint16_t maxEvents, bool& sorted);
+    bool sorting();
+    bool compileStep(uint16_t maxEvents, bool& finished);
+    void abort();
+    uint16_t count();
+
+private:
+    enum Stage : uint8_t {
+        Staging,
+        SortingRuns,
+        LoadingRuns, // reading the head of each sorted run
+        MergingRuns,
+        Encoding
+    };
+
+    struct Run {
+        TimelineRecord head;
+        uint16_t next; // index of the event after the head
+        uint16_t end;
+    };
+
+    bool sortRun();
+    bool startMerge();
+    bool loadRuns(uint16_t maxRuns);
+    bool mergeRuns(uint16_t maxEvents);
+    bool readHead(Run& run);
+    void siftDown(uint16_t slot);
+    static bool before(const Run& a, const Run& b);
+    bool startEncoding();
+    void endSort();
+    bool emit(const TimelineRecord& record);
+    bool finishCompile(bool ok);
+
+    char stagingPath[32];
+    char sortedPath[32];
+    char outputPath[32];
+    File staging;
+    uint16_t staged = 0;
+    bool inOrder = true;
+    uint32_t lastStagedTiming = 0;
+    Stage stage = Staging;
+
+    File sortInput;
+    File sortOutput;
+    TimelineRecord* runBuffer = nullptr; // one run, while SortingRuns
+    Run* runs = nullptr;                 // a min-heap on the head timing, while merging
+    uint16_t runCount = 0;
+    uint16_t sortPosition = 0;           // next run to sort or load, or events merged
+
+    TimelineWriter writer;
+    File input;
+    bool havePending = false;
+    bool havePrevious = false;
+    TimelineRecord pending;  // last event read, written once the next timing is known
+    uint32_t previousTiming = 0;
+    bool haveShown = false;
+    TimelineRecord shown;    // colour currently showing in the compiled output
+    uint16_t compiled = 0;
+};
+
+#endif
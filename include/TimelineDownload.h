@@ -0,0 +1,63 @@
+#ifndef TIMELINEDOWNLOAD_H
+#define TIMELINEDOWNLOAD_H
+
+#include <Arduino.h>
+#include "Storage.h"
+#include <ESP8266HTTPClient.h>
+
+#include "TimelineFile.h"
+#include "TimelineCompiler.h"
+#include "TimelineParser.h"
+#include "HttpBodyReader.h"
+
+#define DOWNLOAD_SLICE_BYTES 256  // response bytes parsed per step()
+#define DOWNLOAD_SLICE_EVENTS 64  // staged events merged or compiled per step()
+#define DOWNLOAD_TIMEOUT 5000     // ms without data before a download is abandoned
+
+/**
+ * @brief Turns one timeline HTTP response into a binary timeline file, a slice at a time.
+ *
+ * Each `step()` parses at most `DOWNLOAD_SLICE_BYTES` of the response body, sorts one run of
+ * out-of-order events or merges or compiles at most `DOWNLOAD_SLICE_EVENTS` staged events,
+ * and never waits for the network. Calling it
+ * once per `loop()` keeps the download from holding up LED playback. The file being played
+ * is never touched: the result goes to a separate `.new` file.
+ */
+class TimelineDownload {
+public:
+    enum Status : uint8_t {
+        Idle,
+        Busy,
+        Done,
+        Failed
+    };
+
+    TimelineDownload();
+    bool begin(HTTPClient& http, const char* timelineNumber);
+    Status step();
+    void abort();
+    Status status();
+    const char* number();
+    uint16_t received();
+    uint16_t compiled();
+
+private:
+    enum Phase : uint8_t {
+        Receiving,
+        Sorting, // only if the events arrived out of order
+        Compiling,
+        Finished
+    };
+
+    Status fail(const char* reason);
+
+    TimelineCompiler compiler;
+    TimelineParser parser;
+    HttpBodyReader body;
+    Phase phase = Finished;
+    Status state = Idle;
+    char timelineNumber[8];
+    unsigned long lastData = 0;
+};
+
+#endif
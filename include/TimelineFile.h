@@ -0,0 +1,133 @@
+#ifndef TIMELINEFILE_H
+#define TIMELINEFILE_H
+
+#include <Arduino.h>
+#include "Storage.h"
+
+#define TIMELINE_FILE_MAGIC 0x4C54504D // "MPTL" little endian
+#define TIMELINE_FILE_VERSION 2
+#define TIMELINE_INDEX_INTERVAL 32 // events between seek index entries
+
+/**
+ * @brief Header at the start of every binary timeline file.
+ *
+ * Followed by the event data and then `indexCount` TimelineIndexEntry records. Each event
+ * is stored as a varint timing, then pattern, red, green and blue bytes. The timing is the
+ * delta from the previous event, except for every `indexInterval`th event (a keyframe),
+ * which stores its absolute timing so decoding can start there. `crc` is the CRC-32 of the
+ * event data and the index.
+ */
+struct __attribute__((packed)) TimelineHeader {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t indexInterval;
+    uint16_t eventCount;
+    uint32_t crc;
+    uint32_t duration;    // length of one pass through the timeline in ms
+    uint32_t indexOffset; // from the start of the file
+    uint16_t indexCount;
+    uint16_t reserved;
+};
+
+/**
+ * @brief Seek index entry: absolute timing and file offset of a keyframe event.
+ */
+struct __attribute__((packed)) TimelineIndexEntry {
+    uint32_t timing;
+    uint32_t offset;
+};
+
+/**
+ * @brief One decoded timeline event, as used for playback.
+ *
+ * `pattern` is the first value of the server's colour triple, which selects the
+ * ColourPatterns pattern; the full triple is kept in `red`, `green` and `blue`.
+ */
+struct __attribute__((packed)) TimelineRecord {
+    uint32_t timing;
+    uint8_t pattern;
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+};
+
+/**
+ * @brief Where decoding of the next event starts in a timeline file.
+ */
+struct TimelinePosition {
+    uint16_t index;  // index of the next event
+    uint32_t offset; // file offset of the next event
+    uint32_t timing; // timing of the previous event, the base for the next delta
+};
+
+/**
+ * @brief Receives timeline events one at a time, e.g. from TimelineParser.
+ */
+class TimelineEventSink {
+public:
+    virtual bool onEvent(const TimelineRecord& record) = 0;
+};
+
+uint32_t timelineCrc32(uint32_t crc, const uint8_t* data, size_t length);
+void formatTimelinePath(char* buffer, size_t size, const char* timelineNumber, const char* extension = "bin");
+
+/**
+ * @brief Encodes time-ordered events into a binary timeline file.
+ *
+ * Index entries are staged in a side file while the events are written and appended at the
+ * end, so RAM use does not depend on timeline length.
+ */
+class TimelineWriter {
+public:
+    bool begin(const char* path);
+    bool append(const TimelineRecord& record);
+    void setDuration(uint32_t duration);
+    bool finish();
+    void abort();
+    uint16_t count();
+
+private:
+    bool put(const uint8_t* data, size_t length);
+
+    File file;
+    File indexFile;
+    char indexPath[32];
+    TimelineHeader header;
+    uint32_t offset = 0;
+    uint32_t previousTiming = 0;
+    bool ok = false;
+};
+
+/**
+ * @brief Decodes events from a binary timeline file or an in-RAM copy of one.
+ *
+ * Reads from flash through a small buffer, so sequential decoding costs one flash read per
+ * `sizeof(buffer)` bytes.
+ */
+class TimelineReader {
+public:
+    bool open(const char* path);
+    bool open(const uint8_t* image, size_t size);
+    uint16_t count();
+    uint32_t duration();
+    uint32_t crc();
+    bool verify();
+    TimelinePosition start();
+    bool find(long ms, TimelinePosition& position);
+    bool next(TimelineRecord& record, TimelinePosition& position);
+    void close();
+
+private:
+    int byteAt(uint32_t offset);
+    bool checkHeader();
+
+    File file;
+    const uint8_t* image = nullptr; // set when reading from RAM
+    size_t imageSize = 0;
+    TimelineHeader header;
+    uint8_t buffer[32];
+    uint32_t bufferOffset = 0;
+    uint8_t bufferLength = 0;
+};
+
+#endif
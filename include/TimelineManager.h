@@ -2,29 +2,48 @@
 #define TIMELINEMANAGER_H
 
 #include <Arduino.h>
-#include <LittleFS.h>
+#include "Storage.h"
 #include <WiFiClient.h>
 #include <ESP8266WiFi.h>
 #include <ESP8266WiFiMulti.h>
 #include <ESP8266HTTPClient.h>
 #include <ArduinoJson.h>
 
-#include <LittleFS.h>
+#include "TimelineFile.h"
+#include "TimelineCompiler.h"
+#include "EventWindow.h"
+#include "TimelineCache.h"
+#include "TimelineDownload.h"
+#include "TimelineCatalog.h"
+#include "ApiSession.h"
+#include "JwtToken.h"
+#include "ClockSync.h"
+#include "WallClock.h"
+
+#define TIMELINE_SIGNAL_OFF 255 // not a pattern, so ColourPatterns::changeColours() turns the LEDs off
+#define LOGIN_BODY_SIZE 160     // bytes for the login request's JSON, email and password included
 
 class TimelineManager {
 public:
     TimelineManager(const char* jwtFilePath, const char* serverIP, const char* email, const char* passwordJwt, WiFiClient client);
-    String readJWTTokenFromFile();
+    bool readJWTTokenFromFile(char* buffer, size_t size);
     void saveJWTTokenToFile(const char* token);
-    void clearTimeline(String timelineNumber);
-    void saveTimeline(const String& timelineData, String timelineFilePath);
-    String loadTimeline(String timelineNumber);
-    void processTimelineData(const String& timelineData);
+    void clearTimeline(const char* timelineNumber);
+    bool saveTimeline(HTTPClient& http, const char* timelineNumber);
+    void installTimeline(const char* timelineNumber);
+    bool loadTimeline(const char* timelineNumber);
     uint8_t checkTimelineData();
+    void seek(unsigned long ms);
+    void playFrom(unsigned long ms);
+    void setSignal(uint8_t pattern);
+    bool hasTimeline(const char* timelineNumber);
+    unsigned long nextEventDeadline();
     bool authenticate();
-    String getTimelineNumber();
-    String getTotalTimelines();
-    void getTimeline(String tln);
+    bool getTimelineNumber(char* number, size_t size);
+    int getTotalTimelines();
+    bool getManifest(JsonDocument& manifest);
+    int requestTimeline(const char* tln);
+    void getTimeline(const char* tln);
     void getAllTimelines();   
     void updateToken(); 
     bool alreadyGotData();
@@ -32,6 +51,12 @@ public:
     bool gotTokenTrue();
     void setToken(bool setting);
     void setPlaying(bool setting);
+    void setClock(ClockSync* clock);
+    void setWallClock(WallClock* wallClock);
+    void updateSchedule();
+    TimelineCache& timelineCache();
+    TimelineCatalog& timelineCatalog();
+    ApiSession& apiSession();
 
 private:
     const char* jwtFilePath;
@@ -39,35 +64,44 @@ private:
     const char* email;
     const char* passwordJwt;
     WiFiClient client;
+    ApiSession session; // keep-alive connection on client, shared by every API call
 
-    char token[256];
+    char token[256] = ""; // JWT used for API calls, see setTokenValue()
     bool gotToken = false;
-    const char* timeline_keys[10]; //array for keys
+    bool tokenFresh = false;         // issued by authenticate() since boot
+    uint32_t tokenExpiry = 0;        // exp claim (unix time), 0 if unknown
+    uint32_t tokenIssued = 0;        // iat claim (unix time), 0 if unknown
+    unsigned long tokenReceived = 0; // millis() when the token was set
     char jwtToken[256];
 
-    long timings[50]; // todo: max should be > 50, was 50 to save space for attiny...
-    uint8_t colours[50];
+    EventWindow window; // upcoming events, streamed from the active timeline file
+    TimelineCache cache; // recently played timelines kept in RAM for instant switching
+    TimelineCatalog catalog; // version of each timeline on flash, compared with the server's manifest
+    char activeNumber[8] = ""; // number of the timeline loaded in the window
     uint8_t signal = 0; 
-    uint8_t flashes[50];
     long currentMillisTimeline = 0;
     bool playing = true;
-    int maxTimingsNum = 50; // using only 50 for now
-    int runNum = 0;
+    long pausedAt = 0; // point in the timeline playback was stopped at, see setPlaying()
+    int maxTimingsNum = 0; // number of events in the active timeline
     long playStartTime = 0;
+    long loopLength = 0; // length of one pass through the timeline, see activatePlayback()
+    ClockSync* clock = nullptr; // shared playback clock, see setClock()
+    uint16_t clockLocks = 0;    // ClockSync::locks() when playback was last aligned to it
+    WallClock* wallClock = nullptr; // SNTP time for scheduled starts, see setWallClock()
+    uint16_t wallSyncs = 0;     // WallClock::syncs() when playback was last aligned to it
+    uint64_t scheduledStart = 0; // Unix time ms the active timeline starts at, 0 for none
+    bool waitingForStart = false; // LEDs off until scheduledStart
 
-    JsonVariant redVal;
-    JsonVariant greenVal;
-    JsonVariant blueVal;
-
-    int redInt = 1;
-    int greenInt = 1;
-    int blueInt = 1;
+    void activatePlayback();
+    void alignPlayback();
+    unsigned long playbackTime();
+    bool setTokenValue(const char* newToken, bool persist);
+    bool tokenTimeRemaining(long& remaining);
+    int apiGet(const char* path);
+    bool checkPendingTimeline(const char* timelineNumber);
+    bool promoteTimeline(const char* timelineNumber);
 
     volatile bool already_got_data = false;
-
-    String globaltimelineData = "";
-    String timelineNumber = "0";
-    String timelineFilePath = "/timeline" + timelineNumber + ".txt";
 };
 
 #endif
@@ -0,0 +1,64 @@
+#ifndef TIMELINEPARSER_H
+#define TIMELINEPARSER_H
+
+#include <Arduino.h>
+
+#include "TimelineFile.h"
+
+#define PARSER_MAX_KEY_DIGITS 9 // digits in a timing key, so it fits in 32 bits (11 days in ms)
+
+/**
+ * @brief Incremental parser for timeline JSON of the form `{"<ms>": [r, g, b], ...}`.
+ *
+ * Bytes can be written in pieces of any size; each complete event is passed to the sink
+ * as soon as its closing `]` arrives, so memory use does not depend on timeline length.
+ *
+ * A timing key of more than `PARSER_MAX_KEY_DIGITS` digits, or a timing or colour value
+ * that is not a whole number (e.g. `1.5` or `-3`), fails the parse rather than giving a
+ * wrong event.
+ */
+class TimelineParser : public Print {
+public:
+    TimelineParser(TimelineEventSink& sink);
+
+    void reset();
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* data, size_t length) override;
+    bool done();
+    bool failed();
+    uint16_t count();
+
+private:
+    enum State : uint8_t {
+        ExpectObject,
+        ExpectKey,
+        InKey,
+        ExpectColon,
+        ExpectValue,
+        InArray,
+        SkipValue,
+        ExpectComma,
+        Done,
+        Failed
+    };
+
+    void finishValue();
+    void emitEvent();
+
+    TimelineEventSink& sink;
+    State state = ExpectObject;
+    uint32_t keyTiming = 0;
+    bool keyNumeric = false;
+    uint8_t keyDigits = 0;
+    uint8_t values[3];
+    uint8_t valueIndex = 0;
+    uint16_t currentValue = 0;
+    bool valueDigits = false;
+    bool valueEnded = false; // whitespace or a quote after the digits of a value
+    uint8_t skipDepth = 0;
+    bool skipInString = false;
+    bool skipEscape = false;
+    uint16_t eventCount = 0;
+};
+
+#endif
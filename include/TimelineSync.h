@@ -0,0 +1,81 @@
+#ifndef TIMELINESYNC_H
+#define TIMELINESYNC_H
+
+#include <Arduino.h>
+#include <ESP8266HTTPClient.h>
+
+#include "TimelineManager.h"
+#include "TimelineDownload.h"
+#include "TimelineCatalog.h"
+
+#define SYNC_MAX_TIMELINES 10 // most timelines downloaded per sync
+#define SYNC_MANIFEST_CAPACITY 1536 // bytes of JsonDocument for the parsed manifest
+
+/**
+ * @brief Background download of all timelines, run a bounded slice at a time from `loop()`.
+ *
+ * Each `step()` does at most one short API request (login, current timeline number, total
+ * timelines or the start of a timeline download) or one TimelineDownload slice, then
+ * returns so that `loop()` can keep playing the current timeline at frame rate. Downloads
+ * only go to flash: nothing is activated until `loop()` asks TimelineManager to load a
+ * timeline. All requests go over the manager's keep-alive ApiSession.
+ *
+ * The server's manifest is compared with the local TimelineCatalog and only timelines whose
+ * version changed are downloaded, the active one first; when nothing changed a sync is a
+ * single request. Servers without a manifest get every timeline downloaded, as before.
+ *
+ * Nothing a sync allocates outlives it: the free heap is compared at the start and end of
+ * each sync (`heapChange()`), which should be zero once the connection is open.
+ */
+class TimelineSync {
+public:
+    TimelineSync(TimelineManager& manager);
+    void start(bool fetchActiveNumber);
+    void step();
+    bool busy();
+    bool finished();
+    bool failed();
+    const char* activeNumber();
+    int total();
+    uint8_t downloadFailures();
+    int32_t heapChange();
+
+private:
+    enum State : uint8_t {
+        Idle,
+        Authenticate,
+        GetNumber,
+        GetManifest,
+        GetTotal,
+        RequestTimeline,
+        Download,
+        Done,
+        Failed
+    };
+
+    struct Pending {
+        char number[8];
+        char version[CATALOG_VERSION_SIZE]; // empty when the server has no manifest
+    };
+
+    bool readManifest(JsonDocument& manifest);
+    void readManifestEntry(const char* number, JsonVariant entry);
+    void queue(const char* number, const char* version);
+    void requestNext();
+    void fail(const char* reason);
+
+    TimelineManager& manager;
+    TimelineDownload download;
+    State state = Idle;
+    bool fetchActiveNumber = false;
+    char serverNumber[8] = "";    // active timeline number reported by the server
+    int totalTimelines = 0;
+    Pending pending[SYNC_MAX_TIMELINES]; // timelines still to download, in order
+    uint8_t pendingCount = 0;
+    uint8_t nextPending = 0;
+    uint8_t failures = 0;
+    uint32_t heapAtStart = 0;     // ESP.getFreeHeap() when the sync started
+    int32_t heapChanged = 0;      // free heap at the end of the last sync less heapAtStart
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef TIMELINEUPLOAD_H
+#define TIMELINEUPLOAD_H
+
+#include <Arduino.h>
+#include "Storage.h"
+
+#include "TimelineFile.h"
+#include "TimelineCompiler.h"
+#include "TimelineParser.h"
+
+#define UPLOAD_SLICE_EVENTS 64 // staged events merged or compiled per step()
+#define UPLOAD_TIMEOUT 5000    // ms without data before an upload is abandoned
+
+/**
+ * @brief Turns a timeline pushed over the LAN into a binary timeline file.
+ *
+ * The counterpart of TimelineDownload for bodies that arrive in callbacks rather than on a
+ * stream: each piece is passed to `write()` as it is received and goes straight through a
+ * TimelineParser, which stages every event on flash, so RAM use does not depend on the size
+ * of the timeline. `write()` and `end()` only parse and append, so they can be called from
+ * the web server's callbacks; `step()`, called from `loop()`, sorts the staged events if
+ * they arrived out of order, a run or `UPLOAD_SLICE_EVENTS` merged events at a time, and
+ * compiles them `UPLOAD_SLICE_EVENTS` at a time. The result goes to `/timelineN.new`, as a
+ * download's does, for TimelineManager::installTimeline().
+ */
+class TimelineUpload {
+public:
+    enum Status : uint8_t {
+        Idle,
+        Receiving,
+        Received, // whole body staged, compiled by the next step()
+        Sorting,  // only if the events arrived out of order
+        Compiling,
+        Done,
+        Failed
+    };
+
+    TimelineUpload();
+    bool begin(const char* timelineNumber);
+    bool write(const uint8_t* data, size_t length);
+    bool end();
+    Status step();
+    void abort();
+    Status status();
+    const char* number();
+    uint16_t received();
+    uint16_t compiled();
+    unsigned long duration();
+
+private:
+    Status fail(const char* reason);
+
+    TimelineCompiler compiler;
+    TimelineParser parser;
+    volatile Status state = Idle;
+    char timelineNumber[8];
+    unsigned long started = 0;  // millis() at begin()
+    unsigned long lastData = 0; // millis() the last piece arrived
+    unsigned long took = 0;     // ms from begin() to Done
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef WALLCLOCK_H
+#define WALLCLOCK_H
+
+#include <Arduino.h>
+
+#ifndef NTP_SERVER
+#define NTP_SERVER "pool.ntp.org" // define in secrets.h to use a local time server instead
+#endif
+#define WALL_CLOCK_MIN_EPOCH 1600000000UL // s, earlier times mean SNTP has not set the clock yet
+
+/**
+ * @brief Unix time kept by SNTP, for timelines scheduled to start at a set time of day.
+ *
+ * The ESP8266 core's SNTP client sets the system clock shortly after Wi-Fi connects and
+ * corrects it every hour; this class starts it and reads the result to the millisecond.
+ * Every poi synced to the same time server starts a scheduled timeline together.
+ *
+ * @see TimelineManager::setWallClock() - Plays scheduled timelines on this clock.
+ */
+class WallClock {
+public:
+    void begin(const char* server);
+    void stop();
+    bool started();
+    bool valid();
+    uint64_t epochMillis();
+    uint16_t syncs();
+
+private:
+    bool isStarted = false;
+};
+
+#endif
@@ -0,0 +1,289 @@
+#include <Arduino.h>
+#include <stdarg.h>
+#include <strings.h>
+#include <algorithm>
+#include <chrono>
+
+#include "NativeHal.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+
+String::String(long value, unsigned char base) {
+  if (base == 10) {
+    text = std::to_string(value);
+  } else {
+    *this = String((unsigned long)value, base);
+  }
+}
+
+String::String(unsigned long value, unsigned char base) {
+  if (base < 2 || base > 36) {
+    base = 10;
+  }
+  char digits[8 * sizeof(unsigned long) + 1];
+  char* end = digits + sizeof(digits) - 1;
+  char* p = end;
+  *p = '\0';
+  do {
+    uint8_t digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    value /= base;
+  } while (value > 0);
+  text = p;
+}
+
+String::String(double value, unsigned char decimals) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+  text = buffer;
+}
+
+bool String::equalsIgnoreCase(const String& other) const {
+  return text.size() == other.text.size() && strcasecmp(text.c_str(), other.text.c_str()) == 0;
+}
+
+bool String::endsWith(const String& suffix) const {
+  return text.size() >= suffix.text.size()
+      && text.compare(text.size() - suffix.text.size(), suffix.text.size(), suffix.text) == 0;
+}
+
+int String::indexOf(char c, unsigned int from) const {
+  size_t found = text.find(c, from);
+  return found == std::string::npos ? -1 : (int)found;
+}
+
+int String::indexOf(const String& other, unsigned int from) const {
+  size_t found = text.find(other.text, from);
+  return found == std::string::npos ? -1 : (int)found;
+}
+
+int String::lastIndexOf(char c) const {
+  size_t found = text.rfind(c);
+  return found == std::string::npos ? -1 : (int)found;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > to) {
+    std::swap(from, to);
+  }
+  if (from >= text.size()) {
+    return String();
+  }
+  return String(text.substr(from, std::min<size_t>(to, text.size()) - from));
+}
+
+void String::trim() {
+  size_t first = text.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos) {
+    text.clear();
+    return;
+  }
+  size_t last = text.find_last_not_of(" \t\r\n");
+  text = text.substr(first, last - first + 1);
+}
+
+void String::toLowerCase() {
+  for (char& c : text) {
+    c = tolower((unsigned char)c);
+  }
+}
+
+void String::toUpperCase() {
+  for (char& c : text) {
+    c = toupper((unsigned char)c);
+  }
+}
+
+void String::replace(const String& find, const String& with) {
+  if (find.text.empty()) {
+    return;
+  }
+  size_t at = 0;
+  while ((at = text.find(find.text, at)) != std::string::npos) {
+    text.replace(at, find.text.size(), with.text);
+    at += with.text.size();
+  }
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+  if (index < text.size()) {
+    text.erase(index, count);
+  }
+}
+
+String operator+(const String& left, const String& right) {
+  String sum(left);
+  sum.concat(right);
+  return sum;
+}
+
+String operator+(const String& left, const char* right) {
+  String sum(left);
+  sum.concat(right);
+  return sum;
+}
+
+String operator+(const char* left, const String& right) {
+  String sum(left);
+  sum.concat(right);
+  return sum;
+}
+
+String operator+(const String& left, char right) {
+  String sum(left);
+  sum.concat(right);
+  return sum;
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t written = 0;
+  while (written < size && write(buffer[written])) {
+    written++;
+  }
+  return written;
+}
+
+/**
+ * @brief Prints a number from a buffer on the stack, as the ESP core does, so printing
+ *        never allocates.
+ */
+size_t Print::print(unsigned long value, int base) {
+  if (base < 2 || base > 36) {
+    base = 10;
+  }
+  char digits[8 * sizeof(unsigned long) + 1];
+  char* p = digits + sizeof(digits) - 1;
+  *p = '\0';
+  do {
+    uint8_t digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    value /= base;
+  } while (value > 0);
+  return write(p);
+}
+
+size_t Print::print(long value, int base) {
+  if (base == 10 && value < 0) {
+    return print('-') + print(0UL - (unsigned long)value, 10);
+  }
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(long long value) {
+  char digits[24];
+  snprintf(digits, sizeof(digits), "%lld", value);
+  return write(digits);
+}
+
+size_t Print::print(unsigned long long value) {
+  char digits[24];
+  snprintf(digits, sizeof(digits), "%llu", value);
+  return write(digits);
+}
+
+size_t Print::print(double value, int decimals) {
+  char digits[64];
+  snprintf(digits, sizeof(digits), "%.*f", decimals, value);
+  return write(digits);
+}
+
+size_t Print::printf(const char* format, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (length < 0) {
+    return 0;
+  }
+  return write((const uint8_t*)buffer, std::min<size_t>(length, sizeof(buffer) - 1));
+}
+
+size_t Stream::readBytes(uint8_t* buffer, size_t length) {
+  size_t count = 0;
+  unsigned long started = millis();
+  while (count < length) {
+    int c = read();
+    if (c < 0) {
+      if (millis() - started >= timeout) {
+        break;
+      }
+      yield();
+      continue;
+    }
+    buffer[count++] = (uint8_t)c;
+  }
+  return count;
+}
+
+String Stream::readString() {
+  String text;
+  int c;
+  while ((c = read()) >= 0) {
+    text.concat((char)c);
+  }
+  return text;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  if (!NativeHal::quiet()) {
+    for (size_t i = 0; i < size; i++) {
+      if (buffer[i] != '\r') { // println() ends lines with \r\n, as on the ESP
+        putchar(buffer[i]);
+      }
+      if (buffer[i] == '\n' && !NativeHal::virtualClock()) {
+        fflush(stdout); // a tool reading the output on the real clock sees each line as it is written
+      }
+    }
+  }
+  return size;
+}
+
+int HardwareSerial::available() {
+  return NativeHal::serialAvailable();
+}
+
+int HardwareSerial::read() {
+  return NativeHal::serialRead();
+}
+
+int HardwareSerial::peek() {
+  return NativeHal::serialPeek();
+}
+
+static const size_t startupHeapUsed = NativeHal::heapUsed();
+
+/**
+ * @brief `NATIVE_HEAP_SIZE` less what the program has allocated since it started.
+ */
+uint32_t EspClass::getFreeHeap() {
+  size_t used = NativeHal::heapUsed();
+  size_t grown = used > startupHeapUsed ? used - startupHeapUsed : 0;
+  return grown < NATIVE_HEAP_SIZE ? NATIVE_HEAP_SIZE - grown : 0;
+}
+
+uint32_t EspClass::getMaxFreeBlockSize() {
+  return getFreeHeap();
+}
+
+uint8_t EspClass::getHeapFragmentation() {
+  return 0;
+}
+
+/**
+ * @brief Host time in cycles of `getCpuFreqMHz()`, on the virtual clock too.
+ */
+uint32_t EspClass::getCycleCount() {
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return (uint32_t)(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count() * getCpuFreqMHz() / 1000);
+}
+
+void EspClass::restart() {
+  NativeHal::report();
+  exit(0);
+}
@@ -0,0 +1,238 @@
+#ifndef NATIVEHAL_ARDUINO_H
+#define NATIVEHAL_ARDUINO_H
+
+// The parts of the ESP8266 Arduino core the firmware uses, for the native env. Timing and
+// GPIO are simulated by NativeHal.cpp; see NativeHal.h.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <string>
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x00
+#define OUTPUT 0x01
+#define INPUT_PULLUP 0x02
+
+#define DEC 10
+#define HEX 16
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+// D1 mini pin names, as GPIO numbers
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+void analogWriteRange(uint32_t range);
+void analogWriteFreq(uint32_t frequency);
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode);
+void detachInterrupt(uint8_t interrupt);
+void noInterrupts();
+void interrupts();
+
+extern volatile uint32_t GPO; // GPIO 0-15 output levels, as the ESP8266 register
+
+void configTime(int timezone, int daylightOffset_sec, const char* server1, const char* server2 = nullptr, const char* server3 = nullptr);
+
+/**
+ * @brief Arduino's String, on top of std::string.
+ */
+class String {
+public:
+    String(const char* text = "") : text(text != nullptr ? text : "") {}
+    String(const std::string& text) : text(text) {}
+    explicit String(char c) : text(1, c) {}
+    String(int value, unsigned char base = 10) : String((long)value, base) {}
+    String(unsigned int value, unsigned char base = 10) : String((unsigned long)value, base) {}
+    String(long value, unsigned char base = 10);
+    String(unsigned long value, unsigned char base = 10);
+    String(long long value) : text(std::to_string(value)) {}
+    String(unsigned long long value) : text(std::to_string(value)) {}
+    String(float value, unsigned char decimals = 2) : String((double)value, decimals) {}
+    String(double value, unsigned char decimals = 2);
+
+    const char* c_str() const { return text.c_str(); }
+    unsigned int length() const { return text.size(); }
+    bool isEmpty() const { return text.empty(); }
+    bool reserve(unsigned int size) { text.reserve(size); return true; }
+    void clear() { text.clear(); }
+
+    bool concat(const String& other) { text += other.text; return true; }
+    bool concat(const char* other) { text += other != nullptr ? other : ""; return true; }
+    bool concat(const char* other, unsigned int length) { text.append(other, length); return true; }
+    bool concat(char c) { text += c; return true; }
+    template <typename T> bool concat(T value) { return concat(String(value)); }
+    template <typename T> String& operator+=(const T& value) { concat(value); return *this; }
+
+    bool equals(const String& other) const { return text == other.text; }
+    bool equals(const char* other) const { return text == (other != nullptr ? other : ""); }
+    bool equalsIgnoreCase(const String& other) const;
+    bool startsWith(const String& prefix) const { return text.compare(0, prefix.text.size(), prefix.text) == 0; }
+    bool endsWith(const String& suffix) const;
+    bool operator==(const String& other) const { return equals(other); }
+    bool operator==(const char* other) const { return equals(other); }
+    bool operator!=(const String& other) const { return !equals(other); }
+    bool operator!=(const char* other) const { return !equals(other); }
+    bool operator<(const String& other) const { return text < other.text; }
+
+    char charAt(unsigned int index) const { return index < text.size() ? text[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    char& operator[](unsigned int index) { return text[index]; }
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String& other, unsigned int from = 0) const;
+    int lastIndexOf(char c) const;
+    String substring(unsigned int from) const { return substring(from, text.size()); }
+    String substring(unsigned int from, unsigned int to) const;
+
+    long toInt() const { return strtol(text.c_str(), nullptr, 10); }
+    float toFloat() const { return strtof(text.c_str(), nullptr); }
+    double toDouble() const { return strtod(text.c_str(), nullptr); }
+    void trim();
+    void toLowerCase();
+    void toUpperCase();
+    void replace(const String& find, const String& with);
+    void remove(unsigned int index) { remove(index, text.size()); }
+    void remove(unsigned int index, unsigned int count);
+
+private:
+    std::string text;
+};
+
+String operator+(const String& left, const String& right);
+String operator+(const String& left, const char* right);
+String operator+(const char* left, const String& right);
+String operator+(const String& left, char right);
+template <typename T> String operator+(const String& left, T right) { return left + String(right); }
+
+class Print;
+
+/**
+ * @brief Something that can print itself, such as an IPAddress.
+ */
+class Printable {
+public:
+    virtual ~Printable() {}
+    virtual size_t printTo(Print& out) const = 0;
+};
+
+/**
+ * @brief Arduino's Print: everything that prints text builds on `write()`.
+ */
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* text) { return text != nullptr ? write((const uint8_t*)text, strlen(text)) : 0; }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+    virtual void flush() {}
+
+    size_t print(const char* text) { return write(text); }
+    size_t print(const String& text) { return write(text.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char value, int base = 10) { return print((unsigned long)value, base); }
+    size_t print(int value, int base = 10) { return print((long)value, base); }
+    size_t print(unsigned int value, int base = 10) { return print((unsigned long)value, base); }
+    size_t print(long value, int base = 10);
+    size_t print(unsigned long value, int base = 10);
+    size_t print(long long value);
+    size_t print(unsigned long long value);
+    size_t print(double value, int decimals = 2);
+    size_t print(const Printable& value) { return value.printTo(*this); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(const T& value) { size_t n = print(value); return n + println(); }
+    template <typename T> size_t println(const T& value, int format) { size_t n = print(value, format); return n + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+/**
+ * @brief Arduino's Stream: a Print that can also be read.
+ */
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    void setTimeout(unsigned long ms) { timeout = ms; }
+    virtual size_t readBytes(uint8_t* buffer, size_t length);
+    size_t readBytes(char* buffer, size_t length) { return readBytes((uint8_t*)buffer, length); }
+    String readString();
+
+protected:
+    unsigned long timeout = 1000;
+};
+
+/**
+ * @brief The serial port: output goes to standard output, input comes from `--serial`.
+ */
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int peek() override;
+    void flush() override { fflush(stdout); }
+};
+
+extern HardwareSerial Serial;
+
+/**
+ * @brief The ESP object: heap and CPU figures, from the host where they exist.
+ */
+class EspClass {
+public:
+    uint32_t getFreeHeap();
+    uint32_t getMaxFreeBlockSize();
+    uint8_t getHeapFragmentation();
+    uint32_t getCycleCount();
+    uint8_t getCpuFreqMHz() { return 80; }
+    uint32_t getChipId() { return 0x00C0FFEE; }
+    void restart();
+};
+
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,364 @@
+#include <ESPAsyncWebServer.h>
+#include <errno.h>
+#include <poll.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <algorithm>
+
+#include "NativeHal.h"
+
+#define NATIVE_WS_SEGMENT 1460      // bytes received at a time, one TCP segment as on the ESP
+#define NATIVE_WS_MAX_FRAME 16384   // longest frame accepted, as the ESP could never hold more
+#define NATIVE_WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11" // RFC 6455 handshake constant
+
+namespace {
+
+uint32_t rotate(uint32_t value, int bits) {
+  return (value << bits) | (value >> (32 - bits));
+}
+
+/**
+ * @brief SHA-1 of `text`, for the handshake's `Sec-WebSocket-Accept`.
+ */
+std::string sha1(const std::string& text) {
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  std::string message = text;
+  uint64_t bits = (uint64_t)text.size() * 8;
+  message += (char)0x80;
+  while (message.size() % 64 != 56) {
+    message += (char)0;
+  }
+  for (int i = 7; i >= 0; i--) {
+    message += (char)(bits >> (i * 8));
+  }
+  for (size_t block = 0; block < message.size(); block += 64) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+      const uint8_t* p = (const uint8_t*)message.data() + block + i * 4;
+      w[i] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+    }
+    for (int i = 16; i < 80; i++) {
+      w[i] = rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+      uint32_t f, k;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      uint32_t next = rotate(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = rotate(b, 30);
+      b = a;
+      a = next;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+  std::string digest;
+  for (uint32_t word : h) {
+    for (int i = 3; i >= 0; i--) {
+      digest += (char)(word >> (i * 8));
+    }
+  }
+  return digest;
+}
+
+std::string base64(const std::string& data) {
+  static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string encoded;
+  for (size_t i = 0; i < data.size(); i += 3) {
+    uint32_t group = (uint8_t)data[i] << 16;
+    if (i + 1 < data.size()) {
+      group |= (uint8_t)data[i + 1] << 8;
+    }
+    if (i + 2 < data.size()) {
+      group |= (uint8_t)data[i + 2];
+    }
+    encoded += digits[(group >> 18) & 63];
+    encoded += digits[(group >> 12) & 63];
+    encoded += i + 1 < data.size() ? digits[(group >> 6) & 63] : '=';
+    encoded += i + 2 < data.size() ? digits[group & 63] : '=';
+  }
+  return encoded;
+}
+
+void sendAll(int socket, const std::string& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t count = ::send(socket, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+    if (count > 0) {
+      written += count;
+    } else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      struct pollfd writable = {socket, POLLOUT, 0};
+      ::poll(&writable, 1, 100);
+    } else {
+      break;
+    }
+  }
+}
+
+} // namespace
+
+AsyncWebSocketClient::AsyncWebSocketClient(int socket, uint32_t id) : socket(socket), clientId(id) {
+}
+
+AsyncWebSocketClient::~AsyncWebSocketClient() {
+  if (socket >= 0) {
+    ::close(socket);
+  }
+}
+
+/**
+ * @brief Sends a close frame; the connection goes once the client answers or hangs up.
+ */
+void AsyncWebSocketClient::close(uint16_t code, const char* message) {
+  if (state != WS_CONNECTED) {
+    return;
+  }
+  std::string payload;
+  if (code != 0) {
+    payload += (char)(code >> 8);
+    payload += (char)code;
+    if (message != nullptr) {
+      payload += message;
+    }
+  }
+  sendFrame(WS_DISCONNECT, (const uint8_t*)payload.data(), payload.size());
+  state = WS_DISCONNECTING;
+}
+
+void AsyncWebSocketClient::ping(const uint8_t* data, size_t len) {
+  sendFrame(WS_PING, data, len);
+}
+
+void AsyncWebSocketClient::text(const char* message) {
+  text(message, strlen(message));
+}
+
+void AsyncWebSocketClient::text(const char* message, size_t len) {
+  sendFrame(WS_TEXT, (const uint8_t*)message, len);
+}
+
+void AsyncWebSocketClient::binary(const uint8_t* message, size_t len) {
+  sendFrame(WS_BINARY, message, len);
+}
+
+void AsyncWebSocketClient::binary(const char* message, size_t len) {
+  sendFrame(WS_BINARY, (const uint8_t*)message, len);
+}
+
+/**
+ * @brief Sends one unmasked frame, as a server does.
+ */
+void AsyncWebSocketClient::sendFrame(uint8_t opcode, const uint8_t* data, size_t len) {
+  if (state == WS_DISCONNECTED || socket < 0) {
+    return;
+  }
+  std::string frame;
+  frame += (char)(0x80 | opcode);
+  if (len < 126) {
+    frame += (char)len;
+  } else if (len <= 0xFFFF) {
+    frame += (char)126;
+    frame += (char)(len >> 8);
+    frame += (char)len;
+  } else {
+    frame += (char)127;
+    for (int i = 7; i >= 0; i--) {
+      frame += (char)((uint64_t)len >> (i * 8));
+    }
+  }
+  frame.append((const char*)data, len);
+  sendAll(socket, frame);
+}
+
+AsyncWebSocket::AsyncWebSocket(const String& url) : path(url) {
+}
+
+AsyncWebSocket::~AsyncWebSocket() {
+  clients.clear();
+}
+
+size_t AsyncWebSocket::count() const {
+  return std::count_if(clients.begin(), clients.end(), [](const std::unique_ptr<AsyncWebSocketClient>& client) {
+    return client->status() == WS_CONNECTED;
+  });
+}
+
+AsyncWebSocketClient* AsyncWebSocket::client(uint32_t id) {
+  for (auto& client : clients) {
+    if (client->id() == id && client->status() == WS_CONNECTED) {
+      return client.get();
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Closes the oldest clients while there are more than `maxClients`.
+ */
+void AsyncWebSocket::cleanupClients(uint16_t maxClients) {
+  for (auto& client : clients) {
+    if (count() <= maxClients) {
+      break;
+    }
+    client->close();
+  }
+}
+
+void AsyncWebSocket::closeAll(uint16_t code, const char* message) {
+  for (auto& client : clients) {
+    client->close(code, message);
+  }
+}
+
+void AsyncWebSocket::textAll(const char* message) {
+  for (auto& client : clients) {
+    if (client->status() == WS_CONNECTED) {
+      client->text(message);
+    }
+  }
+}
+
+void AsyncWebSocket::binaryAll(const uint8_t* message, size_t len) {
+  for (auto& client : clients) {
+    if (client->status() == WS_CONNECTED) {
+      client->binary(message, len);
+    }
+  }
+}
+
+bool AsyncWebSocket::canHandle(AsyncWebServerRequest* request) {
+  return request->method() == HTTP_GET && request->url() == path
+      && request->header("Upgrade").equalsIgnoreCase("websocket");
+}
+
+/**
+ * @brief Answers the upgrade request and takes its connection over as a client.
+ */
+void AsyncWebSocket::handleRequest(AsyncWebServerRequest* request) {
+  String key = request->header("Sec-WebSocket-Key");
+  if (key.length() == 0) {
+    request->send(400);
+    return;
+  }
+  std::string accept = base64(sha1(std::string(key.c_str()) + NATIVE_WS_GUID));
+  sendAll(request->socket, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                           "Sec-WebSocket-Accept: " + accept + "\r\n\r\n");
+  clients.emplace_back(new AsyncWebSocketClient(request->socket, nextId++));
+  request->socket = -1; // the server forgets the connection without closing it
+  request->sent = true;
+  if (!serviceAdded) {
+    NativeHal::addService([this]() { poll(); });
+    serviceAdded = true;
+  }
+  if (eventHandler) {
+    eventHandler(this, clients.back().get(), WS_EVT_CONNECT, nullptr, nullptr, 0);
+  }
+}
+
+/**
+ * @brief Reads what has arrived for each client and drops the ones that have gone.
+ */
+void AsyncWebSocket::poll() {
+  for (size_t i = 0; i < clients.size(); i++) {
+    AsyncWebSocketClient& client = *clients[i];
+    uint8_t segment[NATIVE_WS_SEGMENT];
+    ssize_t got;
+    while ((got = recv(client.socket, segment, sizeof(segment), 0)) > 0) {
+      client.received.append((const char*)segment, got);
+    }
+    if (client.state != WS_DISCONNECTED) {
+      readFrames(client);
+    }
+    if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+      if (client.state != WS_DISCONNECTED && eventHandler) {
+        eventHandler(this, &client, WS_EVT_DISCONNECT, nullptr, nullptr, 0);
+      }
+      client.state = WS_DISCONNECTED;
+    }
+  }
+  clients.erase(std::remove_if(clients.begin(), clients.end(), [](const std::unique_ptr<AsyncWebSocketClient>& client) {
+    return client->status() == WS_DISCONNECTED;
+  }), clients.end());
+}
+
+/**
+ * @brief Passes each whole frame received to the event handler.
+ */
+void AsyncWebSocket::readFrames(AsyncWebSocketClient& client) {
+  std::string& in = client.received;
+  while (in.size() >= 2 && client.state != WS_DISCONNECTED) {
+    const uint8_t* p = (const uint8_t*)in.data();
+    AwsFrameInfo info = {};
+    info.final = p[0] >> 7;
+    info.opcode = p[0] & 0x0F;
+    info.masked = p[1] >> 7;
+    uint64_t length = p[1] & 0x7F;
+    size_t header = 2;
+    if (length == 126) {
+      header = 4;
+      length = in.size() >= header ? (uint64_t)p[2] << 8 | p[3] : 0;
+    } else if (length == 127) {
+      header = 10;
+      length = 0;
+      for (size_t b = 2; b < header && b < in.size(); b++) {
+        length = length << 8 | p[b];
+      }
+    }
+    if (length > NATIVE_WS_MAX_FRAME) {
+      client.close(1009);
+      in.clear();
+      return;
+    }
+    if (info.masked) {
+      header += 4;
+    }
+    if (in.size() < header + length) {
+      return; // the rest is on its way
+    }
+    uint8_t* data = (uint8_t*)&in[header];
+    if (info.masked) {
+      memcpy(info.mask, &in[header - 4], 4);
+      for (uint64_t b = 0; b < length; b++) {
+        data[b] ^= info.mask[b % 4];
+      }
+    }
+    info.len = length;
+    info.message_opcode = info.opcode;
+    if (info.opcode == WS_PING) {
+      client.sendFrame(WS_PONG, data, length);
+    } else if (info.opcode == WS_DISCONNECT) {
+      if (client.state == WS_CONNECTED) {
+        client.sendFrame(WS_DISCONNECT, data, length < 2 ? length : 2);
+      }
+      if (eventHandler) {
+        eventHandler(this, &client, WS_EVT_DISCONNECT, nullptr, nullptr, 0);
+      }
+      client.state = WS_DISCONNECTED;
+    } else if (info.opcode == WS_PONG) {
+      if (eventHandler) {
+        eventHandler(this, &client, WS_EVT_PONG, nullptr, data, length);
+      }
+    } else if (eventHandler && client.state == WS_CONNECTED) {
+      eventHandler(this, &client, WS_EVT_DATA, &info, data, length);
+    }
+    in.erase(0, header + length);
+  }
+}
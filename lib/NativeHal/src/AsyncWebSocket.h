@@ -0,0 +1,95 @@
+#ifndef NATIVEHAL_ASYNCWEBSOCKET_H
+#define NATIVEHAL_ASYNCWEBSOCKET_H
+
+#include <Arduino.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class AsyncWebSocket;
+
+typedef enum { WS_CONTINUATION, WS_TEXT, WS_BINARY, WS_DISCONNECT = 0x08, WS_PING, WS_PONG } AwsFrameType;
+typedef enum { WS_DISCONNECTED, WS_CONNECTED, WS_DISCONNECTING } AwsClientStatus;
+typedef enum { WS_EVT_CONNECT, WS_EVT_DISCONNECT, WS_EVT_PONG, WS_EVT_ERROR, WS_EVT_DATA } AwsEventType;
+
+/**
+ * @brief What the library passes as `arg` with `WS_EVT_DATA`.
+ */
+typedef struct {
+  uint8_t message_opcode;
+  uint32_t num;
+  uint8_t final;
+  uint8_t masked;
+  uint8_t opcode;
+  uint64_t len;
+  uint8_t mask[4];
+  uint64_t index;
+} AwsFrameInfo;
+
+/**
+ * @brief One WebSocket connection.
+ */
+class AsyncWebSocketClient {
+public:
+    AsyncWebSocketClient(int socket, uint32_t id);
+    ~AsyncWebSocketClient();
+    uint32_t id() const { return clientId; }
+    AwsClientStatus status() const { return state; }
+    void close(uint16_t code = 0, const char* message = nullptr);
+    void ping(const uint8_t* data = nullptr, size_t len = 0);
+    void text(const char* message);
+    void text(const char* message, size_t len);
+    void binary(const uint8_t* message, size_t len);
+    void binary(const char* message, size_t len);
+
+private:
+    friend class AsyncWebSocket;
+
+    void sendFrame(uint8_t opcode, const uint8_t* data, size_t len);
+
+    int socket;
+    uint32_t clientId;
+    AwsClientStatus state = WS_CONNECTED;
+    std::string received; // bytes not yet making up a whole frame
+};
+
+typedef std::function<void(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg,
+                           uint8_t* data, size_t len)> AwsEventHandler;
+
+/**
+ * @brief AsyncWebSocket for the native env: a handler that takes over the connection of
+ *        an upgrade request to its URL.
+ *
+ * Frames are passed to the event handler whole, with `index` 0 and `final` set, and pings
+ * are answered with pongs, as the library does. Bytes sent after the upgrade request in
+ * the same segment, before the handshake reply, are dropped; clients wait for the reply.
+ */
+class AsyncWebSocket : public AsyncWebHandler {
+public:
+    explicit AsyncWebSocket(const String& url);
+    ~AsyncWebSocket();
+    const char* url() const { return path.c_str(); }
+    void onEvent(AwsEventHandler handler) { eventHandler = handler; }
+    size_t count() const;
+    AsyncWebSocketClient* client(uint32_t id);
+    void cleanupClients(uint16_t maxClients = 8);
+    void closeAll(uint16_t code = 0, const char* message = nullptr);
+    void textAll(const char* message);
+    void binaryAll(const uint8_t* message, size_t len);
+
+    bool canHandle(AsyncWebServerRequest* request) override;
+    void handleRequest(AsyncWebServerRequest* request) override;
+
+private:
+    void poll();
+    void readFrames(AsyncWebSocketClient& client);
+
+    String path;
+    AwsEventHandler eventHandler;
+    std::vector<std::unique_ptr<AsyncWebSocketClient>> clients;
+    uint32_t nextId = 1;
+    bool serviceAdded = false;
+};
+
+#endif
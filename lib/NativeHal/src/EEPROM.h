@@ -0,0 +1,6 @@
+#ifndef NATIVEHAL_EEPROM_H
+#define NATIVEHAL_EEPROM_H
+
+// Included by the sketch but not used; the firmware keeps its settings on LittleFS.
+
+#endif
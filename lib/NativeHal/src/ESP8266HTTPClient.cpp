@@ -0,0 +1,244 @@
+#include <ESP8266HTTPClient.h>
+
+/**
+ * @brief Prepares a request to `url`, of the form http://host[:port]/path, on a clone of
+ *        `client`, dropping any connection the previous clone had.
+ *
+ * @return `false` if the URL is not a plain http URL.
+ */
+bool HTTPClient::begin(WiFiClient& client, const String& url) {
+  this->client = client.clone();
+  return parseURL(url);
+}
+
+/**
+ * @brief Points the next request somewhere else. A path alone (starting with `/`) keeps
+ *        the host and the open connection; a full URL is parsed as `begin()` does.
+ *
+ * @return `false` if the URL is not a path or a plain http URL.
+ */
+bool HTTPClient::setURL(const String& url) {
+  if (url.startsWith("/")) {
+    path = url;
+    requestHeaders.clear();
+    size = -1;
+    chunked = false;
+    return true;
+  }
+  return parseURL(url);
+}
+
+/**
+ * @brief Finishes with the response: unread data is dropped, and the connection is kept
+ *        only if it can be reused. Otherwise it is closed and the clone let go, so the
+ *        next request needs `begin()` again, as in core 3.x.
+ */
+void HTTPClient::end() {
+  requestHeaders.clear();
+  if (client == nullptr) {
+    return;
+  }
+  if (reuse && canReuse && client->connected()) {
+    while (client->available() > 0) {
+      client->read();
+    }
+    return;
+  }
+  client->stop();
+  client.reset();
+}
+
+bool HTTPClient::connected() {
+  return client != nullptr && client->connected();
+}
+
+void HTTPClient::addHeader(const String& name, const String& value) {
+  requestHeaders.push_back(std::make_pair(name, value));
+}
+
+void HTTPClient::collectHeaders(const char* keys[], size_t count) {
+  collected.clear();
+  for (size_t i = 0; i < count; i++) {
+    collected.push_back(std::make_pair(String(keys[i]), String()));
+  }
+}
+
+String HTTPClient::header(const char* name) {
+  for (auto& header : collected) {
+    if (header.first.equalsIgnoreCase(name)) {
+      return header.second;
+    }
+  }
+  return String();
+}
+
+bool HTTPClient::hasHeader(const char* name) {
+  return header(name).length() > 0;
+}
+
+/**
+ * @brief Sends the request on the open connection, or a new one, and reads the response
+ *        headers.
+ *
+ * @return The HTTP status code, or an `HTTPC_ERROR_*` code.
+ */
+int HTTPClient::sendRequest(const char* method, const String& payload) {
+  return sendRequest(method, (const uint8_t*)payload.c_str(), payload.length());
+}
+
+int HTTPClient::sendRequest(const char* method, const uint8_t* payload, size_t length) {
+  if (client == nullptr) {
+    return HTTPC_ERROR_CONNECTION_FAILED; // begin() was not called, or end() let the clone go
+  }
+  if (!client->connected() && !client->connect(host.c_str(), port)) {
+    return HTTPC_ERROR_CONNECTION_FAILED;
+  }
+
+  String request = String(method) + " " + path + " HTTP/1.1\r\nHost: " + host;
+  if (port != 80) {
+    request += ":" + String(port);
+  }
+  request += "\r\nUser-Agent: ESP8266HTTPClient\r\nAccept-Encoding: identity;q=1,chunked;q=0.1,*;q=0\r\n";
+  request += reuse ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+  for (auto& header : requestHeaders) {
+    request += header.first + ": " + header.second + "\r\n";
+  }
+  if (length > 0 || strcmp(method, "POST") == 0) {
+    request += "Content-Length: " + String((unsigned long)length) + "\r\n";
+  }
+  request += "\r\n";
+  if (client->write(request.c_str()) != request.length()) {
+    client->stop();
+    return HTTPC_ERROR_SEND_HEADER_FAILED;
+  }
+  if (length > 0 && client->write(payload, length) != length) {
+    client->stop();
+    return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+  }
+
+  for (auto& header : collected) {
+    header.second = String();
+  }
+  size = -1;
+  chunked = false;
+  canReuse = reuse;
+
+  String line;
+  if (!readLine(line)) {
+    int error = client->connected() ? HTTPC_ERROR_READ_TIMEOUT : HTTPC_ERROR_CONNECTION_LOST;
+    client->stop();
+    return error;
+  }
+  int code = 0;
+  if (sscanf(line.c_str(), "HTTP/1.%*d %d", &code) != 1) {
+    client->stop();
+    return HTTPC_ERROR_NO_HTTP_SERVER;
+  }
+  while (readLine(line) && line.length() > 0) {
+    int colon = line.indexOf(':');
+    if (colon < 0) {
+      continue;
+    }
+    String name = line.substring(0, colon);
+    String value = line.substring(colon + 1);
+    value.trim();
+    if (name.equalsIgnoreCase("Content-Length")) {
+      size = value.toInt();
+    } else if (name.equalsIgnoreCase("Transfer-Encoding")) {
+      chunked = value.equalsIgnoreCase("chunked");
+    } else if (name.equalsIgnoreCase("Connection")) {
+      canReuse = canReuse && !value.equalsIgnoreCase("close");
+    }
+    for (auto& header : collected) {
+      if (header.first.equalsIgnoreCase(name)) {
+        header.second = value;
+      }
+    }
+  }
+  if (size < 0 && !chunked) {
+    canReuse = false; // the body ends when the server closes the connection
+  }
+  return code;
+}
+
+/**
+ * @brief Reads the whole response body.
+ *
+ * @return The body, empty if it could not be read.
+ */
+String HTTPClient::getString() {
+  String body;
+  if (client == nullptr || !readBody(body)) {
+    return String();
+  }
+  return body;
+}
+
+/**
+ * @brief Reads one header line, without its line ending.
+ *
+ * @return `false` if no full line arrived within the timeout.
+ */
+bool HTTPClient::readLine(String& line) {
+  line = String();
+  while (client->waitAvailable(timeout)) {
+    int c = client->read();
+    if (c == '\n') {
+      return true;
+    }
+    if (c != '\r') {
+      line.concat((char)c);
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Reads the body into `body`, removing the chunk framing if there is any.
+ */
+bool HTTPClient::readBody(String& body) {
+  if (!chunked) {
+    while ((size < 0 || (int)body.length() < size) && client->waitAvailable(timeout)) {
+      body.concat((char)client->read());
+    }
+    return size < 0 || (int)body.length() == size;
+  }
+  String line;
+  while (readLine(line)) {
+    long chunkSize = strtol(line.c_str(), nullptr, 16);
+    if (chunkSize == 0) {
+      while (readLine(line) && line.length() > 0) {
+        // trailer headers are dropped
+      }
+      return true;
+    }
+    for (long i = 0; i < chunkSize; i++) {
+      if (!client->waitAvailable(timeout)) {
+        return false;
+      }
+      body.concat((char)client->read());
+    }
+    readLine(line); // the line ending after the chunk
+  }
+  return false;
+}
+
+/**
+ * @brief Takes the host, port and path from an http://host[:port]/path URL.
+ */
+bool HTTPClient::parseURL(const String& url) {
+  requestHeaders.clear();
+  size = -1;
+  chunked = false;
+  if (!url.startsWith("http://")) {
+    return false;
+  }
+  String rest = url.substring(7);
+  int slash = rest.indexOf('/');
+  String authority = slash < 0 ? rest : rest.substring(0, slash);
+  path = slash < 0 ? String("/") : rest.substring(slash);
+  int colon = authority.indexOf(':');
+  host = colon < 0 ? authority : authority.substring(0, colon);
+  port = colon < 0 ? 80 : authority.substring(colon + 1).toInt();
+  return host.length() > 0;
+}
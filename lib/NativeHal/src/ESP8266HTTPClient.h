@@ -0,0 +1,85 @@
+#ifndef NATIVEHAL_ESP8266HTTPCLIENT_H
+#define NATIVEHAL_ESP8266HTTPCLIENT_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#define HTTPC_ERROR_CONNECTION_FAILED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_CREATED 201
+#define HTTP_CODE_NO_CONTENT 204
+#define HTTP_CODE_NOT_MODIFIED 304
+#define HTTP_CODE_BAD_REQUEST 400
+#define HTTP_CODE_UNAUTHORIZED 401
+#define HTTP_CODE_FORBIDDEN 403
+#define HTTP_CODE_NOT_FOUND 404
+#define HTTP_CODE_INTERNAL_SERVER_ERROR 500
+
+/**
+ * @brief The ESP8266 core's HTTP/1.1 client, over a host WiFiClient.
+ *
+ * Only plain `http://` URLs. As on the ESP, the response body is left on the connection
+ * for `getString()` or `getStreamPtr()`, and `end()` keeps the connection open for the next
+ * request when `setReuse(true)` was called and the server allows it.
+ *
+ * As in core 3.x, `begin()` keeps a `clone()` of the caller's WiFiClient and connects that,
+ * so the connection is never seen through the caller's client, and each `begin()` drops
+ * the connection of the clone it replaces. To reuse a connection, change the path with
+ * `setURL()` and leave `begin()` alone.
+ */
+class HTTPClient {
+public:
+    bool begin(WiFiClient& client, const String& url);
+    bool setURL(const String& url);
+    void end();
+    bool connected();
+
+    void setReuse(bool reuse) { this->reuse = reuse; }
+    void setTimeout(uint16_t ms) { timeout = ms; }
+    void useHTTP10(bool http10) { (void)http10; }
+    void addHeader(const String& name, const String& value);
+    void collectHeaders(const char* keys[], size_t count);
+    String header(const char* name);
+    bool hasHeader(const char* name);
+
+    int GET() { return sendRequest("GET", String()); }
+    int POST(const String& payload) { return sendRequest("POST", payload); }
+    int sendRequest(const char* method, const String& payload);
+    int sendRequest(const char* method, const uint8_t* payload = nullptr, size_t length = 0);
+
+    int getSize() { return size; }
+    WiFiClient* getStreamPtr() { return connected() ? client.get() : nullptr; }
+    WiFiClient& getStream() { return *client; }
+    String getString();
+
+private:
+    bool parseURL(const String& url);
+    bool readLine(String& line);
+    bool readBody(String& body);
+
+    std::unique_ptr<WiFiClient> client; // the clone begin() made, null once end() has closed it
+    String host;
+    uint16_t port = 80;
+    String path;
+    bool reuse = true;
+    bool canReuse = false;
+    uint16_t timeout = 5000;
+    int size = -1;
+    bool chunked = false;
+
+    std::vector<std::pair<String, String>> requestHeaders;
+    std::vector<std::pair<String, String>> collected; // keys from collectHeaders(), with this response's values
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef NATIVEHAL_ESP8266WIFI_H
+#define NATIVEHAL_ESP8266WIFI_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <WiFiClient.h>
+
+#define WL_IDLE_STATUS 0
+#define WL_DISCONNECTED 6
+#define WL_CONNECTED 3
+
+#define WIFI_OFF 0
+#define WIFI_STA 1
+
+#define WIFI_NONE_SLEEP 0
+#define WIFI_LIGHT_SLEEP 1
+#define WIFI_MODEM_SLEEP 2
+
+/**
+ * @brief Wi-Fi on the host: connected on loopback, at the `--ip` address, unless the run is
+ *        `--offline` or the radio has been put to sleep.
+ */
+class WiFiClass {
+public:
+    void mode(int mode) { radioMode = mode; }
+    int begin(const char* ssid, const char* password) { (void)ssid; (void)password; radioMode = WIFI_STA; return status(); }
+    int status();
+    bool isConnected() { return status() == WL_CONNECTED; }
+    IPAddress localIP();
+    IPAddress broadcastIP() { return IPAddress(127, 255, 255, 255); }
+    bool forceSleepBegin() { asleep = true; return true; }
+    bool forceSleepWake() { asleep = false; return true; }
+    bool setSleepMode(int mode) { (void)mode; return true; }
+
+private:
+    int radioMode = WIFI_STA;
+    bool asleep = false;
+};
+
+extern WiFiClass WiFi;
+
+#endif
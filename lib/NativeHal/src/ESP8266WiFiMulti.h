@@ -0,0 +1,12 @@
+#ifndef NATIVEHAL_ESP8266WIFIMULTI_H
+#define NATIVEHAL_ESP8266WIFIMULTI_H
+
+#include <ESP8266WiFi.h>
+
+class ESP8266WiFiMulti {
+public:
+    bool addAP(const char* ssid, const char* password) { (void)ssid; (void)password; return true; }
+    int run() { return WiFi.status(); }
+};
+
+#endif
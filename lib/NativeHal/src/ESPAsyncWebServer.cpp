@@ -0,0 +1,363 @@
+#include <ESPAsyncWebServer.h>
+#include <errno.h>
+#include <poll.h>
+#include <strings.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <string>
+
+#include "NativeHal.h"
+
+#define NATIVE_WEB_SEGMENT 1460 // bytes received at a time, one TCP segment as on the ESP
+#define NATIVE_WEB_HEAD 8192    // longest request line and headers accepted
+
+struct AsyncWebServer::Connection {
+  explicit Connection(int socket) { request.socket = socket; }
+  ~Connection() {
+    if (request.socket >= 0) {
+      close(request.socket);
+    }
+  }
+
+  AsyncWebServerRequest request;
+  std::string head;                   // received, not yet parsed
+  bool headRead = false;
+  AsyncWebHandler* handler = nullptr;
+  size_t bodyIndex = 0;
+  bool closed = false;
+};
+
+namespace {
+
+String urlDecode(const std::string& text) {
+  std::string decoded;
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '+') {
+      decoded += ' ';
+    } else if (text[i] == '%' && i + 2 < text.size()) {
+      decoded += (char)strtol(text.substr(i + 1, 2).c_str(), nullptr, 16);
+      i += 2;
+    } else {
+      decoded += text[i];
+    }
+  }
+  return String(decoded.c_str());
+}
+
+WebRequestMethodComposite parseMethod(const std::string& name) {
+  static const char* names[] = {"GET", "POST", "DELETE", "PUT", "PATCH", "HEAD", "OPTIONS"};
+  for (uint8_t i = 0; i < 7; i++) {
+    if (name == names[i]) {
+      return 1 << i;
+    }
+  }
+  return 0;
+}
+
+const char* reason(int code) {
+  switch (code) {
+    case 101: return "Switching Protocols";
+    case 200: return "OK";
+    case 201: return "Created";
+    case 202: return "Accepted";
+    case 204: return "No Content";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 409: return "Conflict";
+    case 411: return "Length Required";
+    case 413: return "Payload Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    default: return "";
+  }
+}
+
+} // namespace
+
+bool AsyncWebServerRequest::hasHeader(const char* name) const {
+  for (auto& header : headers) {
+    if (strcasecmp(header.first.c_str(), name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+String AsyncWebServerRequest::header(const char* name) const {
+  for (auto& header : headers) {
+    if (strcasecmp(header.first.c_str(), name) == 0) {
+      return header.second;
+    }
+  }
+  return String();
+}
+
+bool AsyncWebServerRequest::hasParam(const char* name, bool post, bool file) const {
+  return const_cast<AsyncWebServerRequest*>(this)->getParam(name, post, file) != nullptr;
+}
+
+AsyncWebParameter* AsyncWebServerRequest::getParam(const char* name, bool post, bool file) {
+  if (post || file) {
+    return nullptr; // only query parameters
+  }
+  for (auto& parameter : parameters) {
+    if (strcmp(parameter.name().c_str(), name) == 0) {
+      return &parameter;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Sends the response and closes the connection. Only the first call sends anything.
+ */
+void AsyncWebServerRequest::send(int code, const String& contentType, const String& content) {
+  if (sent || socket < 0) {
+    return;
+  }
+  sent = true;
+  std::string response = "HTTP/1.1 " + std::to_string(code) + " " + reason(code) + "\r\n";
+  if (contentType.length() > 0) {
+    response += std::string("Content-Type: ") + contentType.c_str() + "\r\n";
+  }
+  response += "Content-Length: " + std::to_string(content.length()) + "\r\nConnection: close\r\n\r\n";
+  response += content.c_str();
+  size_t written = 0;
+  while (written < response.size()) {
+    ssize_t count = ::send(socket, response.data() + written, response.size() - written, MSG_NOSIGNAL);
+    if (count > 0) {
+      written += count;
+    } else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      struct pollfd writable = {socket, POLLOUT, 0};
+      ::poll(&writable, 1, 100);
+    } else {
+      break;
+    }
+  }
+  shutdown(socket, SHUT_WR);
+}
+
+bool AsyncCallbackWebHandler::canHandle(AsyncWebServerRequest* request) {
+  if (!(methods & request->method())) {
+    return false;
+  }
+  const String& url = request->url();
+  return uri.length() == 0 || url == uri || url.startsWith(uri + "/");
+}
+
+void AsyncCallbackWebHandler::handleRequest(AsyncWebServerRequest* request) {
+  if (onRequest) {
+    onRequest(request);
+  } else {
+    request->send(500);
+  }
+}
+
+void AsyncCallbackWebHandler::handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+  if (onBody) {
+    onBody(request, data, len, index, total);
+  }
+}
+
+AsyncWebServer::AsyncWebServer(uint16_t port) : port(port) {
+}
+
+AsyncWebServer::~AsyncWebServer() {
+  end();
+}
+
+/**
+ * @brief Starts listening on `NativeHal::listenPort()`, whatever port was asked for.
+ */
+void AsyncWebServer::begin() {
+  if (listener >= 0) {
+    return;
+  }
+  listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  int reuse = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  struct sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(NativeHal::listenPort());
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 4) != 0) {
+    fprintf(stderr, "native: web server could not listen on port %u\n", NativeHal::listenPort());
+    close(listener);
+    listener = -1;
+    return;
+  }
+  fprintf(stderr, "native: web server (port %u on the ESP) on port %u\n", port, NativeHal::listenPort());
+  if (!serviceAdded) {
+    NativeHal::addService([this]() { poll(); });
+    serviceAdded = true;
+  }
+}
+
+void AsyncWebServer::end() {
+  connections.clear();
+  if (listener >= 0) {
+    close(listener);
+    listener = -1;
+  }
+}
+
+AsyncCallbackWebHandler& AsyncWebServer::on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest) {
+  return on(uri, method, onRequest, nullptr, nullptr);
+}
+
+AsyncCallbackWebHandler& AsyncWebServer::on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                                            ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody) {
+  (void)onUpload; // multipart bodies are not parsed
+  AsyncCallbackWebHandler* handler = new AsyncCallbackWebHandler();
+  handler->uri = uri;
+  handler->methods = method;
+  handler->onRequest = onRequest;
+  handler->onBody = onBody;
+  callbackHandlers.emplace_back(handler);
+  handlers.push_back(handler);
+  return *handler;
+}
+
+AsyncWebHandler& AsyncWebServer::addHandler(AsyncWebHandler* handler) {
+  handlers.push_back(handler);
+  return *handler;
+}
+
+void AsyncWebServer::onNotFound(ArRequestHandlerFunction onRequest) {
+  notFound = onRequest;
+}
+
+/**
+ * @brief Accepts connections and passes whatever has arrived to the handlers.
+ */
+void AsyncWebServer::poll() {
+  if (listener < 0) {
+    return;
+  }
+  for (int fd; (fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK)) >= 0;) {
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    connections.emplace_back(new Connection(fd));
+  }
+  for (size_t i = 0; i < connections.size(); i++) {
+    Connection& connection = *connections[i];
+    uint8_t segment[NATIVE_WEB_SEGMENT];
+    ssize_t got = recv(connection.request.socket, segment, sizeof(segment), 0);
+    if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+      connection.closed = true;
+      continue;
+    }
+    if (got < 0 || connection.request.sent) {
+      continue;
+    }
+    if (connection.headRead) {
+      readBody(connection, segment, got);
+      continue;
+    }
+    connection.head.append((const char*)segment, got);
+    if (readHead(connection)) {
+      std::string rest;
+      rest.swap(connection.head);
+      readBody(connection, (uint8_t*)rest.data(), rest.size());
+    }
+  }
+  connections.erase(std::remove_if(connections.begin(), connections.end(), [](const std::unique_ptr<Connection>& connection) {
+    return connection->closed || connection->request.sent;
+  }), connections.end());
+}
+
+/**
+ * @brief Parses the request line and headers once they have all arrived and picks the
+ *        handler. Leaves any body bytes after them in `connection.head`.
+ *
+ * @return `true` once the head has been read.
+ */
+bool AsyncWebServer::readHead(Connection& connection) {
+  size_t end = connection.head.find("\r\n\r\n");
+  if (end == std::string::npos) {
+    if (connection.head.size() > NATIVE_WEB_HEAD) {
+      connection.request.send(400);
+    }
+    return false;
+  }
+  std::string head = connection.head.substr(0, end);
+  connection.head.erase(0, end + 4);
+  connection.headRead = true;
+
+  AsyncWebServerRequest& request = connection.request;
+  size_t lineEnd = head.find("\r\n");
+  std::string line = head.substr(0, lineEnd);
+  size_t space = line.find(' ');
+  size_t secondSpace = line.find(' ', space + 1);
+  if (space == std::string::npos || secondSpace == std::string::npos) {
+    request.send(400);
+    return false;
+  }
+  request.requestMethod = parseMethod(line.substr(0, space));
+  std::string target = line.substr(space + 1, secondSpace - space - 1);
+  size_t query = target.find('?');
+  request.path = urlDecode(target.substr(0, query));
+  if (query != std::string::npos) {
+    std::string parameters = target.substr(query + 1);
+    size_t start = 0;
+    while (start < parameters.size()) {
+      size_t next = parameters.find('&', start);
+      std::string parameter = parameters.substr(start, next == std::string::npos ? std::string::npos : next - start);
+      size_t equals = parameter.find('=');
+      request.parameters.emplace_back(urlDecode(parameter.substr(0, equals)),
+                                      equals == std::string::npos ? String() : urlDecode(parameter.substr(equals + 1)));
+      start = next == std::string::npos ? parameters.size() : next + 1;
+    }
+  }
+  while (lineEnd != std::string::npos) {
+    size_t start = lineEnd + 2;
+    lineEnd = head.find("\r\n", start);
+    std::string header = head.substr(start, lineEnd == std::string::npos ? std::string::npos : lineEnd - start);
+    size_t colon = header.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    size_t value = header.find_first_not_of(' ', colon + 1);
+    request.headers.emplace_back(String(header.substr(0, colon).c_str()),
+                                 String(value == std::string::npos ? "" : header.substr(value).c_str()));
+  }
+  request.length = atol(request.header("Content-Length").c_str());
+
+  for (AsyncWebHandler* handler : handlers) {
+    if (handler->canHandle(&request)) {
+      connection.handler = handler;
+      break;
+    }
+  }
+  if (connection.handler == nullptr) {
+    if (notFound) {
+      notFound(&request);
+    }
+    request.send(404);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Passes body bytes to the handler, then runs the request handler once the whole
+ *        body has arrived.
+ */
+void AsyncWebServer::readBody(Connection& connection, uint8_t* data, size_t length) {
+  AsyncWebServerRequest& request = connection.request;
+  size_t total = request.contentLength();
+  length = std::min(length, total - connection.bodyIndex);
+  if (length > 0) {
+    connection.handler->handleBody(&request, data, length, connection.bodyIndex, total);
+    connection.bodyIndex += length;
+  }
+  if (connection.bodyIndex >= total && !request.sent) {
+    connection.handler->handleRequest(&request);
+    request.send(501); // the handler sent nothing
+  }
+}
@@ -0,0 +1,142 @@
+#ifndef NATIVEHAL_ESPASYNCWEBSERVER_H
+#define NATIVEHAL_ESPASYNCWEBSERVER_H
+
+#include <Arduino.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+typedef enum {
+  HTTP_GET = 0b00000001,
+  HTTP_POST = 0b00000010,
+  HTTP_DELETE = 0b00000100,
+  HTTP_PUT = 0b00001000,
+  HTTP_PATCH = 0b00010000,
+  HTTP_HEAD = 0b00100000,
+  HTTP_OPTIONS = 0b01000000,
+  HTTP_ANY = 0b01111111,
+} WebRequestMethod;
+typedef uint8_t WebRequestMethodComposite;
+
+class AsyncWebServerRequest;
+
+typedef std::function<void(AsyncWebServerRequest* request)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest* request, const String& filename, size_t index, uint8_t* data, size_t len, bool final)> ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total)> ArBodyHandlerFunction;
+
+/**
+ * @brief A query parameter of a request.
+ */
+class AsyncWebParameter {
+public:
+    AsyncWebParameter(const String& name, const String& value) : parameterName(name), parameterValue(value) {}
+    const String& name() const { return parameterName; }
+    const String& value() const { return parameterValue; }
+    bool isPost() const { return false; }
+    bool isFile() const { return false; }
+
+private:
+    String parameterName;
+    String parameterValue;
+};
+
+/**
+ * @brief One request, as the library passes it to the handlers.
+ */
+class AsyncWebServerRequest {
+public:
+    WebRequestMethodComposite method() const { return requestMethod; }
+    const String& url() const { return path; }
+    size_t contentLength() const { return length; }
+    bool hasHeader(const char* name) const;
+    String header(const char* name) const;
+    bool hasParam(const char* name, bool post = false, bool file = false) const;
+    AsyncWebParameter* getParam(const char* name, bool post = false, bool file = false);
+    size_t params() const { return parameters.size(); }
+    void send(int code, const String& contentType = String(), const String& content = String());
+
+private:
+    friend class AsyncWebServer;
+    friend class AsyncWebSocket;
+
+    int socket = -1;
+    WebRequestMethodComposite requestMethod = 0;
+    String path;
+    size_t length = 0;
+    std::vector<std::pair<String, String>> headers;
+    std::vector<AsyncWebParameter> parameters;
+    bool sent = false;
+};
+
+/**
+ * @brief Something that handles the requests it accepts.
+ */
+class AsyncWebHandler {
+public:
+    virtual ~AsyncWebHandler() {}
+    virtual bool canHandle(AsyncWebServerRequest* request) { (void)request; return false; }
+    virtual void handleRequest(AsyncWebServerRequest* request) { (void)request; }
+    virtual void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+      (void)request; (void)data; (void)len; (void)index; (void)total;
+    }
+};
+
+/**
+ * @brief The handler `AsyncWebServer::on()` adds: a URI, the methods it takes and callbacks.
+ */
+class AsyncCallbackWebHandler : public AsyncWebHandler {
+public:
+    bool canHandle(AsyncWebServerRequest* request) override;
+    void handleRequest(AsyncWebServerRequest* request) override;
+    void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) override;
+
+private:
+    friend class AsyncWebServer;
+
+    String uri;
+    WebRequestMethodComposite methods = HTTP_ANY;
+    ArRequestHandlerFunction onRequest;
+    ArBodyHandlerFunction onBody;
+};
+
+/**
+ * @brief ESPAsyncWebServer over a host socket, on `NativeHal::listenPort()`.
+ *
+ * As on the ESP, the callbacks run when the firmware gives the system time (see
+ * `NativeHal::addService()`), never in the middle of `loop()` code. Request bodies are
+ * passed to `handleBody()` in pieces as they arrive, at most a TCP segment at a time, and
+ * the request handler runs once the body is complete. Bodies need a `Content-Length`;
+ * multipart uploads are not parsed. Every response closes its connection, except for
+ * WebSocket upgrades, which AsyncWebSocket takes over.
+ */
+class AsyncWebServer {
+public:
+    AsyncWebServer(uint16_t port);
+    ~AsyncWebServer();
+    void begin();
+    void end();
+    AsyncCallbackWebHandler& on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest);
+    AsyncCallbackWebHandler& on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                                ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody = nullptr);
+    AsyncWebHandler& addHandler(AsyncWebHandler* handler);
+    void onNotFound(ArRequestHandlerFunction onRequest);
+
+private:
+    struct Connection;
+
+    void poll();
+    bool readHead(Connection& connection);
+    void readBody(Connection& connection, uint8_t* data, size_t length);
+
+    uint16_t port;
+    int listener = -1;
+    bool serviceAdded = false;
+    std::vector<std::unique_ptr<AsyncCallbackWebHandler>> callbackHandlers;
+    std::vector<AsyncWebHandler*> handlers;
+    ArRequestHandlerFunction notFound;
+    std::vector<std::unique_ptr<Connection>> connections;
+};
+
+#include "AsyncWebSocket.h"
+
+#endif
@@ -0,0 +1,146 @@
+#include <FS.h>
+#include <LittleFS.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+#include "NativeHal.h"
+
+fs::FS LittleFS;
+
+namespace {
+
+// Creates every missing directory leading up to `path`, as LittleFS does when a file is
+// opened for writing.
+bool makeParents(const String& path) {
+  std::string parents = path.c_str();
+  for (size_t slash = parents.find('/', 1); slash != std::string::npos; slash = parents.find('/', slash + 1)) {
+    std::string directory = parents.substr(0, slash);
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+namespace fs {
+
+File::File(FILE* file, const char* path) : handle(std::make_shared<Handle>(file, path)) {
+}
+
+File::Handle::~Handle() {
+  if (file != nullptr) {
+    fclose(file);
+  }
+}
+
+size_t File::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+  return *this ? fwrite(buffer, 1, size, handle->file) : 0;
+}
+
+int File::available() {
+  return *this ? (int)(size() - position()) : 0;
+}
+
+int File::read() {
+  return *this ? fgetc(handle->file) : -1;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+  return *this ? fread(buffer, 1, size, handle->file) : 0;
+}
+
+int File::peek() {
+  if (!*this) {
+    return -1;
+  }
+  int c = fgetc(handle->file);
+  if (c != EOF) {
+    ungetc(c, handle->file);
+  }
+  return c;
+}
+
+void File::flush() {
+  if (*this) {
+    fflush(handle->file);
+  }
+}
+
+bool File::seek(uint32_t position, SeekMode mode) {
+  static const int whence[] = {SEEK_SET, SEEK_CUR, SEEK_END};
+  return *this && fseek(handle->file, position, whence[mode]) == 0;
+}
+
+size_t File::position() const {
+  return *this ? ftell(handle->file) : 0;
+}
+
+size_t File::size() const {
+  if (!*this) {
+    return 0;
+  }
+  fflush(handle->file);
+  struct stat info;
+  return fstat(fileno(handle->file), &info) == 0 ? info.st_size : 0;
+}
+
+void File::close() {
+  if (handle && handle->file != nullptr) {
+    fclose(handle->file);
+    handle->file = nullptr;
+  }
+  handle.reset();
+}
+
+const char* File::name() const {
+  return handle ? handle->path.c_str() : "";
+}
+
+File::operator bool() const {
+  return handle && handle->file != nullptr;
+}
+
+/**
+ * @brief Creates the directory that holds the files, if it is missing.
+ */
+bool FS::begin() {
+  return makeParents(hostPath("/"));
+}
+
+/**
+ * @brief Opens a file with an ESP mode string: "r", "w", "a", "r+", "w+" or "a+".
+ */
+File FS::open(const char* path, const char* mode) {
+  String file = hostPath(path);
+  if (mode[0] != 'r' && !makeParents(file)) {
+    return File();
+  }
+  String hostMode = String(mode[0]) + "b" + (mode[1] == '+' ? "+" : "");
+  FILE* handle = fopen(file.c_str(), hostMode.c_str());
+  return handle != nullptr ? File(handle, path) : File();
+}
+
+bool FS::exists(const char* path) {
+  struct stat info;
+  return stat(hostPath(path).c_str(), &info) == 0;
+}
+
+bool FS::remove(const char* path) {
+  return ::remove(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char* from, const char* to) {
+  return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+String FS::hostPath(const char* path) {
+  return String(NativeHal::fsRoot()) + (path[0] == '/' ? "" : "/") + path;
+}
+
+} // namespace fs
@@ -0,0 +1,76 @@
+#ifndef NATIVEHAL_FS_H
+#define NATIVEHAL_FS_H
+
+#include <Arduino.h>
+#include <memory>
+
+enum SeekMode {
+  SeekSet = 0,
+  SeekCur = 1,
+  SeekEnd = 2
+};
+
+namespace fs {
+
+/**
+ * @brief An open file on the host. Copies share the handle, as on the ESP.
+ */
+class File : public Stream {
+public:
+    File() {}
+    File(FILE* handle, const char* path);
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    size_t read(uint8_t* buffer, size_t size);
+    int peek() override;
+    void flush() override;
+
+    bool seek(uint32_t position, SeekMode mode = SeekSet);
+    size_t position() const;
+    size_t size() const;
+    void close();
+    const char* name() const;
+    operator bool() const;
+
+private:
+    struct Handle {
+        FILE* file;
+        String path;
+        char cache[256]; // stdio's buffer, the size of a LittleFS file cache on the ESP
+        Handle(FILE* file, const char* path) : file(file), path(path) { setvbuf(file, cache, _IOFBF, sizeof(cache)); }
+        Handle(const Handle&) = delete;
+        ~Handle();
+    };
+    std::shared_ptr<Handle> handle;
+};
+
+/**
+ * @brief A filesystem kept in a directory on the host, see `NativeHal::fsRoot()`.
+ */
+class FS {
+public:
+    bool begin();
+    void end() {}
+    File open(const char* path, const char* mode);
+    File open(const String& path, const char* mode) { return open(path.c_str(), mode); }
+    bool exists(const char* path);
+    bool exists(const String& path) { return exists(path.c_str()); }
+    bool remove(const char* path);
+    bool remove(const String& path) { return remove(path.c_str()); }
+    bool rename(const char* from, const char* to);
+    bool rename(const String& from, const String& to) { return rename(from.c_str(), to.c_str()); }
+
+private:
+    static String hostPath(const char* path);
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+
+#endif
@@ -0,0 +1,85 @@
+// Counts the bytes the program has allocated, for ESP.getFreeHeap(). glibc's malloc keeps
+// freed blocks in per-size caches that it still reports as in use, so its own statistics
+// hardly move as the firmware allocates and frees; instead malloc and friends are wrapped
+// here. Not under AddressSanitizer, which wraps them itself.
+
+#include <stdlib.h>
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+
+#include <malloc.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* block, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* block);
+}
+
+static size_t liveBytes = 0;
+
+static void* counted(void* block) {
+  if (block != nullptr) {
+    liveBytes += malloc_usable_size(block);
+  }
+  return block;
+}
+
+extern "C" {
+
+void* malloc(size_t size) noexcept {
+  return counted(__libc_malloc(size));
+}
+
+void* calloc(size_t count, size_t size) noexcept {
+  return counted(__libc_calloc(count, size));
+}
+
+void* realloc(void* block, size_t size) noexcept {
+  size_t before = block != nullptr ? malloc_usable_size(block) : 0;
+  void* moved = __libc_realloc(block, size);
+  if (moved != nullptr || size == 0) {
+    liveBytes -= before;
+    counted(moved);
+  }
+  return moved;
+}
+
+void* memalign(size_t alignment, size_t size) noexcept {
+  return counted(__libc_memalign(alignment, size));
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+  return memalign(alignment, size);
+}
+
+int posix_memalign(void** block, size_t alignment, size_t size) noexcept {
+  *block = memalign(alignment, size);
+  return *block != nullptr ? 0 : 12; // ENOMEM
+}
+
+void free(void* block) noexcept {
+  if (block != nullptr) {
+    liveBytes -= malloc_usable_size(block);
+    __libc_free(block);
+  }
+}
+
+} // extern "C"
+
+namespace NativeHal {
+size_t heapUsed() {
+  return liveBytes;
+}
+} // namespace NativeHal
+
+#else
+
+namespace NativeHal {
+size_t heapUsed() {
+  return 0;
+}
+} // namespace NativeHal
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef NATIVEHAL_IPADDRESS_H
+#define NATIVEHAL_IPADDRESS_H
+
+#include <Arduino.h>
+
+/**
+ * @brief An IPv4 address, kept in network byte order as on the ESP.
+ */
+class IPAddress : public Printable {
+public:
+    IPAddress() {}
+    IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth)
+        : address(first | second << 8 | third << 16 | (uint32_t)fourth << 24) {}
+    IPAddress(uint32_t address) : address(address) {}
+
+    operator uint32_t() const { return address; }
+    bool operator==(const IPAddress& other) const { return address == other.address; }
+    bool operator!=(const IPAddress& other) const { return address != other.address; }
+    uint8_t operator[](int index) const { return (address >> (8 * index)) & 0xFF; }
+    bool isSet() const { return address != 0; }
+
+    bool fromString(const char* text);
+    String toString() const;
+    size_t printTo(Print& out) const override { return out.print(toString()); }
+
+private:
+    uint32_t address = 0;
+};
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef NATIVEHAL_LITTLEFS_H
+#define NATIVEHAL_LITTLEFS_H
+
+#include <FS.h>
+
+extern fs::FS LittleFS;
+
+#endif
@@ -0,0 +1,563 @@
+#include "NativeHal.h"
+
+#include <coredecls.h>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <deque>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+  bool virtualClock = true;
+  double seconds = NATIVE_DEFAULT_SECONDS;
+  uint64_t passes = 0; // 0 for no limit
+  std::string fs = NATIVE_DEFAULT_FS;
+  bool offline = false;
+  bool quiet = false;
+  uint16_t listen = NATIVE_DEFAULT_LISTEN;
+  std::string ip = NATIVE_DEFAULT_IP;
+  uint64_t clockOffsetUs = 0;
+  double clockDriftPpm = 0;
+};
+
+struct Stall {
+  uint64_t at;    // us the next stall starts
+  uint64_t us;    // how long it lasts
+  uint64_t every; // us between stalls, 0 for once
+};
+
+struct SerialLine {
+  uint64_t at; // virtual or real us the line is typed
+  std::string text;
+};
+
+Options options;
+// Kept apart from options: serverIP in the firmware is set from it during static
+// initialization, before options is constructed, and it has to stay valid once the
+// command line is read, so it is a constant-initialized array written in place.
+char server[NATIVE_SERVER_SIZE] = NATIVE_DEFAULT_SERVER;
+uint64_t virtualUs = 0;
+std::chrono::steady_clock::time_point realStart = std::chrono::steady_clock::now();
+uint64_t passCount = 0;
+uint64_t passStartCpuUs = 0;
+uint64_t longestPassCpuUs = 0; // host CPU time of the longest pass, see startPass()
+
+uint8_t pinLevels[17];
+uint16_t pinDuties[17];
+bool pinPwm[17];          // driven by analogWrite() rather than digitalWrite() or GPO
+uint32_t pwmRange = 255;
+uint32_t gpioWriteCount = 0;
+uint32_t pwmWriteCount = 0;
+void (*interruptHandlers[17])() = {};
+
+std::vector<SerialLine> serialLines; // still to be typed, in the order given
+std::deque<char> serialInput;        // typed, not yet read
+
+std::vector<std::function<void()>> services; // network servers, see addService()
+
+std::vector<Stall> stalls;
+uint32_t stallCount = 0;
+
+const uint8_t tracePins[3] = {D7, D6, D5}; // red, green and blue LEDs
+FILE* traceFile = nullptr;
+uint16_t tracedLevels[3] = {0xFFFF, 0xFFFF, 0xFFFF};
+
+// CPU time this thread has used on the host, which neither clock's waiting counts towards.
+uint64_t cpuMicros() {
+  struct timespec now;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+const char* setting(const char* name) {
+  std::string key = "MAGICPOI_" + std::string(name);
+  for (char& c : key) {
+    c = c == '-' ? '_' : toupper((unsigned char)c);
+  }
+  return getenv(key.c_str());
+}
+
+void addSerialLine(const char* option) {
+  const char* text = option;
+  uint64_t atMs = 0;
+  const char* colon = strchr(option, ':');
+  if (colon != nullptr && colon > option && strspn(option, "0123456789") == (size_t)(colon - option)) {
+    atMs = strtoull(option, nullptr, 10);
+    text = colon + 1;
+  }
+  serialLines.push_back(SerialLine{atMs * 1000, std::string(text) + "\n"});
+}
+
+void addStall(const char* option) {
+  unsigned long long at = 0;
+  unsigned long long ms = 0;
+  unsigned long long every = 0;
+  if (sscanf(option, "%llu:%llu:%llu", &at, &ms, &every) < 2) {
+    fprintf(stderr, "--stall needs AT:MS[:EVERY], got %s\n", option);
+    exit(2);
+  }
+  stalls.push_back(Stall{at * 1000, ms * 1000, every * 1000});
+}
+
+void openTrace(const char* path) {
+  traceFile = fopen(path, "w");
+  if (traceFile == nullptr) {
+    fprintf(stderr, "cannot write trace %s\n", path);
+    exit(2);
+  }
+  fprintf(traceFile, "# us red green blue, levels 0-%d\n", NATIVE_TRACE_RANGE);
+}
+
+// A pin's output as a level from 0 to NATIVE_TRACE_RANGE.
+uint16_t traceLevel(uint8_t pin) {
+  if (pinPwm[pin]) {
+    return (uint32_t)std::min<uint32_t>(pinDuties[pin], pwmRange) * NATIVE_TRACE_RANGE / pwmRange;
+  }
+  return NativeHal::pinLevel(pin) ? NATIVE_TRACE_RANGE : 0;
+}
+
+void setServer(const char* address) {
+  snprintf(server, sizeof(server), "%s", address);
+}
+
+void applySettingsFromEnvironment() {
+  if (setting("real") != nullptr) options.virtualClock = false;
+  if (const char* value = setting("seconds")) options.seconds = atof(value);
+  if (const char* value = setting("passes")) options.passes = strtoull(value, nullptr, 10);
+  if (const char* value = setting("server")) setServer(value);
+  if (const char* value = setting("fs")) options.fs = value;
+  if (const char* value = setting("listen")) options.listen = atoi(value);
+  if (const char* value = setting("ip")) options.ip = value;
+  if (const char* value = setting("clock-offset")) options.clockOffsetUs = (uint64_t)(atof(value) * 1000);
+  if (const char* value = setting("clock-drift")) options.clockDriftPpm = atof(value);
+  if (setting("offline") != nullptr) options.offline = true;
+  if (setting("quiet") != nullptr) options.quiet = true;
+  if (const char* value = setting("serial")) addSerialLine(value);
+  if (const char* value = setting("trace")) openTrace(value);
+  if (const char* value = setting("stall")) addStall(value);
+}
+
+// Moves the lines that are due into the input.
+void typeSerialLines() {
+  uint64_t now = NativeHal::nowMicros();
+  for (auto line = serialLines.begin(); line != serialLines.end();) {
+    if (line->at <= now) {
+      serialInput.insert(serialInput.end(), line->text.begin(), line->text.end());
+      line = serialLines.erase(line);
+    } else {
+      ++line;
+    }
+  }
+}
+
+} // namespace
+
+namespace NativeHal {
+
+/**
+ * @brief Reads the options from the environment and then the command line.
+ */
+void begin(int argc, char** argv) {
+  applySettingsFromEnvironment();
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--real") {
+      options.virtualClock = false;
+    } else if (arg == "--seconds" && hasValue) {
+      options.seconds = atof(argv[++i]);
+    } else if (arg == "--passes" && hasValue) {
+      options.passes = strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--server" && hasValue) {
+      setServer(argv[++i]);
+    } else if (arg == "--fs" && hasValue) {
+      options.fs = argv[++i];
+    } else if (arg == "--listen" && hasValue) {
+      options.listen = atoi(argv[++i]);
+    } else if (arg == "--ip" && hasValue) {
+      options.ip = argv[++i];
+    } else if (arg == "--clock-offset" && hasValue) {
+      options.clockOffsetUs = (uint64_t)(atof(argv[++i]) * 1000);
+    } else if (arg == "--clock-drift" && hasValue) {
+      options.clockDriftPpm = atof(argv[++i]);
+    } else if (arg == "--offline") {
+      options.offline = true;
+    } else if (arg == "--quiet") {
+      options.quiet = true;
+    } else if (arg == "--serial" && hasValue) {
+      addSerialLine(argv[++i]);
+    } else if (arg == "--trace" && hasValue) {
+      openTrace(argv[++i]);
+    } else if (arg == "--stall" && hasValue) {
+      addStall(argv[++i]);
+    } else {
+      fprintf(stderr, "unknown option %s, see lib/NativeHal/src/NativeHal.h\n", arg.c_str());
+      exit(2);
+    }
+  }
+  virtualUs = 0;
+  realStart = std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief Returns `true` until the run's time or pass limit is reached.
+ */
+bool running() {
+  if (options.passes > 0 && passCount >= options.passes) {
+    return false;
+  }
+  return nowMicros() < (uint64_t)(options.seconds * 1e6);
+}
+
+/**
+ * @brief Marks the start of a `loop()` pass, for the longest pass in `report()`.
+ */
+void startPass() {
+  passStartCpuUs = cpuMicros();
+}
+
+/**
+ * @brief Counts one `loop()` pass.
+ *
+ * The host CPU time the pass took is kept if it is the longest yet. Work that would hold
+ * up the LEDs on the ESP, such as sorting a whole timeline in one pass, shows there even
+ * on the virtual clock, which only moves when the firmware waits.
+ */
+void countPass() {
+  passCount++;
+  longestPassCpuUs = std::max(longestPassCpuUs, cpuMicros() - passStartCpuUs);
+}
+
+/**
+ * @brief Holds up `loop()` for any `--stall` that is due, letting time pass as a blocking
+ *        call would.
+ */
+void stall() {
+  for (Stall& next : stalls) {
+    if (next.us > 0 && nowMicros() >= next.at) {
+      traceLeds();
+      advance(next.us);
+      stallCount++;
+      next.at = next.every > 0 ? next.at + next.every : UINT64_MAX;
+    }
+  }
+}
+
+/**
+ * @brief Prints the run's length, passes, longest pass and GPIO activity to standard error.
+ */
+void report() {
+  traceLeds();
+  if (traceFile != nullptr) {
+    fclose(traceFile);
+    traceFile = nullptr;
+  }
+  fflush(stdout);
+  fprintf(stderr, "native: %s clock, ms %llu, loop passes %llu, stalls %u, GPIO writes %u, PWM writes %u\n",
+          options.virtualClock ? "virtual" : "real", (unsigned long long)(nowMicros() / 1000),
+          (unsigned long long)passCount, stallCount, gpioWriteCount, pwmWriteCount);
+  fprintf(stderr, "native: longest loop pass, us of host CPU %llu\n", (unsigned long long)longestPassCpuUs);
+}
+
+/**
+ * @brief Writes a line to the `--trace` file if the LEDs have changed since the last one.
+ *
+ * Called whenever time is about to pass, so a line holds the LEDs' state from its time
+ * until the next line's. Levels run from 0 to `NATIVE_TRACE_RANGE` whether a pin is
+ * switched or dimmed with PWM.
+ */
+void traceLeds() {
+  if (traceFile == nullptr) {
+    return;
+  }
+  uint16_t levels[3];
+  for (uint8_t led = 0; led < 3; led++) {
+    levels[led] = traceLevel(tracePins[led]);
+  }
+  if (memcmp(levels, tracedLevels, sizeof(levels)) != 0) {
+    fprintf(traceFile, "%llu %u %u %u\n", (unsigned long long)nowMicros(), levels[0], levels[1], levels[2]);
+    memcpy(tracedLevels, levels, sizeof(levels));
+  }
+}
+
+/**
+ * @brief Returns `true` unless the run is on the host clock.
+ */
+bool virtualClock() {
+  return options.virtualClock;
+}
+
+/**
+ * @brief Microseconds since the run began, virtual or real.
+ */
+uint64_t nowMicros() {
+  if (options.virtualClock) {
+    return virtualUs;
+  }
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - realStart).count();
+}
+
+/**
+ * @brief The firmware's clock in microseconds: `nowMicros()` moved on by `--clock-offset`
+ *        and run fast or slow by `--clock-drift`. Only `millis()` and `micros()` read it;
+ *        run length, `--serial` and `--stall` times stay on `nowMicros()`.
+ */
+uint64_t clockMicros() {
+  uint64_t now = nowMicros();
+  return options.clockOffsetUs + now + (int64_t)(now * options.clockDriftPpm / 1e6);
+}
+
+/**
+ * @brief Lets `us` microseconds pass: moves the virtual clock, or sleeps on the real one.
+ */
+void advance(uint64_t us) {
+  traceLeds();
+  if (options.virtualClock) {
+    virtualUs += us;
+  } else if (us > 0) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+  }
+}
+
+/**
+ * @brief Registers something to run whenever the firmware gives the system time: between
+ *        `loop()` passes and in `delay()`. This is when the ESP runs its network callbacks,
+ *        so servers such as the shim's AsyncWebServer poll their sockets here.
+ */
+void addService(std::function<void()> service) {
+  services.push_back(service);
+}
+
+/**
+ * @brief Runs every service once.
+ */
+void runServices() {
+  for (auto& service : services) {
+    service();
+  }
+}
+
+/**
+ * @brief Lets `us` microseconds pass as `delay()` does, running the services first. On the
+ *        real clock they also run at least every `NATIVE_SERVICE_US`, as the ESP serves the
+ *        network while the sketch sleeps.
+ */
+void wait(uint64_t us) {
+  wait(us, [] { return true; });
+}
+
+/**
+ * @brief Lets `us` pass as `wait(us)` does, ending early once `blocked()` returns `false`.
+ */
+void wait(uint64_t us, const std::function<bool()>& blocked) {
+  runServices();
+  if (!blocked()) {
+    return;
+  }
+  if (options.virtualClock || services.empty()) {
+    advance(us);
+    return;
+  }
+  uint64_t end = nowMicros() + us;
+  for (uint64_t now = nowMicros(); now < end && blocked(); now = nowMicros()) {
+    advance(std::min<uint64_t>(end - now, NATIVE_SERVICE_US));
+    runServices();
+  }
+}
+
+const char* serverAddress() {
+  return server;
+}
+
+uint16_t listenPort() {
+  return options.listen;
+}
+
+const char* localAddress() {
+  return options.ip.c_str();
+}
+
+const char* fsRoot() {
+  return options.fs.c_str();
+}
+
+bool offline() {
+  return options.offline;
+}
+
+bool quiet() {
+  return options.quiet;
+}
+
+/**
+ * @brief Number of characters typed with `--serial` that are due and not yet read.
+ */
+int serialAvailable() {
+  typeSerialLines();
+  return serialInput.size();
+}
+
+int serialRead() {
+  if (serialAvailable() == 0) {
+    return -1;
+  }
+  char c = serialInput.front();
+  serialInput.pop_front();
+  return (uint8_t)c;
+}
+
+int serialPeek() {
+  return serialAvailable() > 0 ? (uint8_t)serialInput.front() : -1;
+}
+
+/**
+ * @brief The level last written to a pin with `digitalWrite()` or `GPO`.
+ */
+int pinLevel(uint8_t pin) {
+  if (pin < 16) {
+    return (GPO >> pin) & 1;
+  }
+  return pin < 17 ? pinLevels[pin] : LOW;
+}
+
+/**
+ * @brief The duty last written to a pin with `analogWrite()`.
+ */
+int pinDuty(uint8_t pin) {
+  return pin < 17 ? pinDuties[pin] : 0;
+}
+
+/**
+ * @brief Number of `digitalWrite()` calls. Writes straight to `GPO` are not seen.
+ */
+uint32_t gpioWrites() {
+  return gpioWriteCount;
+}
+
+/**
+ * @brief Number of `analogWrite()` calls.
+ */
+uint32_t pwmWrites() {
+  return pwmWriteCount;
+}
+
+/**
+ * @brief Runs the interrupt handler attached to a pin, as a button press would.
+ */
+void fireInterrupt(uint8_t pin) {
+  if (pin < 17 && interruptHandlers[pin] != nullptr) {
+    interruptHandlers[pin]();
+  }
+}
+
+} // namespace NativeHal
+
+volatile uint32_t GPO = 0;
+
+unsigned long millis() {
+  return (unsigned long)(NativeHal::clockMicros() / 1000);
+}
+
+unsigned long micros() {
+  return (uint32_t)NativeHal::clockMicros(); // wraps after 71 minutes, as on the ESP
+}
+
+void delay(unsigned long ms) {
+  NativeHal::wait((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  NativeHal::advance(us);
+}
+
+void yield() {
+  if (NativeHal::virtualClock()) {
+    NativeHal::advance(NATIVE_YIELD_US);
+  } else {
+    std::this_thread::yield();
+  }
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  (void)pin;
+  (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  gpioWriteCount++;
+  if (pin < 17) {
+    pinPwm[pin] = false;
+  }
+  if (pin < 16) {
+    GPO = value ? (GPO | (1UL << pin)) : (GPO & ~(1UL << pin));
+  } else if (pin < 17) {
+    pinLevels[pin] = value ? HIGH : LOW;
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return NativeHal::pinLevel(pin);
+}
+
+void analogWrite(uint8_t pin, int value) {
+  pwmWriteCount++;
+  if (pin < 17) {
+    pinDuties[pin] = value;
+    pinPwm[pin] = true;
+  }
+}
+
+void analogWriteRange(uint32_t range) {
+  pwmRange = range > 0 ? range : 1;
+}
+
+void analogWriteFreq(uint32_t frequency) {
+  (void)frequency;
+}
+
+int digitalPinToInterrupt(uint8_t pin) {
+  return pin;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode) {
+  (void)mode;
+  if (interrupt < 17) {
+    interruptHandlers[interrupt] = handler;
+  }
+}
+
+void detachInterrupt(uint8_t interrupt) {
+  if (interrupt < 17) {
+    interruptHandlers[interrupt] = nullptr;
+  }
+}
+
+void noInterrupts() {
+}
+
+void interrupts() {
+}
+
+static std::function<void()> timeSetCallback;
+
+void esp_delay(unsigned long timeout_ms, const std::function<bool()>& blocked) {
+  NativeHal::wait((uint64_t)timeout_ms * 1000, blocked);
+}
+
+void settimeofday_cb(const std::function<void()>& callback) {
+  timeSetCallback = callback;
+}
+
+void configTime(int timezone, int daylightOffset_sec, const char* server1, const char* server2, const char* server3) {
+  (void)timezone;
+  (void)daylightOffset_sec;
+  (void)server1;
+  (void)server2;
+  (void)server3;
+  if (timeSetCallback) {
+    timeSetCallback();
+  }
+}
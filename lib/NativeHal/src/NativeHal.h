@@ -0,0 +1,98 @@
+#ifndef NATIVEHAL_H
+#define NATIVEHAL_H
+
+#include <Arduino.h>
+#include <functional>
+
+#define NATIVE_DEFAULT_SECONDS 60       // how long a run lasts, in seconds on the clock in use
+#define NATIVE_DEFAULT_SERVER "127.0.0.1:8080" // tools/stub_api_server.py
+#define NATIVE_SERVER_SIZE 64                 // bytes for --server host:port
+#define NATIVE_DEFAULT_FS ".pio/native_fs" // host directory that stands in for LittleFS
+#define NATIVE_YIELD_US 1               // virtual time a yield() takes, so waits on the clock end
+#define NATIVE_NET_WAIT 2000            // ms of real time a read waits for data under the virtual clock
+#define NATIVE_TRACE_RANGE 1023        // full scale of the LED levels in a --trace file
+#define NATIVE_HEAP_SIZE 51200          // bytes ESP.getFreeHeap() starts at, about what an ESP8266 has free
+#define NATIVE_DEFAULT_LISTEN 8180      // host port for the firmware's web server, which is on 80 on the ESP
+#define NATIVE_SERVICE_US 1000          // longest real-clock wait between network services, in us
+#define NATIVE_DEFAULT_IP "127.0.0.1"   // the firmware's address, WiFi.localIP()
+
+/**
+ * @brief The simulated hardware behind the native env.
+ *
+ * The firmware runs unchanged on a computer: `main()` (NativeMain.cpp) calls `setup()` and
+ * then `loop()` until the run is over. By default time is virtual. `millis()` and
+ * `micros()` only move when the firmware waits, in `delay()` or `yield()`. The network
+ * answers at once, because reads wait in real time for data that is on its way. The same
+ * build and inputs therefore give the same timings and counts on every run. `--real` runs
+ * on the host's clock instead.
+ *
+ * GPIO writes are kept and counted; LittleFS is a directory on the host; HTTP and UDP are
+ * real sockets, pointed at `tools/stub_api_server.py` by default, and the firmware's own
+ * web server (ESPAsyncWebServer) listens on a host port. `ESP.getFreeHeap()`
+ * counts down from `NATIVE_HEAP_SIZE` as the firmware allocates (not under
+ * AddressSanitizer), and `ESP.getCycleCount()`
+ * counts host time, so the code's own speed can be measured on either clock.
+ *
+ * Options, also read from the environment as `MAGICPOI_<NAME>`:
+ *  - `--real`              run on the host clock
+ *  - `--seconds N`         run for N seconds (default 60)
+ *  - `--passes N`          stop after N `loop()` passes
+ *  - `--server HOST:PORT`  API server (default 127.0.0.1:8080)
+ *  - `--fs DIR`            LittleFS directory (default .pio/native_fs)
+ *  - `--listen PORT`       host port for the firmware's web server (default 8180)
+ *  - `--ip ADDRESS`        the firmware's own loopback address (default 127.0.0.1); give
+ *                          each of several runs on one computer its own, e.g. 127.0.0.2,
+ *                          so UDP sent to one reaches it rather than another
+ *  - `--clock-offset MS`   start `millis()` and `micros()` at MS ms, as on a poi that
+ *                          booted MS ms before the run
+ *  - `--clock-drift PPM`   run `millis()` and `micros()` PPM parts per million fast (or slow,
+ *                          if negative), as a crystal off frequency does
+ *  - `--offline`           report Wi-Fi as never connecting
+ *  - `--quiet`             drop Serial output
+ *  - `--serial [MS:]TEXT`  type a line into Serial, at MS ms into the run (default 0);
+ *                          may be given more than once
+ *  - `--trace FILE`        write every change of the LED pins to FILE, see `traceLeds()`
+ *  - `--stall AT:MS[:EVERY]` hold up `loop()` for MS ms at AT ms into the run, as a slow
+ *                          network call would, and again every EVERY ms if given; may be
+ *                          given more than once
+ */
+namespace NativeHal {
+
+void begin(int argc, char** argv);
+bool running();
+void startPass();
+void countPass();
+void stall();
+void report();
+void traceLeds();
+void addService(std::function<void()> service);
+void runServices();
+void wait(uint64_t us);
+void wait(uint64_t us, const std::function<bool()>& blocked);
+
+bool virtualClock();
+uint64_t nowMicros();
+uint64_t clockMicros();
+void advance(uint64_t us);
+
+const char* serverAddress();
+const char* fsRoot();
+uint16_t listenPort();
+const char* localAddress();
+bool offline();
+bool quiet();
+
+int serialAvailable();
+int serialRead();
+int serialPeek();
+
+int pinLevel(uint8_t pin);
+int pinDuty(uint8_t pin);
+uint32_t gpioWrites();
+uint32_t pwmWrites();
+size_t heapUsed();
+void fireInterrupt(uint8_t pin);
+
+} // namespace NativeHal
+
+#endif
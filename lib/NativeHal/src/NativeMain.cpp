@@ -0,0 +1,21 @@
+#include "NativeHal.h"
+
+void setup();
+void loop();
+
+/**
+ * @brief Runs the sketch as the ESP8266 core does, until the run's time or pass limit.
+ */
+int main(int argc, char** argv) {
+  NativeHal::begin(argc, argv);
+  setup();
+  while (NativeHal::running()) {
+    NativeHal::startPass();
+    NativeHal::stall();
+    loop();
+    NativeHal::runServices(); // the ESP runs its network callbacks after each pass
+    NativeHal::countPass();
+  }
+  NativeHal::report();
+  return 0;
+}
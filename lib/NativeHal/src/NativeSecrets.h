@@ -0,0 +1,15 @@
+#ifndef NATIVEHAL_NATIVESECRETS_H
+#define NATIVEHAL_NATIVESECRETS_H
+
+// secrets.h for the native env: the API server comes from --server, and the credentials
+// are the ones tools/stub_api_server.py accepts.
+
+#include "NativeHal.h"
+
+#define WIFI_SSID "native"
+#define WIFI_PASS ""
+#define SERVER_IP NativeHal::serverAddress(); // secrets.h's SERVER_IP carries the semicolon
+#define USER "native@magicpoi.local"
+#define PASS "native"
+
+#endif
@@ -0,0 +1,144 @@
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "NativeHal.h"
+
+WiFiClass WiFi;
+
+int WiFiClass::status() {
+  if (NativeHal::offline() || asleep || radioMode == WIFI_OFF) {
+    return WL_DISCONNECTED;
+  }
+  return WL_CONNECTED;
+}
+
+bool IPAddress::fromString(const char* text) {
+  struct in_addr parsed;
+  if (inet_pton(AF_INET, text, &parsed) != 1) {
+    return false;
+  }
+  address = parsed.s_addr;
+  return true;
+}
+
+String IPAddress::toString() const {
+  char text[INET_ADDRSTRLEN];
+  struct in_addr value = {address};
+  return String(inet_ntop(AF_INET, &value, text, sizeof(text)));
+}
+
+IPAddress WiFiClass::localIP() {
+  IPAddress address;
+  address.fromString(NativeHal::localAddress());
+  return address;
+}
+
+namespace {
+
+int openUdpSocket(uint32_t address, uint16_t port) {
+  int udp = socket(AF_INET, SOCK_DGRAM, 0);
+  int on = 1;
+  setsockopt(udp, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  setsockopt(udp, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+  setsockopt(udp, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+  struct sockaddr_in local = {};
+  local.sin_family = AF_INET;
+  local.sin_port = htons(port);
+  local.sin_addr.s_addr = address;
+  if (bind(udp, (struct sockaddr*)&local, sizeof(local)) != 0) {
+    close(udp);
+    return -1;
+  }
+  return udp;
+}
+
+} // namespace
+
+uint8_t WiFiUDP::begin(uint16_t port) {
+  stop();
+  socket = openUdpSocket((uint32_t)WiFi.localIP(), port);
+  broadcasts = openUdpSocket(htonl(INADDR_ANY), port);
+  if (socket < 0 || broadcasts < 0) {
+    stop();
+    return 0;
+  }
+  return 1;
+}
+
+void WiFiUDP::stop() {
+  if (socket >= 0) {
+    close(socket);
+  }
+  if (broadcasts >= 0) {
+    close(broadcasts);
+  }
+  socket = broadcasts = -1;
+  received = position = 0;
+}
+
+/**
+ * @brief Takes the next datagram, if one has arrived.
+ *
+ * @return Its size, or 0 if none is waiting.
+ */
+int WiFiUDP::parsePacket() {
+  received = position = 0;
+  if (socket < 0 || WiFi.status() != WL_CONNECTED) {
+    return 0;
+  }
+  struct sockaddr_in from = {};
+  socklen_t fromSize = sizeof(from);
+  ssize_t count = recvfrom(socket, incoming, sizeof(incoming), MSG_DONTWAIT, (struct sockaddr*)&from, &fromSize);
+  if (count <= 0) {
+    fromSize = sizeof(from);
+    count = recvfrom(broadcasts, incoming, sizeof(incoming), MSG_DONTWAIT, (struct sockaddr*)&from, &fromSize);
+  }
+  if (count <= 0) {
+    return 0;
+  }
+  received = count;
+  remoteAddress = IPAddress((uint32_t)from.sin_addr.s_addr);
+  remotePortNumber = ntohs(from.sin_port);
+  return received;
+}
+
+int WiFiUDP::read() {
+  return position < received ? incoming[position++] : -1;
+}
+
+int WiFiUDP::read(uint8_t* buffer, size_t size) {
+  int count = std::min<int>(size, received - position);
+  memcpy(buffer, incoming + position, count);
+  position += count;
+  return count;
+}
+
+int WiFiUDP::beginPacket(IPAddress address, uint16_t port) {
+  destination = address;
+  destinationPort = port;
+  outgoingSize = 0;
+  return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t* buffer, size_t size) {
+  size = std::min(size, sizeof(outgoing) - outgoingSize);
+  memcpy(outgoing + outgoingSize, buffer, size);
+  outgoingSize += size;
+  return size;
+}
+
+int WiFiUDP::endPacket() {
+  if (socket < 0 || WiFi.status() != WL_CONNECTED) {
+    return 0;
+  }
+  struct sockaddr_in to = {};
+  to.sin_family = AF_INET;
+  to.sin_port = htons(destinationPort);
+  to.sin_addr.s_addr = (uint32_t)destination;
+  return sendto(socket, outgoing, outgoingSize, 0, (struct sockaddr*)&to, sizeof(to)) == (ssize_t)outgoingSize;
+}
@@ -0,0 +1,173 @@
+#include <WiFiClient.h>
+#include <errno.h>
+#include <algorithm>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "NativeHal.h"
+
+WiFiClient::WiFiClient() : connection(std::make_shared<Connection>()) {
+}
+
+WiFiClient::Connection::~Connection() {
+  if (socket >= 0) {
+    close(socket);
+  }
+}
+
+/**
+ * @brief A copy that shares this client's connection, as core 3.x's `clone()`.
+ */
+std::unique_ptr<WiFiClient> WiFiClient::clone() const {
+  return std::unique_ptr<WiFiClient>(new WiFiClient(*this));
+}
+
+/**
+ * @brief Opens a connection, closing any that is open.
+ *
+ * The new connection is this client's own: copies made earlier keep the closed one, as on
+ * the ESP, where `connect()` gives the client a new ClientContext.
+ *
+ * @return 1 if connected, 0 if not.
+ */
+int WiFiClient::connect(const char* host, uint16_t port) {
+  stop();
+  connection = std::make_shared<Connection>();
+  if (NativeHal::offline()) {
+    return 0;
+  }
+  struct addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* found = nullptr;
+  if (getaddrinfo(host, String(port).c_str(), &hints, &found) != 0) {
+    return 0;
+  }
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd >= 0 && ::connect(fd, found->ai_addr, found->ai_addrlen) != 0) {
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(found);
+  if (fd < 0) {
+    return 0;
+  }
+  connection->socket = fd;
+  setNoDelay(true);
+  return 1;
+}
+
+int WiFiClient::connect(IPAddress address, uint16_t port) {
+  return connect(address.toString().c_str(), port);
+}
+
+/**
+ * @brief Returns 1 while there is unread data or the server has not closed the connection.
+ */
+uint8_t WiFiClient::connected() {
+  if (connection->socket < 0) {
+    return 0;
+  }
+  if (connection->start < connection->end) {
+    return 1;
+  }
+  fill(0);
+  return connection->start < connection->end || !connection->closed;
+}
+
+void WiFiClient::stop() {
+  if (connection->socket >= 0) {
+    close(connection->socket);
+  }
+  connection->socket = -1;
+  connection->start = connection->end = 0;
+  connection->closed = false;
+}
+
+void WiFiClient::setNoDelay(bool noDelay) {
+  int value = noDelay;
+  if (connection->socket >= 0) {
+    setsockopt(connection->socket, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+  }
+}
+
+size_t WiFiClient::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size) {
+  size_t sent = 0;
+  while (connection->socket >= 0 && sent < size) {
+    ssize_t count = send(connection->socket, buffer + sent, size - sent, MSG_NOSIGNAL);
+    if (count <= 0) {
+      break;
+    }
+    sent += count;
+  }
+  return sent;
+}
+
+int WiFiClient::available() {
+  fill(NativeHal::virtualClock() ? NATIVE_NET_WAIT : 0);
+  return connection->end - connection->start;
+}
+
+int WiFiClient::read() {
+  if (available() <= 0) {
+    return -1;
+  }
+  return connection->buffer[connection->start++];
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size) {
+  size_t count = std::min<size_t>(size, available());
+  memcpy(buffer, connection->buffer + connection->start, count);
+  connection->start += count;
+  return count;
+}
+
+int WiFiClient::peek() {
+  return available() > 0 ? connection->buffer[connection->start] : -1;
+}
+
+/**
+ * @brief Waits up to `ms` ms of real time for data, as HTTPClient does for a response.
+ */
+bool WiFiClient::waitAvailable(unsigned long ms) {
+  return fill(ms);
+}
+
+/**
+ * @brief Reads what has arrived into the buffer, if it is empty.
+ *
+ * @param waitMs Real time to wait for data, 0 to only take what is there.
+ *
+ * @return `true` if the buffer holds data.
+ */
+bool WiFiClient::fill(int waitMs) {
+  Connection& c = *connection;
+  if (c.start < c.end) {
+    return true;
+  }
+  c.start = c.end = 0;
+  if (c.socket < 0 || c.closed) {
+    return false;
+  }
+  struct pollfd ready = {c.socket, POLLIN, 0};
+  if (poll(&ready, 1, waitMs) <= 0) {
+    return false;
+  }
+  ssize_t count = recv(c.socket, c.buffer, sizeof(c.buffer), MSG_DONTWAIT);
+  if (count > 0) {
+    c.end = count;
+    return true;
+  }
+  if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+    c.closed = true;
+  }
+  return false;
+}
@@ -0,0 +1,52 @@
+#ifndef NATIVEHAL_WIFICLIENT_H
+#define NATIVEHAL_WIFICLIENT_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <memory>
+
+/**
+ * @brief A TCP connection over the host's sockets.
+ *
+ * Copies share the connection, as on the ESP, until one of them connects again. Under the virtual clock a read that finds
+ * nothing buffered waits in real time (up to `NATIVE_NET_WAIT` ms) for data that is on its
+ * way, so responses arrive in no virtual time at all.
+ */
+class WiFiClient : public Stream {
+public:
+    WiFiClient();
+    std::unique_ptr<WiFiClient> clone() const;
+
+    int connect(const char* host, uint16_t port);
+    int connect(IPAddress address, uint16_t port);
+    uint8_t connected();
+    void stop();
+    void setNoDelay(bool noDelay);
+    operator bool() { return connected(); }
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buffer, size_t size);
+    int peek() override;
+
+    bool waitAvailable(unsigned long ms);
+
+private:
+    struct Connection {
+        int socket = -1;
+        uint8_t buffer[1460]; // one TCP segment, as the ESP's lwIP buffers
+        size_t start = 0;
+        size_t end = 0;
+        bool closed = false;
+        ~Connection();
+    };
+
+    bool fill(int waitMs);
+
+    std::shared_ptr<Connection> connection;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef NATIVEHAL_WIFIUDP_H
+#define NATIVEHAL_WIFIUDP_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+/**
+ * @brief UDP over the host's sockets. The port is shared (SO_REUSEPORT), so several runs
+ *        on one computer can sync with each other over broadcasts.
+ *
+ * Each run opens two sockets on the port: one on every address, which broadcasts reach,
+ * and one on its own `--ip` address, which unicast sent to that address reaches and which
+ * sends, so replies come back to it. Without the second, several runs sharing a port would
+ * each get an arbitrary share of one another's unicast.
+ */
+class WiFiUDP {
+public:
+    ~WiFiUDP() { stop(); }
+
+    uint8_t begin(uint16_t port);
+    void stop();
+
+    int parsePacket();
+    int available() { return received - position; }
+    int read();
+    int read(uint8_t* buffer, size_t size);
+    IPAddress remoteIP() { return remoteAddress; }
+    uint16_t remotePort() { return remotePortNumber; }
+
+    int beginPacket(IPAddress address, uint16_t port);
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size);
+    int endPacket();
+
+private:
+    int socket = -1;          // bound to the run's own address: unicast in, everything out
+    int broadcasts = -1;      // bound to every address: broadcasts in
+    uint8_t incoming[1472]; // the largest datagram that fits one Ethernet frame
+    int received = 0;
+    int position = 0;
+    IPAddress remoteAddress;
+    uint16_t remotePortNumber = 0;
+
+    uint8_t outgoing[1472];
+    size_t outgoingSize = 0;
+    IPAddress destination;
+    uint16_t destinationPort = 0;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef NATIVEHAL_COREDECLS_H
+#define NATIVEHAL_COREDECLS_H
+
+#include <functional>
+
+/**
+ * @brief Sets the function `configTime()` calls once the clock has been set.
+ *
+ * @note The host clock is already set, so on the native env this runs from inside
+ *       `configTime()`. Wall-clock time is the host's, on the virtual clock too.
+ */
+void settimeofday_cb(const std::function<void()>& callback);
+
+/**
+ * @brief Waits up to `timeout_ms`, returning early once `blocked()` is `false`.
+ *
+ * `blocked()` is checked after network callbacks have run, which on the ESP is when
+ * `esp_schedule()` resumes the wait. On the virtual clock the callbacks run once, at the
+ * start, so a wait is only cut short by what they do then.
+ */
+void esp_delay(unsigned long timeout_ms, const std::function<bool()>& blocked);
+
+/**
+ * @brief Resumes an `esp_delay()` so it checks `blocked()` again. Nothing to do here, as
+ *        the native env's callbacks run on the loop's own thread.
+ */
+inline void esp_schedule() {
+}
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef NATIVEHAL_SNTP_H
+#define NATIVEHAL_SNTP_H
+
+/**
+ * @brief Stops the SNTP client `configTime()` started. Nothing to do here, as the native
+ *        env's `configTime()` only reports the host clock as set.
+ */
+inline void sntp_stop() {
+}
+
+#endif
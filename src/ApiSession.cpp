@@ -0,0 +1,288 @@
+#include "ApiSession.h"
+#include "LoopStats.h"
+
+/**
+ * @brief Constructs a session on an existing WiFiClient.
+ *
+ * @param client The WiFiClient the connection is opened with. The HTTPClient keeps its own
+ *               copy of it, which carries the connection. It must outlive the session.
+ * @param serverIP The IP address or hostname of the server.
+ */
+ApiSession::ApiSession(WiFiClient& client, const char* serverIP) : client(client), serverIP(serverIP) {
+  connectedHost[0] = '\0';
+}
+
+/**
+ * @brief Sends a GET request and reads the response headers.
+ *
+ * @param path The path on the server, e.g. `/lite/api/get-current-timeline-number`.
+ * @param token The JWT to send as a bearer token, or `nullptr`.
+ *
+ * @return The HTTP status code, negative if the connection failed. The body is left unread
+ *         in `http()`, with the `Transfer-Encoding` header collected; call `end()` when
+ *         done with it.
+ */
+int ApiSession::get(const char* path, const char* token) {
+  return send("GET", path, nullptr, token);
+}
+
+/**
+ * @brief Sends a POST request with a JSON body and reads the response headers.
+ *
+ * @return The HTTP status code, negative if the connection failed. Call `end()` when done
+ *         with the response.
+ */
+int ApiSession::post(const char* path, const char* json) {
+  return send("POST", path, json, nullptr);
+}
+
+/**
+ * @brief The HTTPClient holding the current response, for `getString()`,
+ *        `getStreamPtr()`, `getSize()` and `header()`.
+ */
+HTTPClient& ApiSession::http() {
+  return httpClient;
+}
+
+/**
+ * @brief Reads the whole response body into `buffer` and terminates it.
+ *
+ * Waits up to `API_HTTP_TIMEOUT` ms for each part of the body, like `getString()`, but
+ * never allocates.
+ *
+ * @return The length of the body, or -1 if it did not fit in `size - 1` bytes or did not
+ *         arrive in full. The buffer holds what was read either way.
+ */
+int ApiSession::readBody(char* buffer, size_t size) {
+  if (size == 0) {
+    return -1;
+  }
+  size_t length = readBytes(buffer, size - 1);
+  buffer[length] = '\0';
+  return body.finished() ? (int)length : -1;
+}
+
+/**
+ * @brief Reads one byte of the response body, waiting up to `API_HTTP_TIMEOUT` ms for it.
+ *
+ * @return The byte, or -1 at the end of the body or on a timeout.
+ */
+int ApiSession::read() {
+  char c;
+  return readBytes(&c, 1) == 1 ? (uint8_t)c : -1;
+}
+
+/**
+ * @brief Reads up to `length` bytes of the response body, waiting up to
+ *        `API_HTTP_TIMEOUT` ms for each part of it.
+ *
+ * @return The number of bytes read, less than `length` at the end of the body or on a
+ *         timeout.
+ */
+size_t ApiSession::readBytes(char* buffer, size_t length) {
+  size_t copied = 0;
+  unsigned long lastData = millis();
+  while (copied < length && !body.finished() && !body.failed()) {
+    int got = body.read((uint8_t*)buffer + copied, length - copied);
+    if (got > 0) {
+      copied += got;
+      lastData = millis();
+    } else if (millis() - lastData >= API_HTTP_TIMEOUT) {
+      break;
+    } else {
+      delay(1);
+    }
+  }
+  return copied;
+}
+
+/**
+ * @brief Finishes with the current response, keeping the connection open for the next
+ *        request if the server allows it.
+ *
+ * @note Call `close()` instead if the body was not read to the end.
+ */
+void ApiSession::end() {
+  httpClient.end();
+}
+
+/**
+ * @brief Finishes with the current response and closes the connection.
+ *
+ * @note The connection belongs to the HTTPClient, which on core 3.x holds its own copy of
+ *       the WiFiClient, so it is closed there rather than through `client`.
+ */
+void ApiSession::close() {
+  httpClient.setReuse(false);
+  httpClient.end();
+  connectedHost[0] = '\0';
+}
+
+/**
+ * @brief The server's current time, worked out from the last response's `Date` header.
+ *
+ * @param epoch Set to the current Unix time in seconds, to within about a second.
+ *
+ * @return `false` if no response with a valid `Date` header has been received yet.
+ */
+bool ApiSession::serverTime(uint32_t& epoch) {
+  if (dateEpoch == 0) {
+    return false;
+  }
+  epoch = dateEpoch + (millis() - dateMillis) / 1000;
+  return true;
+}
+
+/**
+ * @brief Number of requests sent.
+ */
+uint32_t ApiSession::requests() {
+  return requestCount;
+}
+
+/**
+ * @brief Number of TCP connections opened.
+ */
+uint32_t ApiSession::connects() {
+  return connectCount;
+}
+
+/**
+ * @brief Number of requests that had to be resent on a new connection.
+ */
+uint32_t ApiSession::reconnects() {
+  return reconnectCount;
+}
+
+/**
+ * @brief Latency of the last request in microseconds.
+ */
+uint32_t ApiSession::lastLatency() {
+  return lastLatencyUs;
+}
+
+/**
+ * @brief Average request latency in microseconds.
+ */
+uint32_t ApiSession::averageLatency() {
+  return requestCount > 0 ? totalLatencyUs / requestCount : 0;
+}
+
+/**
+ * @brief Highest request latency in microseconds.
+ */
+uint32_t ApiSession::maxLatency() {
+  return maxLatencyUs;
+}
+
+/**
+ * @brief Sends a request, on the open connection if there is one.
+ *
+ * A request that fails on a reused connection is sent once more on a new connection, as
+ * the server may have closed it while idle.
+ */
+int ApiSession::send(const char* method, const char* path, const char* payload, const char* token) {
+  const char* headerKeys[] = {"Transfer-Encoding", "Date"};
+  TextBuffer urlText(url, sizeof(url));
+  TextBuffer authorizationText(authorization, sizeof(authorization));
+  urlText.format("http://%s%s", serverIP, path);
+  if (token != nullptr) {
+    authorizationText.format("Bearer %s", token);
+  }
+  if (urlText.overflowed() || authorizationText.overflowed()) {
+    Serial.print("[HTTP] Request too long: ");
+    Serial.println(path);
+    return HTTPC_ERROR_TOO_LESS_RAM;
+  }
+  size_t payloadLength = payload != nullptr ? strlen(payload) : 0;
+  int httpCode = 0;
+  for (uint8_t attempt = 0; attempt < 2; attempt++) {
+    // begin() replaces the HTTPClient's copy of the client, and with it the connection, so
+    // it is only called for a new host or once the connection has gone
+    bool reused = httpClient.connected() && strcmp(connectedHost, serverIP) == 0;
+    unsigned long started = micros();
+    if (reused) {
+      httpClient.setURL(path);
+    } else {
+      connectCount++;
+      httpClient.begin(client, url);
+      snprintf(connectedHost, sizeof(connectedHost), "%s", serverIP);
+    }
+    httpClient.setReuse(true);
+    httpClient.setTimeout(API_HTTP_TIMEOUT);
+    if (token != nullptr) {
+      httpClient.addHeader("Authorization", authorization);
+    }
+    if (payloadLength > 0) {
+      httpClient.addHeader("Content-Type", "application/json");
+    }
+    httpClient.collectHeaders(headerKeys, 2);
+    httpCode = httpClient.sendRequest(method, (const uint8_t*)payload, payloadLength);
+    uint32_t latency = micros() - started;
+
+    requestCount++;
+    lastLatencyUs = latency;
+    totalLatencyUs += latency;
+    if (latency > maxLatencyUs) {
+      maxLatencyUs = latency;
+    }
+    loopStats.http.add(latency);
+    Serial.print("[HTTP] ");
+    Serial.print(method);
+    Serial.print(" ");
+    Serial.print(path);
+    Serial.print(": ");
+    Serial.print(httpCode);
+    Serial.print(" in us: ");
+    Serial.print(latency);
+    Serial.println(reused ? " (reused connection)" : " (new connection)");
+
+    if (httpCode > 0) {
+      body.begin(httpClient.getStreamPtr(), httpClient.getSize(),
+                 httpClient.header("Transfer-Encoding").equalsIgnoreCase("chunked"));
+      uint32_t epoch;
+      if (parseHttpDate(httpClient.header("Date").c_str(), epoch)) {
+        dateEpoch = epoch;
+        dateMillis = millis();
+      }
+      break;
+    }
+    if (!reused) {
+      break;
+    }
+    Serial.println("[HTTP] Connection lost, reconnecting.");
+    close();
+    reconnectCount++;
+  }
+  return httpCode;
+}
+
+/**
+ * @brief Converts an HTTP date such as "Sun, 06 Nov 1994 08:49:37 GMT" to Unix time.
+ *
+ * @return `false` if the date is not in that form.
+ */
+bool ApiSession::parseHttpDate(const char* date, uint32_t& epoch) {
+  static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  char month[4];
+  int day, year, hour, minute, second;
+  if (sscanf(date, "%*3s, %d %3s %d %d:%d:%d", &day, month, &year, &hour, &minute, &second) != 6) {
+    return false;
+  }
+  const char* found = strstr(months, month);
+  if (found == nullptr || year < 1970 || (found - months) % 3 != 0) {
+    return false;
+  }
+  int m = (found - months) / 3 + 1;
+
+  // days since 1970-01-01 of a proleptic Gregorian date
+  int y = m <= 2 ? year - 1 : year;
+  int era = y / 400;
+  int yearOfEra = y - era * 400;
+  int dayOfYear = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  long days = (long)era * 146097 + dayOfEra - 719468;
+
+  epoch = days * 86400UL + hour * 3600UL + minute * 60UL + second;
+  return true;
+}
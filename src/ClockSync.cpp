@@ -0,0 +1,394 @@
+#include "ClockSync.h"
+
+/**
+ * @brief Opens the UDP port and takes the leader or follower role.
+ *
+ * @param leader `true` on the one device whose clock the others follow.
+ *
+ * @return `true` if the port is open. Calling it again once started does nothing.
+ *
+ * @note Needs Wi-Fi to be connected. If the port cannot be opened, calls within
+ * `CLOCK_BEACON_INTERVAL` of the failed attempt return `false` without trying again, and
+ * the failure is only printed the first time.
+ */
+bool ClockSync::begin(bool leader) {
+  if (isStarted) {
+    return true;
+  }
+  if (bindFailed && millis() - lastBindAttempt < CLOCK_BEACON_INTERVAL) {
+    return false;
+  }
+  lastBindAttempt = millis();
+  if (!udp.begin(CLOCK_SYNC_PORT)) {
+    if (!bindFailed) {
+      Serial.println("Clock sync: UDP port could not be opened, retrying.");
+    }
+    bindFailed = true;
+    return false;
+  }
+  bindFailed = false;
+  isStarted = true;
+  isLeader = leader;
+  if (leader && lockCount == 0) {
+    lockCount = 1; // the leader's clock is the shared clock
+  }
+  lastSent = millis() - CLOCK_BEACON_INTERVAL;
+  Serial.println(leader ? "Clock sync: leading." : "Clock sync: following.");
+  return true;
+}
+
+/**
+ * @brief Closes the UDP port, e.g. while the Wi-Fi modem is off. `begin()` opens it again.
+ *
+ * @note The samples are kept, so a follower's shared clock runs free on the last offset
+ *       and drift, and locks straight back on to the same leader.
+ */
+void ClockSync::stop() {
+  if (!isStarted) {
+    return;
+  }
+  udp.stop();
+  isStarted = false;
+  leaderKnown = false;
+  awaitingResponse = false;
+  bindFailed = false;
+  Serial.println("Clock sync: stopped.");
+}
+
+/**
+ * @brief Returns `true` once `begin()` has succeeded.
+ */
+bool ClockSync::started() {
+  return isStarted;
+}
+
+/**
+ * @brief Handles any waiting packets and sends the next beacon or request when it is due.
+ */
+void ClockSync::update() {
+  localMicros(); // keep the 64-bit clock extended even if nothing else reads it
+  if (!isStarted) {
+    return;
+  }
+
+  for (uint8_t handled = 0; handled < 4; handled++) {
+    int size = udp.parsePacket();
+    if (size <= 0) {
+      break;
+    }
+    uint64_t arrived = localMicros();
+    ClockPacket packet;
+    if (size == sizeof(packet) && udp.read((uint8_t*)&packet, sizeof(packet)) == sizeof(packet)
+        && packet.magic == CLOCK_SYNC_MAGIC && packet.version == CLOCK_SYNC_VERSION) {
+      handlePacket(packet, arrived);
+    }
+  }
+
+  if (isLeader) {
+    if (millis() - lastSent >= CLOCK_BEACON_INTERVAL) {
+      ClockPacket beacon = {CLOCK_SYNC_MAGIC, CLOCK_SYNC_VERSION, Beacon, ++sequence, 0, 0, 0};
+      sendPacket(WiFi.broadcastIP(), CLOCK_SYNC_PORT, beacon);
+    }
+  } else if (leaderKnown) {
+    if (millis() - leaderHeard > CLOCK_LEADER_TIMEOUT) {
+      Serial.println("Clock sync: leader lost, clock running free.");
+      leaderKnown = false;
+    } else if (millis() - lastSent >= CLOCK_REQUEST_INTERVAL) {
+      ClockPacket request = {CLOCK_SYNC_MAGIC, CLOCK_SYNC_VERSION, Request, ++sequence, 0, 0, 0};
+      sendPacket(leaderAddress, leaderPort, request);
+    }
+  }
+}
+
+/**
+ * @brief How long, in ms, `update()` can be left before a packet would wait to be read.
+ *
+ * Packets are timestamped when `update()` reads them, so any time one waits adds to the
+ * measured round trip. A follower is kept polling while its request is out. The leader
+ * cannot know when requests will come, so it sleeps at most `CLOCK_LEADER_MAX_SLEEP` at a
+ * time. A request that waits out part of that sleep is timestamped late, which puts the
+ * follower ahead by half the wait; the least-delay sample keeps the shortest wait of the
+ * last few, but the longer the bound the larger the error and the worse the drift
+ * estimate. Measured on loopback with `tools/clock_sync.py check --leader`, three native
+ * followers, 60 s runs:
+ *
+ *   bound ms   leader passes/s   follower error, mean / worst, ms
+ *      1            910                 0.0 / 1.0
+ *      5            196                 0.4 / 1.5
+ *     10             99                 0.7 / 2.6
+ *     20             50                 1.2 / 3.8
+ *     50             20                 1.1 / 17
+ *
+ * Each pass is the CPU waking from `delay()`, so passes a second stand for the power
+ * cost. 10 ms, the default, keeps within the 5 ms the poi need to look in step at a tenth
+ * of the wake-ups of 1 ms; set it in secrets.h on the leader to trade one for the other.
+ *
+ * @return 0 to poll straight away, or `ULONG_MAX` before `begin()`.
+ */
+unsigned long ClockSync::maxSleep() {
+  if (!isStarted) {
+    return ULONG_MAX;
+  }
+  if (isLeader) {
+    return CLOCK_LEADER_MAX_SLEEP;
+  }
+  unsigned long sinceSent = millis() - lastSent;
+  if (awaitingResponse && sinceSent <= CLOCK_SYNC_MAX_DELAY / 1000) {
+    return 0;
+  }
+  if (!leaderKnown) {
+    return ULONG_MAX; // beacons are only listened for, their timing does not matter
+  }
+  return sinceSent < CLOCK_REQUEST_INTERVAL ? CLOCK_REQUEST_INTERVAL - sinceSent : 0;
+}
+
+/**
+ * @brief Returns `true` on the leader.
+ */
+bool ClockSync::leader() {
+  return isLeader;
+}
+
+/**
+ * @brief Returns `true` once the shared clock can be used: always on the leader, and on a
+ *        follower once it has locked on to a leader.
+ *
+ * @note A follower that loses its leader stays synced, running on the last offset and
+ *       drift, until it locks on to another.
+ */
+bool ClockSync::synced() {
+  return lockCount > 0;
+}
+
+/**
+ * @brief Number of times a follower has locked on to a leader; the shared clock may step
+ *        each time this changes.
+ */
+uint16_t ClockSync::locks() {
+  return lockCount;
+}
+
+/**
+ * @brief This device's clock in microseconds since boot, extended to 64 bits so it does
+ *        not wrap after 71 minutes like `micros()`.
+ *
+ * @note Must be called at least once per 71 minutes; `update()` does so.
+ */
+uint64_t ClockSync::localMicros() {
+  uint32_t now = micros();
+  if (now < lastMicros) {
+    localHigh += 1ULL << 32;
+  }
+  lastMicros = now;
+  return localHigh | now;
+}
+
+/**
+ * @brief The shared clock in microseconds: the leader's clock, as best this device knows it.
+ *
+ * @note Runs on the local clock until a follower has synced.
+ */
+uint64_t ClockSync::sharedMicros() {
+  uint64_t local = localMicros();
+  if (isLeader || lockCount == 0) {
+    return local;
+  }
+  int64_t elapsed = (int64_t)(local - best.local);
+  return local + best.offset + (int64_t)(driftRate * elapsed);
+}
+
+/**
+ * @brief The shared clock in milliseconds, wrapping like `millis()`.
+ */
+unsigned long ClockSync::sharedMillis() {
+  return (unsigned long)(sharedMicros() / 1000);
+}
+
+/**
+ * @brief Leader clock minus this device's clock in microseconds, as last measured.
+ */
+int64_t ClockSync::offset() {
+  return best.offset;
+}
+
+/**
+ * @brief Estimated rate of the leader's clock relative to this one, e.g. 0.00002 when it
+ *        runs 20 ppm fast.
+ */
+float ClockSync::drift() {
+  return driftRate;
+}
+
+/**
+ * @brief Round trip of the exchange the clock currently runs from, in microseconds. Half
+ *        of it bounds the error of the offset.
+ */
+uint32_t ClockSync::roundTrip() {
+  return best.delay;
+}
+
+/**
+ * @brief Number of request and response exchanges completed with the leader.
+ */
+uint32_t ClockSync::exchanges() {
+  return exchangeCount;
+}
+
+/**
+ * @brief Prints the role, the shared clock as it is read, and what a follower runs it from.
+ *
+ * The shared clock comes first, so tools that timestamp the line as it arrives, such as
+ * `tools/clock_sync.py check`, can compare it with the leader's.
+ */
+void ClockSync::report(Print& out) {
+  uint64_t shared = sharedMicros();
+  out.print("Clock sync: shared us ");
+  out.print((unsigned long long)shared);
+  if (!isStarted) {
+    out.println(", not started");
+    return;
+  }
+  if (isLeader) {
+    out.println(", leading");
+    return;
+  }
+  if (leaderKnown) {
+    out.print(", following ");
+    out.print(leaderAddress);
+  } else {
+    out.print(", no leader");
+  }
+  out.print(", locks ");
+  out.print(lockCount);
+  out.print(", exchanges ");
+  out.print(exchangeCount);
+  out.print(", offset us ");
+  out.print((long long)best.offset);
+  out.print(", round trip us ");
+  out.print(best.delay);
+  out.print(", drift ppm ");
+  out.println(driftRate * 1e6, 1);
+}
+
+/**
+ * @brief Answers requests on the leader; follows beacons and takes samples from responses
+ *        on a follower.
+ */
+void ClockSync::handlePacket(const ClockPacket& packet, uint64_t arrived) {
+  if (isLeader) {
+    if (packet.type == Request) {
+      ClockPacket response = packet;
+      response.type = Response;
+      response.receive = arrived;
+      sendPacket(udp.remoteIP(), udp.remotePort(), response);
+    }
+    return;
+  }
+
+  if (packet.type == Beacon) {
+    if (!leaderKnown) {
+      if (!(leaderAddress == udp.remoteIP()) || leaderPort != udp.remotePort()) {
+        sampleCount = 0; // a different clock: measure it afresh
+        nextSample = 0;
+        ringLocked = false;
+      }
+      leaderAddress = udp.remoteIP();
+      leaderPort = udp.remotePort();
+      leaderKnown = true;
+      lastSent = millis() - CLOCK_REQUEST_INTERVAL; // ask straight away
+      Serial.print("Clock sync: following leader ");
+      Serial.println(leaderAddress);
+    }
+    if (udp.remoteIP() == leaderAddress) {
+      leaderHeard = millis();
+    }
+    return;
+  }
+
+  if (packet.type == Response && leaderKnown && packet.sequence == sequence && udp.remoteIP() == leaderAddress) {
+    leaderHeard = millis();
+    awaitingResponse = false;
+    // NTP: t1 request sent, t2 request received, t3 response sent, t4 response received
+    int64_t leaderTime = (int64_t)(packet.receive - packet.originate) + (int64_t)(packet.transmit - arrived);
+    int64_t roundTrip = (int64_t)(arrived - packet.originate) - (int64_t)(packet.transmit - packet.receive);
+    Sample sample;
+    sample.local = packet.originate + (arrived - packet.originate) / 2;
+    sample.offset = leaderTime / 2;
+    sample.delay = roundTrip > 0 ? (uint32_t)roundTrip : 0;
+    addSample(sample);
+  }
+}
+
+/**
+ * @brief Timestamps a packet as late as possible and sends it.
+ */
+void ClockSync::sendPacket(IPAddress address, uint16_t port, ClockPacket& packet) {
+  if (packet.type == Request) {
+    packet.originate = localMicros();
+  } else {
+    packet.transmit = localMicros();
+  }
+  udp.beginPacket(address, port);
+  udp.write((const uint8_t*)&packet, sizeof(packet));
+  udp.endPacket();
+  if (packet.type != Response) {
+    lastSent = millis();
+    awaitingResponse = packet.type == Request;
+  }
+}
+
+/**
+ * @brief Adds a measured offset and moves the clock on to the best recent one.
+ *
+ * The exchange with the least delay of the last `CLOCK_SYNC_SAMPLES` is used, as queueing
+ * on the network only ever adds delay and error. Each time that choice moves on to a newer
+ * exchange the drift is re-estimated from the change in offset since an anchor at least
+ * `CLOCK_DRIFT_MIN_SPAN` earlier.
+ */
+void ClockSync::addSample(const Sample& sample) {
+  samples[nextSample] = sample;
+  nextSample = (nextSample + 1) % CLOCK_SYNC_SAMPLES;
+  if (sampleCount < CLOCK_SYNC_SAMPLES) {
+    sampleCount++;
+  }
+  exchangeCount++;
+  if (sampleCount < CLOCK_SYNC_MIN_SAMPLES) {
+    return;
+  }
+
+  const Sample* candidate = &samples[0];
+  for (uint8_t i = 1; i < sampleCount; i++) {
+    if (samples[i].delay < candidate->delay) {
+      candidate = &samples[i];
+    }
+  }
+
+  if (!ringLocked) {
+    if (candidate->delay > CLOCK_SYNC_MAX_DELAY) {
+      return; // network too slow to trust yet
+    }
+    ringLocked = true;
+    lockCount++;
+    best = *candidate;
+    anchor = best;
+    driftRate = 0;
+    haveDrift = false;
+    Serial.print("Clock sync: locked, offset us: ");
+    Serial.print((long)best.offset);
+    Serial.print(", round trip us: ");
+    Serial.println(best.delay);
+    return;
+  }
+
+  if (candidate->local == best.local) {
+    return;
+  }
+  int64_t span = (int64_t)(candidate->local - anchor.local);
+  if (span >= CLOCK_DRIFT_MIN_SPAN) {
+    float measured = (float)(candidate->offset - anchor.offset) / (float)span;
+    driftRate = haveDrift ? driftRate + (measured - driftRate) / 4 : measured;
+    haveDrift = true;
+    anchor = *candidate;
+  }
+  best = *candidate;
+}
@@ -4,34 +4,21 @@
  * @brief Constructs an instance of the ColourPatterns class.
  *
  * This constructor initializes an instance of the ColourPatterns class with the specified
- * pins for the red, green, and blue LEDs. It also sets initial values for various class
- * variables used in LED patterns.
+ * pins for the red, green, and blue LEDs.
  *
  * @param redPin The pin number connected to the red LED.
  * @param greenPin The pin number connected to the green LED.
  * @param bluePin The pin number connected to the blue LED.
  *
- * @note The constructor initializes the pins as OUTPUT and sets initial values for class
- *       variables such as `previousMillis`, `rainbowWay`, `threeWay`, `ledState`,
- *       `upDownFade`, `fadeSpeed`, and `interval`.
- * @note You can customize these variables to control the behavior of LED patterns.
+ * @note The constructor initializes the pins as OUTPUT and sets the PWM range to
+ *       `LED_PWM_RANGE`. Every pattern starts on its first frame.
  */
 ColourPatterns::ColourPatterns(int redPin, int greenPin, int bluePin) : 
-redLed(redPin), greenLed(greenPin), blueLed(bluePin), 
-previousMillis(0),
-rainbowWay(0),
-threeWay(0),
-ledState(LOW),
-upDownFade(false),
-fadeSpeed(500),
-interval(100)
-//todo: any other variables I missed? Are global variables better/ok instead? 
-
+output(redPin, greenPin, bluePin)
 {
     // Constructor
-    pinMode(redLed, OUTPUT);
-    pinMode(greenLed, OUTPUT);
-    pinMode(blueLed, OUTPUT);
+    output.begin();
+    analogWriteRange(LED_PWM_RANGE);
 }
 
 /**
@@ -48,505 +35,192 @@ interval(100)
  * @note You can customize the timing and colours of the loading animation as needed.
  */
 void ColourPatterns::runLoading(){
-  analogWrite(redLed, 255);
-  analogWrite(greenLed, 0);
-  analogWrite(blueLed, 0);
+  output.write(COLOUR_RED);
   delay(500);
-  analogWrite(redLed, 0);
-  analogWrite(greenLed, 255);
-  analogWrite(blueLed, 0);
+  output.write(COLOUR_GREEN);
   delay(500);
-  analogWrite(redLed, 0);
-  analogWrite(greenLed, 0);
-  analogWrite(blueLed, 255);
+  output.write(COLOUR_BLUE);
   delay(500);
 }
 
-/**
- * @brief Changes the colour pattern of RGB LEDs based on the provided choice.
- *
- * This function allows you to change the colour pattern of RGB LEDs based on a numeric
- * choice. It uses a switch statement to select a specific colour pattern corresponding to
- * the choice and calls the respective colour-setting function.
- *
- * @param choice An integer representing the chosen colour pattern (0-13).
- *
- * @note The available colour patterns are specified by the case values.
- * @note Default behavior is to turn off all LEDs.
- * @see Red() - Sets the LEDs to red.
- * @see Green() - Sets the LEDs to green.
- * @see Blue() - Sets the LEDs to blue.
- * @see Yellow() - Sets the LEDs to yellow.
- * @see Cyan() - Sets the LEDs to cyan.
- * @see Magenta() - Sets the LEDs to magenta.
- * @see White() - Sets the LEDs to white.
- */
-void ColourPatterns::changeColours(int choice) {
-    switch (choice) {
-        case 0: Red(); break;
-        case 1: Green(); break;
-        case 2: Blue(); break;
-        case 3: Cyan(); break;
-        case 4: Magenta(); break;
-        case 5: Yellow(); break;
-        case 6: White(); break;
-        case 7: Fade(); break;
-        case 8: StrobePlus(); break;
-        case 9: RGBStrobe(); break;
-        case 10: Rainbow(); break;
-        case 11: Halfstrobe(); break;
-        case 12: GRStrobe(); break;
-        case 13: BGStrobe(); break;
-        default: Off(); break;
-    }
-}
-
-// patterns here: 
-
-/**
- * @brief Sets the RGB LEDs to the colour red.
- * 
- * @note 0a Red
- */
-void ColourPatterns::Red() {
-  digitalWrite(redLed, HIGH);
-  digitalWrite(blueLed, LOW);
-  digitalWrite(greenLed, LOW);
-}
-
-/**
- * @brief Sets the RGB LEDs to the colour green.
- * 
- * @note 1b Green
- */
-void ColourPatterns::Green()
-{
-  digitalWrite(greenLed, HIGH);
-  digitalWrite(blueLed, LOW);
-  digitalWrite(redLed, LOW);
-}
-
-/**
- * @brief Sets the RGB LEDs to the colour blue.
- * 
- * @note 2c Blue
- */
-void ColourPatterns::Blue()
-{
-  digitalWrite(blueLed, HIGH);
-  digitalWrite(redLed, LOW);
-  digitalWrite(greenLed, LOW);
-}
-
-
-/**
- * @brief Sets the RGB LEDs to the colour yellow (red + green).
- * 
- * @note 3d Yellow
- */
-void ColourPatterns::Yellow()
-{
-  digitalWrite(greenLed, HIGH);
-  digitalWrite(redLed, HIGH);
-  digitalWrite(blueLed, LOW);
-}
-
-/**
- * @brief Sets the RGB LEDs to the colour cyan (green + blue).
- * 
- * @note 4e Cyan
- */
-void ColourPatterns::Cyan()
-{
-  digitalWrite(blueLed, HIGH);
-  digitalWrite(greenLed, HIGH);
-  digitalWrite(redLed, LOW);
-}
-
-/**
- * @brief Sets the RGB LEDs to the colour magenta (red + blue).
- * 
- * @note 5f Magenta
- */
-void ColourPatterns::Magenta()
-{
-  digitalWrite(blueLed, HIGH);
-  digitalWrite(redLed, HIGH);
-  digitalWrite(greenLed, LOW);
-}
-
-/**
- * @brief Sets the RGB LEDs to the colour white (red + green + blue).
- * 
- * @note 6g White
- */
-void ColourPatterns::White()
-{
-  digitalWrite(blueLed, HIGH);
-  digitalWrite(greenLed, HIGH);
-  digitalWrite(redLed, HIGH);
-}
-// 7h Fade
-/**
- * @brief Creates a fading colour pattern effect on RGB LEDs.
- *
- * This function generates a fading colour pattern on RGB LEDs by smoothly transitioning
- * between different colours. It adjusts the fade speed and direction, changing the colour
- * every time a certain time interval has passed.
- *
- * @note 7h Fade
- * @note This function uses a software PWM-like approach to achieve the fading effect.
- * @note The fade speed and direction are controlled by the `fadeSpeed` variable and the
- *       `upDownFade` flag.
- * @note The colour transitions include red, yellow, green, cyan, blue, and magenta.
- * @note The function updates the LEDs' colours based on the current time and fade speed.
- * @note The `rainbowWay` variable tracks the current colour transition in the pattern.
- *
- * @see Red() - Sets the LEDs to red.
- * @see Yellow() - Sets the LEDs to yellow.
- * @see Green() - Sets the LEDs to green.
- * @see Cyan() - Sets the LEDs to cyan.
- * @see Blue() - Sets the LEDs to blue.
- * @see Magenta() - Sets the LEDs to magenta.
- */
-void ColourPatterns::Fade()
-{
-  // delayMicroseconds fade software pwm was causing an issue so replaced with another Demo - might change this at some point.
-  unsigned long currentMillis = millis();
-  if (upDownFade)
-  {
-    if (fadeSpeed > 0) 
-    {
-      fadeSpeed--;
-
-    } 
-    else
-    {
-      upDownFade = false;
-    }
-
-  } 
-  else
-  {
-    if (fadeSpeed < 5000)
-    {
-      fadeSpeed ++;
-    }
-    else
-    {
-      upDownFade = true;
-    }
-  }
-  
-  if (currentMillis - previousMillis >= fadeSpeed)
-  {
-    // save the last time you blinked the LED
-    previousMillis = currentMillis;
-    if (rainbowWay == 0)
-    {
-      digitalWrite(redLed, HIGH);
-      digitalWrite(greenLed, LOW);
-      digitalWrite(blueLed, LOW);
-    }
-    else if (rainbowWay == 1)
-    {
-      digitalWrite(redLed, HIGH);
-      digitalWrite(greenLed, HIGH);
-      digitalWrite(blueLed, LOW);
-    }
-    else if (rainbowWay == 2)
-    {
-      digitalWrite(redLed, LOW);
-      digitalWrite(greenLed, HIGH);
-      digitalWrite(blueLed, LOW);
-    }
-    else if (rainbowWay == 3)
-    {
-      digitalWrite(redLed, LOW);
-      digitalWrite(greenLed, HIGH);
-      digitalWrite(blueLed, HIGH);
-    }
-    else if (rainbowWay == 4)
-    {
-      digitalWrite(redLed, LOW);
-      digitalWrite(greenLed, LOW);
-      digitalWrite(blueLed, HIGH);
-    }
-    else if (rainbowWay == 5)
-    {
-      digitalWrite(redLed, HIGH);
-      digitalWrite(greenLed, LOW);
-      digitalWrite(blueLed, HIGH);
-    }
-    rainbowWay++;
-    if (rainbowWay > 5)
-    {
-      rainbowWay = 0;
-    }
+// pattern tables: 
+
+static constexpr uint16_t strobeMs = 100; // frame length of the strobes and the rainbow
+
+static constexpr PatternFrame redFrames[] = {{COLOUR_RED, 0}};           // 0a Red
+static constexpr PatternFrame greenFrames[] = {{COLOUR_GREEN, 0}};       // 1b Green
+static constexpr PatternFrame blueFrames[] = {{COLOUR_BLUE, 0}};         // 2c Blue
+static constexpr PatternFrame cyanFrames[] = {{COLOUR_CYAN, 0}};         // 3d Cyan
+static constexpr PatternFrame magentaFrames[] = {{COLOUR_MAGENTA, 0}};   // 4e Magenta
+static constexpr PatternFrame yellowFrames[] = {{COLOUR_YELLOW, 0}};     // 5f Yellow
+static constexpr PatternFrame whiteFrames[] = {{COLOUR_WHITE, 0}};       // 6g White
+
+// 7h Fade: smoothly around the colour wheel, speeding up and then slowing down
+static constexpr PatternFrame fadeFrames[] = {
+  {COLOUR_RED, 1500}, {COLOUR_YELLOW, 1200}, {COLOUR_GREEN, 900},
+  {COLOUR_CYAN, 600}, {COLOUR_BLUE, 400}, {COLOUR_MAGENTA, 300},
+  {COLOUR_RED, 300}, {COLOUR_YELLOW, 400}, {COLOUR_GREEN, 600},
+  {COLOUR_CYAN, 900}, {COLOUR_BLUE, 1200}, {COLOUR_MAGENTA, 1500}};
+
+// 8i Strobe+: each pair of colours strobed in turn
+static constexpr PatternFrame strobePlusFrames[] = {
+  {COLOUR_RED, 50}, {COLOUR_BLUE, 50}, {COLOUR_RED, 50}, {COLOUR_BLUE, 50},
+  {COLOUR_BLUE, 50}, {COLOUR_GREEN, 50}, {COLOUR_BLUE, 50}, {COLOUR_GREEN, 50},
+  {COLOUR_GREEN, 50}, {COLOUR_RED, 50}, {COLOUR_GREEN, 50}, {COLOUR_RED, 50},
+  {COLOUR_CYAN, 50}, {COLOUR_MAGENTA, 50}, {COLOUR_CYAN, 50}, {COLOUR_MAGENTA, 50},
+  {COLOUR_MAGENTA, 50}, {COLOUR_YELLOW, 50}, {COLOUR_MAGENTA, 50}, {COLOUR_YELLOW, 50},
+  {COLOUR_YELLOW, 50}, {COLOUR_CYAN, 50}, {COLOUR_YELLOW, 50}, {COLOUR_CYAN, 50}};
+
+// 9j RGBStrobe
+static constexpr PatternFrame rgbStrobeFrames[] = {
+  {COLOUR_RED, strobeMs}, {COLOUR_GREEN, strobeMs}, {COLOUR_BLUE, strobeMs}};
+
+// 10k Rainbow
+static constexpr PatternFrame rainbowFrames[] = {
+  {COLOUR_RED, strobeMs}, {COLOUR_GREEN, strobeMs}, {COLOUR_BLUE, strobeMs},
+  {COLOUR_CYAN, strobeMs}, {COLOUR_YELLOW, strobeMs}, {COLOUR_MAGENTA, strobeMs}};
+
+static constexpr PatternFrame halfstrobeFrames[] = {{COLOUR_RED, strobeMs}, {COLOUR_BLUE, strobeMs}};  // 11L Halfstrobe
+static constexpr PatternFrame grStrobeFrames[] = {{COLOUR_GREEN, strobeMs}, {COLOUR_RED, strobeMs}};   // 12m GRStrobe
+static constexpr PatternFrame bgStrobeFrames[] = {{COLOUR_BLUE, strobeMs}, {COLOUR_GREEN, strobeMs}};  // 13n BGStrobe
+static constexpr PatternFrame offFrames[] = {{COLOUR_OFF, 0}};           // 14o Off
+
+template <size_t N>
+static constexpr Pattern pattern(const PatternFrame (&frames)[N], bool fade = false) {
+  return {frames, (uint8_t)N, fade};
+}
+
+// indexed by the timeline signal:
+static constexpr Pattern patterns[] = {
+  pattern(redFrames), pattern(greenFrames), pattern(blueFrames), pattern(cyanFrames),
+  pattern(magentaFrames), pattern(yellowFrames), pattern(whiteFrames), pattern(fadeFrames, true),
+  pattern(strobePlusFrames), pattern(rgbStrobeFrames), pattern(rainbowFrames),
+  pattern(halfstrobeFrames), pattern(grStrobeFrames), pattern(bgStrobeFrames), pattern(offFrames)};
+
+static_assert(sizeof(patterns) / sizeof(patterns[0]) == PATTERN_COUNT, "one table per pattern");
+
+static constexpr double squareRoot(double x) {
+  double root = x > 1 ? x : 1;
+  for (int i = 0; i < 32; i++) {
+    root = (root + x / root) / 2;
   }
-  
-}
-// 8i Strobe+
-void ColourPatterns::StrobePlus()
-{
-  // switch (strobePlusOptions)
-  // {
-  // case 0:
-  //   oneSignal = redHEX;
-  //   twoSignal = blueHEX;
-  //   break;
-  // case 1:
-  //   oneSignal = blueHEX;
-  //   twoSignal = greenHEX;
-  //   break;
-  // case 2:
-  //   oneSignal = greenHEX;
-  //   twoSignal = redHEX;
-  //   break;
-  // case 3:
-  //   oneSignal = cyanHEX;
-  //   twoSignal = magentaHEX;
-  //   break;
-  // case 4:
-  //   oneSignal = magentaHEX;
-  //   twoSignal = yellowHEX;
-  //   break;
-  // case 5:
-  //   oneSignal = yellowHEX;
-  //   twoSignal = cyanHEX;
-  //   break;
-  // default:
-  //   // nothing
-  //   break;
-  // }
-  // strobePlusOptions++;
-  // if (strobePlusOptions > strobePlusOptionsMax)
-  // {
-  //   strobePlusOptions = 0;
-  // }
-  // flashThreeWay = true;
+  return root;
 }
 
 /**
- * @brief Generates a strobe-like colour pattern effect on RGB LEDs.
+ * @brief PWM duty for each of 256 brightness steps, so equal steps look equally bright.
  *
- * This function creates a strobe-like colour pattern effect on RGB LEDs. However, the
- * implementation currently appears to be commented out, and the function's code does
- * not contain any active logic.
- *
- * @note 9j RGBStrobe
- * @note The implementation is currently commented out, and there is no active code
- *       within this function.
- * @note It seems that the function was intended to control colour transitions based on
- *       the `strobePlusOptions` variable, but this functionality is commented out.
- * @note If you intend to use this function, you may need to uncomment and modify the
- *       logic to achieve the desired strobe-like effect.
+ * The eye is far more sensitive to changes when an LED is dim, so a linear ramp of duty
+ * seems to jump out of black and then barely change. Gamma 2.5 (x² √x) is applied by the
+ * compiler; the table lives in flash.
  */
-void ColourPatterns::RGBStrobe()
-{
-  unsigned long currentMillis = millis();
-  if (currentMillis - previousMillis >= interval)
-  {
-    previousMillis = currentMillis;
-    if (threeWay == 0)
-    {
-      Red();
-    }
-    else if (threeWay == 1)
-    {
-      Green();
-    }
-    else if (threeWay == 2)
-    {
-      Blue();
-    }
-    threeWay++;
-    if (threeWay > 2)
-    {
-      threeWay = 0;
+struct GammaTable {
+  uint16_t duty[256];
+  constexpr GammaTable() : duty() {
+    for (int i = 0; i < 256; i++) {
+      double x = i / 255.0;
+      duty[i] = (uint16_t)(x * x * squareRoot(x) * LED_PWM_RANGE + 0.5);
     }
   }
-}
+};
+
+static constexpr GammaTable ledGamma PROGMEM = GammaTable();
+
+static_assert(ledGamma.duty[0] == 0 && ledGamma.duty[255] == LED_PWM_RANGE, "gamma table spans the PWM range");
 
 /**
- * @brief Generates a rainbow colour pattern effect on RGB LEDs.
+ * @brief Shows the colour pattern picked by a timeline signal.
  *
- * This function creates a rainbow colour pattern effect on RGB LEDs by sequentially
- * transitioning between red, green, blue, cyan, yellow, and magenta colours. It updates
- * the colour pattern at regular intervals based on the specified `interval`.
+ * The pattern's current frame is looked up in its table and shown. Frames whose time has
+ * passed are stepped over first, counting from when each was due rather than when this
+ * was called, so a pattern keeps its tempo however often it is called.
  *
- * @param interval The time interval (in milliseconds) between colour transitions.
- *
- * @note 10k Rainbow
- * @note This function is designed to create a continuous rainbow-like colour pattern.
- * @note The colour transitions include red, green, blue, cyan, yellow, and magenta.
- * @note The `interval` parameter controls the time between colour transitions.
- * @note The `rainbowWay` variable tracks the current colour in the rainbow sequence.
+ * @param choice An integer representing the chosen colour pattern (0-13).
  *
- * @see Red() - Sets the LEDs to red.
- * @see Green() - Sets the LEDs to green.
- * @see Blue() - Sets the LEDs to blue.
- * @see Cyan() - Sets the LEDs to cyan.
- * @see Yellow() - Sets the LEDs to yellow.
- * @see Magenta() - Sets the LEDs to magenta.
+ * @note Any other value turns all LEDs off.
+ * @note A pattern starts from its first frame whenever it is picked after another.
+ * @note A fading pattern shows the blend of the current frame's colour into the next's,
+ *       in proportion to the time into the frame.
+ * @see nextChange() - When this next needs calling.
  */
-void ColourPatterns::Rainbow()
-{
-  unsigned long currentMillis = millis();
-  if (currentMillis - previousMillis >= interval)
-  {
-    // Serial.println("interval elapsed");
-    previousMillis = currentMillis;
-    if (rainbowWay == 0)
-    {
-      Red();
-    }
-    else if (rainbowWay == 1)
-    {
-      Green();
-    }
-    else if (rainbowWay == 2)
-    {
-      Blue();
-    }
-    else if (rainbowWay == 3)
-    {
-      Cyan();
-    }
-    else if (rainbowWay == 4)
-    {
-      Yellow();
-    }
-    else if (rainbowWay == 5)
-    {
-      Magenta();
+void ColourPatterns::changeColours(int choice) {
+    uint8_t index = patternIndex(choice);
+    const Pattern& pattern = patterns[index];
+    PatternState& state = states[index];
+    unsigned long now = millis();
+
+    if (index != activePattern) {
+        activePattern = index;
+        state.frame = 0;
+        state.frameStart = now;
+    } else {
+        uint16_t duration;
+        while ((duration = pattern.frames[state.frame].duration) > 0 && now - state.frameStart >= duration) {
+            state.frameStart += duration;
+            state.frame = (state.frame + 1) % pattern.count;
+        }
     }
-    rainbowWay++;
-    if (rainbowWay > 5)
-    {
-      rainbowWay = 0;
+    const PatternFrame& frame = pattern.frames[state.frame];
+    if (pattern.fade && frame.duration > 0) {
+        const PatternFrame& next = pattern.frames[(state.frame + 1) % pattern.count];
+        uint8_t mix = (uint8_t)((now - state.frameStart) * 255 / frame.duration);
+        showBlend(frame.colour, next.colour, mix);
+    } else {
+        output.write(frame.colour);
     }
-  }
 }
 
 /**
- * @brief Generates a half-strobe colour pattern effect on RGB LEDs.
+ * @brief Returns how long, in ms, `choice` can be left before `changeColours()` must run
+ *        again to show its next frame.
  *
- * This function creates a half-strobe colour pattern effect on RGB LEDs by toggling
- * between red and blue colours at regular intervals. It alternates between turning
- * on and off the LEDs to create a flashing effect.
+ * @param choice The colour pattern last passed to `changeColours()`.
  *
- * @note 11L Halfstrobe
- * @note This function generates a two-colour strobe effect between red and blue.
- * @note The `interval` parameter controls the time between colour toggles.
- * @note The `ledState` variable keeps track of the current LED state (ON/OFF).
+ * @return 0 when it should run straight away, or `ULONG_MAX` for a pattern that never
+ *         changes by itself. At most `FADE_STEP_MS` while a pattern fades.
  *
- * @see Red() - Sets the LEDs to red.
- * @see Blue() - Sets the LEDs to blue.
+ * @see LoopScheduler::wakeIn() - Sleeps `loop()` until then.
  */
-void ColourPatterns::Halfstrobe()
-{
-  unsigned long currentMillis = millis();
-  if (currentMillis - previousMillis >= interval)
-  {
-    // save the last time you blinked the LED
-    previousMillis = currentMillis;
-    // if the LED is off turn it on and vice-versa:
-    if (ledState == LOW)
-    {
-      Red();
-      ledState = HIGH;
+unsigned long ColourPatterns::nextChange(int choice) {
+    uint8_t index = patternIndex(choice);
+    if (index != activePattern) {
+        return 0;
     }
-    else
-    {
-      Blue();
-      ledState = LOW;
+    const PatternState& state = states[index];
+    uint16_t duration = patterns[index].frames[state.frame].duration;
+    if (duration == 0) {
+        return ULONG_MAX;
     }
-  }
+    unsigned long elapsed = millis() - state.frameStart;
+    unsigned long wait = elapsed < duration ? duration - elapsed : 0;
+    return patterns[index].fade && wait > FADE_STEP_MS ? FADE_STEP_MS : wait;
 }
 
 /**
- * @brief Generates a blue-green strobe colour pattern effect on RGB LEDs.
- *
- * This function creates a blue-green strobe colour pattern effect on RGB LEDs by toggling
- * between blue and green colours at regular intervals. It alternates between turning
- * on and off the LEDs to create a flashing effect.
- *
- * @note 12m BGStrobe
- * @note This function generates a two-colour strobe effect between blue and green.
- * @note The `interval` parameter controls the time between colour toggles.
- * @note The `ledState` variable keeps track of the current LED state (ON/OFF).
- *
- * @see Blue() - Sets the LEDs to blue.
- * @see Green() - Sets the LEDs to green.
+ * @brief Maps a timeline signal to its pattern table, or to off if there is none.
  */
-void ColourPatterns::BGStrobe()
-{
-  unsigned long currentMillis = millis();
-  if (currentMillis - previousMillis >= interval)
-  {
-    // save the last time you blinked the LED
-    previousMillis = currentMillis;
-    // if the LED is off turn it on and vice-versa:
-    if (ledState == LOW)
-    {
-      Blue();
-      ledState = HIGH;
-    }
-    else
-    {
-      Green();
-      ledState = LOW;
-    }
-  }
+uint8_t ColourPatterns::patternIndex(int choice) {
+    return choice >= 0 && choice < PATTERN_OFF ? (uint8_t)choice : PATTERN_OFF;
 }
 
 /**
- * @brief Generates a green-red strobe colour pattern effect on RGB LEDs.
- *
- * This function creates a green-red strobe colour pattern effect on RGB LEDs by toggling
- * between green and red colours at regular intervals. It alternates between turning
- * on and off the LEDs to create a flashing effect.
- *
- * @note 13n GRStrobe
- * @note This function generates a two-colour strobe effect between green and red.
- * @note The `interval` parameter controls the time between colour toggles.
- * @note The `ledState` variable keeps track of the current LED state (ON/OFF).
+ * @brief Shows a blend of two `COLOUR_*` bitmasks with PWM, gamma corrected.
  *
- * @see Green() - Sets the LEDs to green.
- * @see Red() - Sets the LEDs to red.
+ * @param mix How far from `from` to `to`, 0-255.
  */
-void ColourPatterns::GRStrobe()
-{
-  unsigned long currentMillis = millis();
-  if (currentMillis - previousMillis >= interval)
-  {
-    // save the last time you blinked the LED
-    previousMillis = currentMillis;
-    // if the LED is off turn it on and vice-versa:
-    if (ledState == LOW)
-    {
-      Green();
-      ledState = HIGH;
-    }
-    else
-    {
-      Red();
-      ledState = LOW;
-    }
+void ColourPatterns::showBlend(uint8_t from, uint8_t to, uint8_t mix) {
+  uint16_t duty[3];
+  for (uint8_t led = 0; led < 3; led++) {
+    uint8_t mask = 1 << led;
+    uint8_t level = ((from & mask) ? 255 - mix : 0) + ((to & mask) ? mix : 0);
+    duty[led] = pgm_read_word(&ledGamma.duty[level]);
   }
+  output.writeDuty(duty[0], duty[1], duty[2]);
 }
 
 /**
- * @brief Turns off all RGB LEDs.
- *
- * This function turns off all RGB LEDs by setting their respective pins to a LOW state.
- * 
- * @note 14o Off
+ * @brief Prints how many LED writes were made and how many were skipped as unchanged.
  */
-void ColourPatterns::Off()
-{
-  digitalWrite(greenLed, LOW);
-  digitalWrite(blueLed, LOW);
-  digitalWrite(redLed, LOW);
-}
\ No newline at end of file
+void ColourPatterns::report(Print& out) {
+  output.report(out);
+}
@@ -0,0 +1,276 @@
+#include "EventWindow.h"
+
+/**
+ * @brief Opens a binary timeline file for windowed playback.
+ *
+ * The whole file is CRC-checked once in small chunks and the window is filled from the
+ * first event.
+ *
+ * @param path The binary timeline file to play.
+ *
+ * @return `true` if the file is valid, has at least one event and the window was filled.
+ *         An invalid file leaves the window as it was, so the current timeline plays on.
+ *
+ * @note The file is reopened through `storage` for each refill, so no handle is held
+ *       between calls.
+ */
+bool EventWindow::load(const char* path) {
+  TimelineReader reader;
+  bool valid = storage.begin() && reader.open(path) && reader.count() > 0 && reader.verify();
+  uint16_t count = reader.count();
+  uint32_t duration = reader.duration();
+  reader.close();
+  if (!valid) {
+    return false;
+  }
+
+  strncpy(this->path, path, sizeof(this->path) - 1);
+  this->path[sizeof(this->path) - 1] = '\0';
+  image = nullptr;
+  eventCount = count;
+  passDuration = duration;
+  if (!fill()) {
+    unload();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Plays a timeline held in RAM.
+ *
+ * Only the header is checked, so switching to an already verified copy (see TimelineCache)
+ * costs no more than decoding the first window of events.
+ *
+ * @param image The timeline file contents; must stay valid while it is playing.
+ * @param size Size of `image` in bytes.
+ *
+ * @return `true` if the image has at least one event and the window was filled. An
+ *         invalid image leaves the window as it was.
+ */
+bool EventWindow::load(const uint8_t* image, size_t size) {
+  TimelineReader reader;
+  bool valid = reader.open(image, size) && reader.count() > 0;
+  uint16_t count = reader.count();
+  uint32_t duration = reader.duration();
+  reader.close();
+  if (!valid) {
+    return false;
+  }
+
+  this->image = image;
+  imageSize = size;
+  eventCount = count;
+  passDuration = duration;
+  if (!fill()) {
+    unload();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Forgets the current timeline.
+ */
+void EventWindow::unload() {
+  image = nullptr;
+  eventCount = 0;
+  buffered = 0;
+  cursor = 0;
+}
+
+/**
+ * @brief Number of events in the timeline.
+ */
+uint16_t EventWindow::size() {
+  return eventCount;
+}
+
+/**
+ * @brief Length of one pass through the timeline in milliseconds.
+ */
+uint32_t EventWindow::duration() {
+  return passDuration;
+}
+
+/**
+ * @brief The next event to fire.
+ *
+ * @return The event at the cursor, or `nullptr` once every event of this pass has fired.
+ */
+const TimelineRecord* EventWindow::current() {
+  if (cursor >= eventCount) {
+    return nullptr;
+  }
+  if (buffered == 0) {
+    refill(); // playback caught up with the window, read now rather than skip an event
+  }
+  return buffered > 0 ? &ring[head] : nullptr;
+}
+
+/**
+ * @brief The event after `current()` in the same pass.
+ *
+ * @return The following event, or `nullptr` if `current()` is the last event.
+ */
+const TimelineRecord* EventWindow::following() {
+  if (cursor + 1 >= eventCount) {
+    return nullptr;
+  }
+  if (buffered < 2) {
+    refill();
+  }
+  return buffered > 1 ? &ring[(head + 1) % EVENT_WINDOW_SIZE] : nullptr;
+}
+
+/**
+ * @brief Index of the next event to fire, equal to `size()` at the end of a pass.
+ */
+uint16_t EventWindow::position() {
+  return cursor;
+}
+
+/**
+ * @brief Moves the cursor past the current event.
+ *
+ * @note Only valid after `current()` returned an event.
+ */
+void EventWindow::advance() {
+  if (cursor >= eventCount || buffered == 0) {
+    return;
+  }
+  head = (head + 1) % EVENT_WINDOW_SIZE;
+  buffered--;
+  cursor++;
+}
+
+/**
+ * @brief Moves the cursor back to the first event for the next pass.
+ *
+ * At the end of a pass the start of the timeline is already buffered, so this costs no
+ * flash access.
+ */
+void EventWindow::rewind() {
+  if (cursor == eventCount) {
+    cursor = 0;
+  } else {
+    fill();
+  }
+}
+
+/**
+ * @brief Places the cursor after the event active at a given time.
+ *
+ * Binary search over the file's seek index (O(log n) reads), then at most one index
+ * interval of events is decoded to find the exact event, and the window is refilled from
+ * the new cursor.
+ *
+ * @param ms Playback time in milliseconds since the start of the timeline.
+ * @param active Set to the event active at `ms`, if there is one.
+ *
+ * @return Index of the active event, or -1 if `ms` is before the first event.
+ */
+int EventWindow::seek(long ms, TimelineRecord& active) {
+  TimelineReader reader;
+  if (eventCount == 0 || !openReader(reader)) {
+    return -1;
+  }
+  TimelinePosition position;
+  if (!reader.find(ms, position)) {
+    reader.close();
+    return -1;
+  }
+
+  int index = (int)position.index - 1;
+  TimelinePosition before = position;
+  TimelineRecord record;
+  while (reader.next(record, position)) {
+    if ((long)record.timing > ms) {
+      break;
+    }
+    active = record;
+    index = before.index;
+    before = position;
+  }
+
+  cursor = index + 1;
+  head = 0;
+  buffered = 0;
+  nextRead = cursor >= eventCount ? reader.start() : before;
+  readAhead(reader, EVENT_WINDOW_SIZE);
+  reader.close();
+  return index;
+}
+
+/**
+ * @brief Tops up the window from flash once enough of it has been played.
+ *
+ * Does nothing while fewer than `EVENT_WINDOW_REFILL` slots are free, so it is cheap to call
+ * on every playback tick.
+ */
+void EventWindow::refill() {
+  if (eventCount == 0 || EVENT_WINDOW_SIZE - buffered < EVENT_WINDOW_REFILL) {
+    return;
+  }
+  TimelineReader reader;
+  if (openReader(reader)) {
+    readAhead(reader, EVENT_WINDOW_REFILL);
+    reader.close();
+  }
+}
+
+/**
+ * @brief Opens a reader on the playing timeline, in RAM or on flash.
+ */
+bool EventWindow::openReader(TimelineReader& reader) {
+  if (image != nullptr) {
+    return reader.open(image, imageSize);
+  }
+  return storage.begin() && reader.open(path);
+}
+
+/**
+ * @brief Empties the window and fills it from the first event.
+ *
+ * @return `true` if at least one event was read.
+ */
+bool EventWindow::fill() {
+  cursor = 0;
+  head = 0;
+  buffered = 0;
+  TimelineReader reader;
+  if (!openReader(reader)) {
+    return false;
+  }
+  nextRead = reader.start();
+  readAhead(reader, EVENT_WINDOW_SIZE);
+  reader.close();
+  return buffered > 0;
+}
+
+/**
+ * @brief Decodes events after the last buffered one, wrapping to the start of the timeline.
+ *
+ * @param reader An open reader for the timeline file.
+ * @param maxRecords The most events to read.
+ *
+ * @return `false` if the file could not be read.
+ */
+bool EventWindow::readAhead(TimelineReader& reader, uint8_t maxRecords) {
+  uint8_t wanted = EVENT_WINDOW_SIZE - buffered;
+  if (wanted > maxRecords) {
+    wanted = maxRecords;
+  }
+  while (wanted > 0) {
+    uint8_t slot = (head + buffered) % EVENT_WINDOW_SIZE;
+    if (!reader.next(ring[slot], nextRead)) {
+      return false;
+    }
+    buffered++;
+    wanted--;
+    if (nextRead.index >= eventCount) {
+      nextRead = reader.start();
+    }
+  }
+  return true;
+}
@@ -0,0 +1,121 @@
+#include "Histogram.h"
+
+/**
+ * @brief Counts one value.
+ */
+void Histogram::add(uint32_t value) {
+  counts[bucket(value)]++;
+  total++;
+  sum += value;
+  if (value < lowest) {
+    lowest = value;
+  }
+  if (value > highest) {
+    highest = value;
+  }
+}
+
+/**
+ * @brief Forgets every value counted so far.
+ */
+void Histogram::clear() {
+  memset(counts, 0, sizeof(counts));
+  total = 0;
+  sum = 0;
+  lowest = UINT32_MAX;
+  highest = 0;
+}
+
+/**
+ * @brief Number of values counted.
+ */
+uint32_t Histogram::count() {
+  return total;
+}
+
+/**
+ * @brief Lowest value counted, exactly, or 0 if nothing has been counted.
+ */
+uint32_t Histogram::min() {
+  return total > 0 ? lowest : 0;
+}
+
+/**
+ * @brief Highest value counted, exactly.
+ */
+uint32_t Histogram::max() {
+  return highest;
+}
+
+/**
+ * @brief Mean of the values counted, exactly.
+ */
+uint32_t Histogram::mean() {
+  return total > 0 ? sum / total : 0;
+}
+
+/**
+ * @brief The value that `percent`% of the values are at or below.
+ *
+ * @return The top of the bucket that value is in, or `max()` if that is lower; 0 if
+ *         nothing has been counted.
+ */
+uint32_t Histogram::percentile(uint8_t percent) {
+  if (total == 0) {
+    return 0;
+  }
+  uint32_t rank = ((uint64_t)total * percent + 99) / 100;
+  if (rank == 0) {
+    rank = 1;
+  }
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      uint32_t top = bucketTop(i);
+      return top < highest ? top : highest;
+    }
+  }
+  return highest;
+}
+
+/**
+ * @brief Prints the count, minimum, mean, p50, p90, p99 and maximum on one line.
+ */
+void Histogram::report(Print& out, const char* name, const char* unit) {
+  out.print(name);
+  out.print(": n ");
+  out.print(total);
+  out.print(", min ");
+  out.print(min());
+  out.print(", mean ");
+  out.print(mean());
+  out.print(", p50 ");
+  out.print(percentile(50));
+  out.print(", p90 ");
+  out.print(percentile(90));
+  out.print(", p99 ");
+  out.print(percentile(99));
+  out.print(", max ");
+  out.print(highest);
+  out.print(" ");
+  out.println(unit);
+}
+
+uint8_t Histogram::bucket(uint32_t value) {
+  if (value < 4) {
+    return value;
+  }
+  uint8_t power = 31 - __builtin_clz(value);
+  return power * 2 + ((value >> (power - 1)) & 1);
+}
+
+uint32_t Histogram::bucketTop(uint8_t index) {
+  if (index < 4) {
+    return index;
+  }
+  uint8_t power = index / 2;
+  uint32_t half = (uint32_t)1 << (power - 1);
+  uint32_t bottom = ((uint32_t)1 << power) + (index & 1) * half;
+  return bottom + (half - 1);
+}
@@ -0,0 +1,128 @@
+#include "HttpBodyReader.h"
+
+/**
+ * @brief Starts reading a new response body.
+ *
+ * @param stream The connection stream from `HTTPClient::getStreamPtr()`.
+ * @param contentLength The body length from `HTTPClient::getSize()`, or -1 if unknown.
+ * @param chunked `true` if the response uses `Transfer-Encoding: chunked`.
+ */
+void HttpBodyReader::begin(WiFiClient* stream, int contentLength, bool chunked) {
+  this->stream = stream;
+  remaining = chunked ? 0 : contentLength;
+  chunkSizeDigits = 0;
+  trailerLineLength = 0;
+  if (stream == nullptr) {
+    state = Failed;
+  } else if (chunked) {
+    state = ChunkSize;
+  } else {
+    state = contentLength == 0 ? Finished : Body;
+  }
+}
+
+/**
+ * @brief Copies whatever body bytes have already arrived into `buffer`.
+ *
+ * @param buffer Destination for body bytes (chunk framing is removed).
+ * @param size Capacity of `buffer`.
+ *
+ * @return The number of body bytes copied, which may be 0 if nothing has arrived yet.
+ *
+ * @note Check `finished()` or `failed()` to know when to stop calling this.
+ */
+int HttpBodyReader::read(uint8_t* buffer, size_t size) {
+  size_t copied = 0;
+  while (copied < size && state != Finished && state != Failed) {
+    int available = stream->available();
+    if (available <= 0) {
+      if (!stream->connected()) {
+        // the server closed the connection: fine for an unsized body, an error otherwise
+        state = (state == Body && remaining < 0) ? Finished : Failed;
+      }
+      break;
+    }
+
+    if (state == Body || state == ChunkData) {
+      size_t wanted = size - copied;
+      if ((size_t)available < wanted) {
+        wanted = available;
+      }
+      if (remaining >= 0 && (size_t)remaining < wanted) {
+        wanted = remaining;
+      }
+      int got = stream->read(buffer + copied, wanted);
+      if (got <= 0) {
+        break;
+      }
+      copied += got;
+      if (remaining >= 0) {
+        remaining -= got;
+        if (remaining == 0) {
+          state = state == Body ? Finished : ChunkDataEnd;
+        }
+      }
+      continue;
+    }
+
+    int c = stream->read();
+    switch (state) {
+      case ChunkSize:
+        if (isxdigit(c) && (++chunkSizeDigits > HTTP_CHUNK_SIZE_DIGITS || remaining > (INT32_MAX >> 4))) {
+          state = Failed; // longer than any real chunk, or too big for `remaining`
+        } else if (c >= '0' && c <= '9') {
+          remaining = remaining * 16 + (c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+          remaining = remaining * 16 + (c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+          remaining = remaining * 16 + (c - 'A' + 10);
+        } else if (c == ';') {
+          state = ChunkExtension;
+        } else if (c == '\n') {
+          state = remaining == 0 ? Trailer : ChunkData;
+        } else if (c != '\r' && c != ' ') {
+          state = Failed;
+        }
+        break;
+      case ChunkExtension:
+        if (c == '\n') {
+          state = remaining == 0 ? Trailer : ChunkData;
+        }
+        break;
+      case ChunkDataEnd:
+        if (c == '\n') {
+          remaining = 0;
+          chunkSizeDigits = 0;
+          state = ChunkSize;
+        }
+        break;
+      case Trailer:
+        if (c == '\n') {
+          if (trailerLineLength == 0) {
+            state = Finished;
+          }
+          trailerLineLength = 0;
+        } else if (c != '\r' && trailerLineLength < 255) {
+          trailerLineLength++;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  return copied;
+}
+
+/**
+ * @brief Returns `true` once the whole body has been read.
+ */
+bool HttpBodyReader::finished() {
+  return state == Finished;
+}
+
+/**
+ * @brief Returns `true` if the connection dropped or the chunk framing was invalid.
+ */
+bool HttpBodyReader::failed() {
+  return state == Failed;
+}
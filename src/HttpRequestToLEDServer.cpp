@@ -28,21 +28,31 @@
  */
 
 #include <Arduino.h>
-#include <LittleFS.h>
 #include <WiFiClient.h>
 #include <ESP8266WiFi.h>
 #include <ESP8266WiFiMulti.h>
 #include <ESP8266HTTPClient.h>
 #include <ArduinoJson.h>
 
-#include <LittleFS.h>
-
 #include <EEPROM.h>
 
 #include "ColourPatterns.h"
+#ifdef MAGICPOI_NATIVE
+#include "NativeSecrets.h" // pio run -e native: lib/NativeHal
+#else
 #include "secrets.h"
+#endif
 
+#include "Storage.h"
 #include "TimelineManager.h"
+#include "TimelineSync.h"
+#include "ClockSync.h"
+#include "WallClock.h"
+#include "LoopScheduler.h"
+#include "TimelineBenchmark.h"
+#include "LoopStats.h"
+#include "LocalApi.h"
+#include "LiveControl.h"
 
 #define led D4 // built in LED on my D1 mini
 
@@ -75,21 +85,36 @@ int attempts = 0;    // Initialize the attempts counter
 
 const char *jwtFilePath = "/jwt.txt";
 
-String globaltimelineData = "";
-String timelineNumber = "0";
+char timelineNumber[8] = "0";
 int timelineNumberNum = 1; // starts at 1
 bool checkServerForTimelineNumber = true;
 int maxTimelineNumbers = 1; //todo: should be updated in setup()?
-
-String timelineFilePath = "/timeline" + timelineNumber + ".txt";
+volatile bool switchRequested = false; // set by switchInterrupt(), handled in loop()
+volatile bool syncRequested = true; // download all timelines in the background (at boot, or from switchInterruptTwo())
+volatile bool activateAfterSync = true; // load timelineNumber once the sync has finished
+const unsigned long syncRetryInterval = 10000; // ms to wait before retrying a failed sync
+unsigned long nextSyncAttempt = 0;
+unsigned long lastConnected = 0; // millis() Wi-Fi was last seen connected, for switching the modem off
 
 // function declarations:
 void buttonInterrupt();
 void switchInterrupt();
 void switchInterruptTwo();
+void checkSerialCommands();
+void runSerialCommand(const char* command);
 
 ColourPatterns patternHandler(redLed, greenLed, blueLed);              // Create an instance of the ColourPatterns class
 TimelineManager tm(jwtFilePath, serverIP, email, passwordJwt, client); // Create an instance of the TimelineManager class
+TimelineSync timelineSync(tm);                                          // Downloads timelines a slice per loop()
+ClockSync clockSync;                                                    // Playback clock shared with the other poi on the LAN
+WallClock wallClock;                                                    // SNTP time, for timelines scheduled to start at a set time
+LoopScheduler scheduler;                                                // Sleeps loop() until the next thing is due
+TimelineBenchmark benchmark(tm, patternHandler);                        // Run by the "bench" serial command
+LocalApi localApi(tm, timelineSync);                                    // Timeline uploads over the LAN, no internet needed
+LiveControl liveControl(tm, patternHandler, scheduler);                 // Patterns and playback from a WebSocket controller
+
+char serialCommand[16]; // serial command being typed, see checkSerialCommands()
+uint8_t serialCommandLength = 0;
 
 // TODO: buttons and behaviour:
 // Button 1: Fetch new timelines and colours - and re-set the timeline to the current one (on server). Todo: get all timelines and colour sequences, save all for toggle below.
@@ -131,8 +156,9 @@ if ( long ( micros() - last_micros ) >= debounceTime * 1000 )
  * @brief Interrupt service routine (ISR) for handling a switch state change event.
  *
  * This ISR is triggered when a change in the state of a switch is detected. It checks
- * for debounce to prevent false triggers and advances the timelineNumberNum and sets
- * the alreadyGotData flag to false - setting off a re-load of current timeline. 
+ * for debounce to prevent false triggers, advances the timelineNumberNum and sets
+ * switchRequested, so that loop() activates the new timeline from RAM or flash without
+ * going to the network.
  *
  * @note pin 2
  * @note Debouncing is implemented to prevent false triggers; the `debounceTime`
@@ -142,10 +168,7 @@ if ( long ( micros() - last_micros ) >= debounceTime * 1000 )
  * @see last_micros - Keeps track of the last microsecond timestamp.
  * @see timelineNumberNum - Keeps track of the current timeline number.
  * @see maxTimelineNumbers - Defines the maximum timeline number allowed.
- * @see timelineNumber - Stores the current timeline number as a string.
- * @see checkServerForTimelineNumber - A flag to indicate whether to check the server
- *       for the timeline number.
- * @see tm.setAlreadyGotData() - Method to set the flag indicating timeline data status.
+ * @see switchRequested - Tells loop() to switch to timelineNumberNum.
  */
 void IRAM_ATTR switchInterrupt()
 { 
@@ -157,10 +180,9 @@ if ( long ( micros() - last_micros ) >= debounceTime * 1000 )
       if(timelineNumberNum > maxTimelineNumbers){
         timelineNumberNum = 1;
       }
-      Serial.println("Switched to number " + timelineNumberNum);
-      timelineNumber = String(timelineNumberNum);
-      checkServerForTimelineNumber = false;
-      tm.setAlreadyGotData(false); //re-load timeline data with new number - currently re-loads all (bad?) 
+      Serial.print("Switched to number ");
+      Serial.println(timelineNumberNum);
+      switchRequested = true; // activated in loop() from the timeline cache or flash
       last_micros = micros();
     }
   
@@ -171,7 +193,7 @@ if ( long ( micros() - last_micros ) >= debounceTime * 1000 )
  *
  * This ISR is triggered when a change in the state of a second switch is detected. It checks
  * for debounce to prevent false triggers and sets the trigger for fetching the latest timeline
- * from the api
+ * from the api. The current timeline keeps playing until the download has finished.
  *
  * @note Debouncing is implemented to prevent false triggers; the `debounceTime` parameter
  *       controls the debounce duration in microseconds.
@@ -180,7 +202,8 @@ if ( long ( micros() - last_micros ) >= debounceTime * 1000 )
  * @see last_micros - Keeps track of the last microsecond timestamp.
  * @see checkServerForTimelineNumber - A flag to indicate whether to check the server for
  *       the timeline number.
- * @see tm.setAlreadyGotData() - Method to set the flag indicating timeline data status.
+ * @see syncRequested - Starts a background sync in loop().
+ * @see activateAfterSync - Switches to the server's timeline once the sync has finished.
  */
 void IRAM_ATTR switchInterruptTwo()
 { // pin 1
@@ -188,13 +211,100 @@ void IRAM_ATTR switchInterruptTwo()
     {
       // handle the ISR routine here then update last_micros
     checkServerForTimelineNumber = true;
-    tm.setAlreadyGotData(false); //sets off update of current timeline from api in loop()
+    syncRequested = true; //sets off update of current timeline from api in loop()
+    activateAfterSync = true;
     Serial.println("switchTwo ISR!!!");
       last_micros = micros();
     }
   
 }
 
+/**
+ * @brief Reads whatever has arrived on the serial port and runs each complete line as a
+ *        command.
+ *
+ * @note Lines longer than the command buffer are cut short, and so not recognised.
+ * @see runSerialCommand() - The commands.
+ */
+void checkSerialCommands()
+{
+  while (Serial.available() > 0)
+  {
+    char c = Serial.read();
+    if (c == '\n' || c == '\r')
+    {
+      if (serialCommandLength > 0)
+      {
+        serialCommand[serialCommandLength] = '\0';
+        serialCommandLength = 0;
+        runSerialCommand(serialCommand);
+      }
+    }
+    else if (serialCommandLength < sizeof(serialCommand) - 1)
+    {
+      serialCommand[serialCommandLength++] = c;
+    }
+  }
+}
+
+/**
+ * @brief Runs one serial command.
+ *
+ * - `bench` times parsing, activating and playing synthetic timelines (TimelineBenchmark),
+ *   then reloads the timeline that was playing. Waits for a running sync to finish first.
+ * - `stats` prints the loop, playback, network, flash and heap histograms (LoopStats);
+ *   `stats reset` empties them.
+ * - `sync` starts a background sync, as switch two does but without switching timeline.
+ *   Its end is logged with the change in free heap, which should be zero.
+ * - `clock` prints the shared playback clock and how it is synced (ClockSync).
+ * - `loop` prints how long `loop()` has slept since the last report (LoopScheduler).
+ */
+void runSerialCommand(const char* command)
+{
+  if (strcmp(command, "bench") == 0)
+  {
+    if (timelineSync.busy())
+    {
+      Serial.println("Sync running, try bench again when it has finished.");
+      return;
+    }
+    bool wasPlaying = tm.alreadyGotData();
+    benchmark.run(Serial);
+    if (!wasPlaying || !tm.loadTimeline(timelineNumber))
+    {
+      tm.setAlreadyGotData(false);
+    }
+  }
+  else if (strcmp(command, "stats") == 0)
+  {
+    loopStats.report(Serial);
+  }
+  else if (strcmp(command, "stats reset") == 0)
+  {
+    loopStats.clear();
+    Serial.println("Stats cleared.");
+  }
+  else if (strcmp(command, "sync") == 0)
+  {
+    syncRequested = true;
+    nextSyncAttempt = millis();
+  }
+  else if (strcmp(command, "clock") == 0)
+  {
+    clockSync.report(Serial);
+  }
+  else if (strcmp(command, "loop") == 0)
+  {
+    scheduler.report(Serial);
+  }
+  else
+  {
+    Serial.print("Unknown command: ");
+    Serial.println(command);
+    Serial.println("Commands: bench, stats, stats reset, sync, clock, loop");
+  }
+}
+
 /**
  * @brief Arduino setup function executed once on startup.
  *
@@ -235,6 +345,11 @@ void setup()
 
   Serial.begin(115200);
 
+  storage.begin(); // mounted once, for the life of the program
+  tm.setClock(&clockSync); // play on the clock shared with the other poi once it is synced
+  tm.setWallClock(&wallClock); // and start scheduled timelines on time
+  localApi.addHandler(liveControl.handler()); // ws://<poi>/live
+
   WiFi.mode(WIFI_STA);
   WiFiMulti.addAP(ssid, password);
 
@@ -261,10 +376,15 @@ void setup()
 
     if(tm.gotTokenTrue()){
       Serial.println("////////////////////////////Setup vars (on WiFi)//////////////////////////////////////////////");    
-      maxTimelineNumbers = tm.getTotalTimelines().toInt(); // fetch total number of timelines from server
-      Serial.println("maxTimelineNumbers is: " + String(maxTimelineNumbers));
-      timelineNumberNum = tm.getTimelineNumber().toInt(); // fetch current active timeline from server
-      Serial.println("timelineNumberNum is: " + String(timelineNumberNum));
+      maxTimelineNumbers = tm.getTotalTimelines(); // fetch total number of timelines from server
+      Serial.print("maxTimelineNumbers is: ");
+      Serial.println(maxTimelineNumbers);
+      char serverNumber[8];
+      if (tm.getTimelineNumber(serverNumber, sizeof(serverNumber))) { // fetch current active timeline from server
+        timelineNumberNum = atoi(serverNumber);
+      }
+      Serial.print("timelineNumberNum is: ");
+      Serial.println(timelineNumberNum);
       Serial.println("/////////////////////////////////////////////////////////////////////////////////////////");
     }
     
@@ -275,101 +395,169 @@ void setup()
   
   patternHandler.runLoading(); // loading pattern RGB in ColourPatterns.cpp
   last_micros = micros(); // initialise for for button debounce
+  lastConnected = millis();
 }
 
 /**
  * @brief Arduino loop function executed repeatedly after setup.
  *
- * This function manages the main program logic, including handling network connections,
- * authentication, and timeline retrieval. It also updates LED patterns based on timeline data.
+ * This function plays the active timeline on every pass and, alongside it, runs one slice of
+ * the background timeline sync, so downloads never stop the LEDs from updating.
  *
- * @note The loop function continuously runs the main program logic once the setup is complete.
- * @note It checks for the availability of timeline data and network connectivity to perform actions.
- * @note Actions include authenticating, retrieving timeline data, and updating LED patterns.
+ * @note A sync is started at boot, when switch two is pressed, and (after a short wait) when
+ *       a previous sync failed or a timeline could not be loaded.
+ * @note Each sync step does at most one short API request or one bounded download slice.
+ * @note Downloads go to flash only. A timeline is activated when asked: after the sync if
+ *       `activateAfterSync` is set, or straight away when switch one is pressed.
  * @note LED patterns are updated based on the signal received from timeline data.
+ * @note Serial commands are read at the start of each pass, see runSerialCommand().
+ * @note loopStats counts the time between passes and the cost of the playback branch, and
+ *       samples the heap before sleeping.
+ * @note Each pass ends by sleeping until the next timeline event, pattern frame or clock
+ *       packet is due, and after `WIFI_OFFLINE_TIMEOUT` without Wi-Fi during playback the
+ *       modem is switched off until switch two asks for a sync.
  *
- * @see tm.alreadyGotData() - Checks if timeline data has already been retrieved.
- * @see WiFiMulti.run() - Manages Wi-Fi connections.
- * @see tm.gotTokenTrue() - Checks if a JWT token has been obtained.
- * @see tm.authenticate() - Authenticates with the server and obtains a JWT token.
+ * @see timelineSync - The background sync state machine.
+ * @see clockSync - The playback clock shared with the other poi.
+ * @see localApi - Timelines uploaded over the LAN, compiled a slice per pass.
+ * @see scheduler - Sleeps between passes and switches the modem off.
  * @see checkServerForTimelineNumber - A flag to indicate whether to check the server for the timeline number.
- * @see tm.getTimelineNumber() - Retrieves the current timeline number.
- * @see tm.clearTimeline() - Clears existing timeline data.
- * @see tm.getAllTimelines() - Requests all available timelines from the server.
- * @see tm.getTimeline() - Retrieves timeline data from the server.
  * @see tm.loadTimeline() - Loads timeline data for playback.
- * @see tm.setAlreadyGotData() - Sets the flag indicating timeline data status.
- * @see tm.setPlaying() - Sets the flag to indicate timeline playback.
+ * @see tm.alreadyGotData() - Checks if a timeline is loaded.
+ * @see liveControl - Patterns, switches and playback from a WebSocket controller.
+ * @see switchRequested - Switches to another timeline already on the device.
  * @see signal - Stores the signal received from timeline data for LED pattern updates.
  * @see patternHandler.changeColours() - Updates LED patterns based on the signal.
  */
 void loop()
 {
+  loopStats.loopStarted();
+  checkSerialCommands();
 
-  if (!tm.alreadyGotData())
+  if (switchRequested)
   {
-    // wait for WiFi connection to update
-    if ((WiFiMulti.run() == WL_CONNECTED))
+    switchRequested = false;
+    snprintf(timelineNumber, sizeof(timelineNumber), "%d", timelineNumberNum);
+    checkServerForTimelineNumber = false;
+    if (!tm.loadTimeline(timelineNumber))
     {
-      Serial.println("already_got_data false");
-      if (!tm.gotTokenTrue())
-      {
-        if (tm.authenticate())
-        {
-          if(checkServerForTimelineNumber){
-            timelineNumber = tm.getTimelineNumber();
-          }
-          
-          if (!timelineNumber.length() == 0)
-          {
-            Serial.print("got timeline number in loop: ");
-            Serial.println(timelineNumber);
-            tm.clearTimeline(timelineNumber); // make sure we start from scratch..
-            tm.getAllTimelines(); 
-            tm.getTimeline(timelineNumber);
-            tm.loadTimeline(timelineNumber);
-            tm.setAlreadyGotData(true);
-          }
-          else
-          {
-            Serial.println("no timelineNumber available in loop?");
-          }
-        }
-        else
-        {
-          Serial.println("Authentication failed.");
-          return;
-        }
-      }
-      else
+      syncRequested = true; // not downloaded yet, fetch it
+      activateAfterSync = true;
+    }
+  }
+
+  if (WiFi.status() == WL_CONNECTED)
+  {
+    lastConnected = millis();
+  }
+  else if (syncRequested && scheduler.radioSleeping())
+  {
+    scheduler.radioOn(); // switch two, or a timeline missing from flash: go back online
+    WiFi.begin(ssid, password);
+    lastConnected = millis();
+  }
+  else if (!scheduler.radioSleeping() && tm.alreadyGotData() && !timelineSync.busy()
+           && millis() - lastConnected >= WIFI_OFFLINE_TIMEOUT)
+  {
+    scheduler.radioOff(); // playing from flash with no network in reach
+    clockSync.stop();     // both start again once Wi-Fi reconnects
+    wallClock.stop();
+    syncRequested = false; // until switch two asks again
+    scheduler.report(Serial);
+  }
+
+  // WiFi.status() rather than WiFiMulti.run(), which can block for a scan; the ESP reconnects by itself
+  if (syncRequested && !timelineSync.busy() && !localApi.busy() && (long)(millis() - nextSyncAttempt) >= 0
+      && WiFi.status() == WL_CONNECTED)
+  {
+    syncRequested = false;
+    timelineSync.start(checkServerForTimelineNumber);
+  }
+
+  timelineSync.step();
+
+  if (WiFi.status() == WL_CONNECTED)
+  {
+    if (!clockSync.started())
+    {
+      clockSync.begin(CLOCK_SYNC_LEADER); // retries a failed port on its own backoff
+    }
+    if (!wallClock.started())
+    {
+      wallClock.begin(NTP_SERVER);
+    }
+    if (!localApi.started())
+    {
+      localApi.begin();
+    }
+  }
+  clockSync.update(); // answers or sends clock packets, never blocks
+
+  if (localApi.update())
+  {
+    strcpy(timelineNumber, localApi.uploadedNumber()); // both hold up to 7 digits
+    timelineNumberNum = atoi(timelineNumber);
+    checkServerForTimelineNumber = false;
+    tm.loadTimeline(timelineNumber);
+  }
+  if (liveControl.update())
+  {
+    strcpy(timelineNumber, liveControl.switchedNumber()); // both hold up to 7 digits
+    timelineNumberNum = atoi(timelineNumber);
+    checkServerForTimelineNumber = false;
+  }
+
+  if (timelineSync.finished())
+  {
+    storage.report(Serial);
+    scheduler.report(Serial);
+    patternHandler.report(Serial);
+    if (timelineSync.total() > 0)
+    {
+      maxTimelineNumbers = timelineSync.total();
+    }
+    if (checkServerForTimelineNumber && timelineSync.activeNumber()[0] != '\0')
+    {
+      strcpy(timelineNumber, timelineSync.activeNumber()); // both hold up to 7 digits
+    }
+    if (activateAfterSync)
+    {
+      activateAfterSync = false;
+      if (!tm.loadTimeline(timelineNumber))
       {
-        Serial.println("Got token already, no authentication needed..");
-        if(checkServerForTimelineNumber){
-            timelineNumber = tm.getTimelineNumber();
-          }
-        if (!timelineNumber.length() == 0)
-        {
-          Serial.print("got timeline number in loop: ");
-          Serial.println(timelineNumber);
-          tm.getAllTimelines(); 
-          tm.getTimeline(timelineNumber);
-          tm.loadTimeline(timelineNumber);
-          tm.setAlreadyGotData(true);
-        }
-        else
-        {
-          Serial.println("no timelineNumber available in loop?");
-          tm.setToken(false);
-        }
+        syncRequested = true; // missing or corrupt, fetch again
+        activateAfterSync = true;
+        nextSyncAttempt = millis() + syncRetryInterval;
       }
     }
+    tm.updateSchedule(); // the manifest may have moved the show's start time
   }
-  else
+  else if (timelineSync.failed())
+  {
+    syncRequested = true;
+    nextSyncAttempt = millis() + syncRetryInterval;
+  }
+
+  if (tm.alreadyGotData())
   {
-    // Serial.println("already_got_data true"); // most times this is true
-    tm.setPlaying(true);
-    signal = tm.checkTimelineData(); // this plays back the timeline in getTimeline(timelineNumber);
+    uint32_t playbackStarted = loopStats.startTiming();
+    signal = tm.checkTimelineData(); // plays back the active timeline, whatever the sync is doing
 
     patternHandler.changeColours(signal);
+    loopStats.endPlayback(playbackStarted);
+    scheduler.wakeBy(tm.nextEventDeadline());
+    scheduler.wakeIn(patternHandler.nextChange(signal));
+  }
+
+  if (timelineSync.busy() || localApi.compiling())
+  {
+    scheduler.wakeIn(0); // download and compile slices run back to back
+  }
+  else if (syncRequested && WiFi.status() == WL_CONNECTED)
+  {
+    scheduler.wakeBy(nextSyncAttempt);
   }
+  scheduler.wakeIn(clockSync.maxSleep());
+  loopStats.sampleHeap();
+  scheduler.sleep();
 }
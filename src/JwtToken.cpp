@@ -0,0 +1,78 @@
+#include "JwtToken.h"
+
+/**
+ * @brief Value of a base64url character, or -1 if it is not one.
+ */
+static int base64UrlValue(char c) {
+  if (c >= 'A' && c <= 'Z') {
+    return c - 'A';
+  }
+  if (c >= 'a' && c <= 'z') {
+    return c - 'a' + 26;
+  }
+  if (c >= '0' && c <= '9') {
+    return c - '0' + 52;
+  }
+  if (c == '-' || c == '+') {
+    return 62;
+  }
+  if (c == '_' || c == '/') {
+    return 63;
+  }
+  return -1;
+}
+
+/**
+ * @brief Reads a numeric claim, such as `exp` or `iat`, from the payload of a JWT.
+ *
+ * The payload (the part between the two dots) is base64url decoded into a small stack
+ * buffer and searched for `"<claim>":<number>`. The signature is not checked; the claim is
+ * only used to decide when to log in again.
+ *
+ * @param token The JWT.
+ * @param claim The claim name, e.g. "exp".
+ * @param value Set to the claim's value.
+ *
+ * @return `false` if the token is malformed or has no such numeric claim.
+ */
+bool jwtNumericClaim(const char* token, const char* claim, uint32_t& value) {
+  const char* payload = strchr(token, '.');
+  if (payload == nullptr) {
+    return false;
+  }
+  payload++;
+
+  char decoded[192];
+  size_t length = 0;
+  uint32_t bits = 0;
+  uint8_t bitCount = 0;
+  for (const char* c = payload; *c != '\0' && *c != '.' && length < sizeof(decoded) - 1; c++) {
+    int v = base64UrlValue(*c);
+    if (v < 0) {
+      break;
+    }
+    bits = (bits << 6) | v;
+    bitCount += 6;
+    if (bitCount >= 8) {
+      bitCount -= 8;
+      decoded[length++] = (bits >> bitCount) & 0xFF;
+    }
+  }
+  decoded[length] = '\0';
+
+  char key[16];
+  snprintf(key, sizeof(key), "\"%s\"", claim);
+  const char* found = strstr(decoded, key);
+  if (found == nullptr) {
+    return false;
+  }
+  found += strlen(key);
+  while (*found == ' ' || *found == ':') {
+    found++;
+  }
+  if (*found < '0' || *found > '9') {
+    return false;
+  }
+  value = strtoul(found, nullptr, 10);
+  return true;
+}
@@ -0,0 +1,107 @@
+#include "LedOutput.h"
+
+/**
+ * @brief Constructs the output stage for three LED pins.
+ *
+ * @param redPin The pin number connected to the red LED.
+ * @param greenPin The pin number connected to the green LED.
+ * @param bluePin The pin number connected to the blue LED.
+ */
+LedOutput::LedOutput(int redPin, int greenPin, int bluePin) : pins{redPin, greenPin, bluePin} {
+}
+
+/**
+ * @brief Sets the pins as outputs and works out their bits in the output register.
+ */
+void LedOutput::begin() {
+  registerMask = 0;
+  bool reachable = true;
+  for (uint8_t led = 0; led < 3; led++) {
+    pinMode(pins[led], OUTPUT);
+    reachable = reachable && pins[led] >= 0 && pins[led] < 16;
+    pinBits[led] = reachable ? 1UL << pins[led] : 0;
+    registerMask |= pinBits[led];
+  }
+  if (!reachable) {
+    registerMask = 0;
+  }
+}
+
+/**
+ * @brief Shows a `COLOUR_*` bitmask (bit 0 red, 1 green, 2 blue), all three channels at once.
+ *
+ * @note Skipped if the LEDs already show it. After PWM the pins are written with
+ *       `digitalWrite()` once, which stops the PWM on them.
+ */
+void LedOutput::write(uint8_t colour) {
+  if (mode == Digital && colour == lastColour) {
+    skipCount++;
+    return;
+  }
+
+  if (mode != Digital || registerMask == 0) {
+    for (uint8_t led = 0; led < 3; led++) {
+      digitalWrite(pins[led], (colour & (1 << led)) ? HIGH : LOW);
+    }
+    mode = Digital;
+  } else {
+    uint32_t bits = 0;
+    for (uint8_t led = 0; led < 3; led++) {
+      if (colour & (1 << led)) {
+        bits |= pinBits[led];
+      }
+    }
+    noInterrupts(); // so an interrupt cannot change another pin between the read and the write
+    GPO = (GPO & ~registerMask) | bits;
+    interrupts();
+  }
+  lastColour = colour;
+  writeCount++;
+}
+
+/**
+ * @brief Sets a PWM duty, 0 to `LED_PWM_RANGE`, on each channel.
+ *
+ * @note Only channels whose duty changed are written; skipped if none did.
+ */
+void LedOutput::writeDuty(uint16_t red, uint16_t green, uint16_t blue) {
+  const uint16_t duty[3] = {red, green, blue};
+  bool changed = false;
+  for (uint8_t led = 0; led < 3; led++) {
+    if (mode != Pwm || duty[led] != lastDuty[led]) {
+      analogWrite(pins[led], duty[led]);
+      lastDuty[led] = duty[led];
+      changed = true;
+    }
+  }
+  mode = Pwm;
+  if (changed) {
+    writeCount++;
+  } else {
+    skipCount++;
+  }
+}
+
+/**
+ * @brief Number of writes made to the LEDs.
+ */
+uint32_t LedOutput::writes() {
+  return writeCount;
+}
+
+/**
+ * @brief Number of writes skipped because the LEDs already showed the colour.
+ */
+uint32_t LedOutput::skips() {
+  return skipCount;
+}
+
+/**
+ * @brief Prints the write and skip counts.
+ */
+void LedOutput::report(Print& out) {
+  out.print("LEDs: writes ");
+  out.print(writeCount);
+  out.print(", skipped ");
+  out.println(skipCount);
+}
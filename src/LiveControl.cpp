@@ -0,0 +1,155 @@
+#include "LiveControl.h"
+
+LiveControl::LiveControl(TimelineManager& manager, ColourPatterns& patterns, LoopScheduler& scheduler)
+    : manager(manager), patterns(patterns), scheduler(scheduler), socket(LIVE_CONTROL_PATH) {
+  socket.onEvent([this](AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg,
+                        uint8_t* data, size_t length) {
+    (void)server;
+    onEvent(client, type, arg, data, length);
+  });
+}
+
+/**
+ * @brief The WebSocket handler, for LocalApi::addHandler().
+ */
+AsyncWebHandler* LiveControl::handler() {
+  return &socket;
+}
+
+/**
+ * @brief Carries out a waiting switch, then a waiting seek, and closes controllers beyond
+ *        `LIVE_MAX_CLIENTS`. Call once per `loop()`, before playback.
+ *
+ * @return `true` once a switch has loaded its timeline; its number is `switchedNumber()`.
+ *
+ * @note A seek only moves playback; the playback that follows in the same `loop()` pass
+ *       shows the event at the new point.
+ */
+bool LiveControl::update() {
+  socket.cleanupClients(LIVE_MAX_CLIENTS);
+  bool loaded = false;
+  if (switchWaiting) {
+    switchWaiting = false;
+    loaded = manager.hasTimeline(switchNumber) && manager.loadTimeline(switchNumber);
+    answer(switchClient, Switch, switchSequence, loaded ? Ok : NoTimeline);
+  }
+  if (seekWaiting) {
+    seekWaiting = false;
+    bool playing = manager.alreadyGotData();
+    if (playing) {
+      manager.playFrom(seekTo);
+    }
+    answer(seekClient, Seek, seekSequence, playing ? Ok : NoTimeline);
+  }
+  return loaded;
+}
+
+/**
+ * @brief The number of the timeline the last switch loaded.
+ */
+const char* LiveControl::switchedNumber() {
+  return switchNumber;
+}
+
+/**
+ * @brief WebSocket events: runs every whole binary frame as a command.
+ */
+void LiveControl::onEvent(AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t length) {
+  if (type == WS_EVT_CONNECT) {
+    Serial.print("Live control connected, client ");
+    Serial.println(client->id());
+    return;
+  }
+  if (type != WS_EVT_DATA) {
+    return;
+  }
+  AwsFrameInfo* info = (AwsFrameInfo*)arg;
+  if (!info->final || info->index != 0 || info->len != length || info->opcode != WS_BINARY || length < 2) {
+    reply(client, length > 0 ? data[0] : 0, length > 1 ? data[1] : 0, BadFrame); // commands fit one frame
+    return;
+  }
+  if (data[0] == Echo) {
+    data[0] = 0x80;
+    client->binary(data, length);
+    return;
+  }
+  Result result = run(client, data, length);
+  if ((data[0] != Switch && data[0] != Seek) || result != Ok) {
+    reply(client, data[0], data[1], result);
+  }
+}
+
+/**
+ * @brief Carries out one command frame.
+ *
+ * @return The result to answer with. A switch or seek that returns `Ok` is queued, and
+ *         answered by `update()`.
+ */
+LiveControl::Result LiveControl::run(AsyncWebSocketClient* client, const uint8_t* frame, size_t length) {
+  uint32_t argument = 0;
+  if (length >= 6) {
+    argument = frame[2] | (uint32_t)frame[3] << 8 | (uint32_t)frame[4] << 16 | (uint32_t)frame[5] << 24;
+  }
+  switch (frame[0]) {
+    case Pattern:
+      if (length < 3) {
+        return BadFrame;
+      }
+      manager.setSignal(frame[2]); // so loop() keeps showing it
+      patterns.changeColours(frame[2]);
+      return Ok;
+    case Switch:
+      if (length < 6 || argument > 9999999) {
+        return BadFrame;
+      }
+      if (switchWaiting) {
+        return Busy;
+      }
+      snprintf(switchNumber, sizeof(switchNumber), "%u", argument);
+      switchClient = client->id();
+      switchSequence = frame[1];
+      switchWaiting = true;
+      scheduler.wake();
+      return Ok;
+    case Play:
+    case Stop:
+      if (!manager.alreadyGotData()) {
+        return NoTimeline;
+      }
+      manager.setPlaying(frame[0] == Play);
+      return Ok;
+    case Seek:
+      if (length < 6) {
+        return BadFrame;
+      }
+      if (!manager.alreadyGotData()) {
+        return NoTimeline;
+      }
+      if (seekWaiting) {
+        return Busy;
+      }
+      seekTo = argument;
+      seekClient = client->id();
+      seekSequence = frame[1];
+      seekWaiting = true;
+      scheduler.wake();
+      return Ok;
+    default:
+      return BadFrame;
+  }
+}
+
+/**
+ * @brief Answers a queued command, if its client is still connected.
+ */
+void LiveControl::answer(uint32_t clientId, uint8_t command, uint8_t sequence, Result result) {
+  AsyncWebSocketClient* client = socket.client(clientId);
+  if (client != nullptr) {
+    reply(client, command, sequence, result);
+  }
+}
+
+void LiveControl::reply(AsyncWebSocketClient* client, uint8_t command, uint8_t sequence, Result result) {
+  uint8_t frame[3] = {(uint8_t)(command | 0x80), sequence, result};
+  client->binary(frame, sizeof(frame));
+}
@@ -0,0 +1,158 @@
+#include "LocalApi.h"
+#include "TextBuffer.h"
+
+LocalApi::LocalApi(TimelineManager& manager, TimelineSync& sync) : manager(manager), sync(sync), server(LOCAL_API_PORT) {
+}
+
+/**
+ * @brief Serves another handler on the same server, e.g. LiveControl's WebSocket.
+ */
+void LocalApi::addHandler(AsyncWebHandler* handler) {
+  server.addHandler(handler);
+}
+
+/**
+ * @brief Starts the server, once; call when Wi-Fi is connected.
+ */
+void LocalApi::begin() {
+  if (isStarted) {
+    return;
+  }
+  server.on("/api/timeline", HTTP_POST,
+            [this](AsyncWebServerRequest* request) { finishUpload(request); },
+            nullptr,
+            [this](AsyncWebServerRequest* request, uint8_t* data, size_t length, size_t index, size_t total) {
+              receiveTimeline(request, data, length, index, total);
+            });
+  server.on("/api/status", HTTP_GET, [this](AsyncWebServerRequest* request) { sendStatus(request); });
+  server.onNotFound([](AsyncWebServerRequest* request) { request->send(404, "text/plain", "Not found"); });
+  server.begin();
+  isStarted = true;
+  Serial.print("Local API on port ");
+  Serial.println(LOCAL_API_PORT);
+}
+
+/**
+ * @brief Returns `true` once `begin()` has started the server.
+ */
+bool LocalApi::started() {
+  return isStarted;
+}
+
+/**
+ * @brief Compiles an uploaded timeline a slice at a time, and installs it once it is done.
+ *        Call once per `loop()`.
+ *
+ * @return `true` once, when an uploaded timeline asked with `play=1` is ready to be
+ *         activated; its number is `uploadedNumber()`.
+ */
+bool LocalApi::update() {
+  if (!busy()) {
+    return false;
+  }
+  if (upload.step() != TimelineUpload::Done) {
+    return false;
+  }
+  manager.installTimeline(upload.number());
+  manager.timelineCatalog().remove(upload.number()); // not the server's version
+  manager.timelineCatalog().save();
+  return playAfterUpload;
+}
+
+/**
+ * @brief Returns `true` from the first piece of an upload until it is installed, so no
+ *        TimelineSync should start.
+ */
+bool LocalApi::busy() {
+  TimelineUpload::Status status = upload.status();
+  return status == TimelineUpload::Receiving || compiling();
+}
+
+/**
+ * @brief Returns `true` while an uploaded timeline is waiting to be compiled, so `loop()`
+ *        should not sleep.
+ */
+bool LocalApi::compiling() {
+  TimelineUpload::Status status = upload.status();
+  return status == TimelineUpload::Received || status == TimelineUpload::Sorting
+         || status == TimelineUpload::Compiling;
+}
+
+/**
+ * @brief The number of the last uploaded timeline.
+ */
+const char* LocalApi::uploadedNumber() {
+  return upload.number();
+}
+
+/**
+ * @brief Body callback of `POST /api/timeline`: starts the upload on the first piece and
+ *        passes every piece to it as it arrives.
+ */
+void LocalApi::receiveTimeline(AsyncWebServerRequest* request, uint8_t* data, size_t length, size_t index, size_t total) {
+  if (index == 0) {
+    AsyncWebParameter* number = request->getParam("number");
+    if (busy() || sync.busy() || number == nullptr || !validNumber(number->value().c_str())) {
+      return; // refused in finishUpload()
+    }
+    uploader = upload.begin(number->value().c_str()) ? request : nullptr;
+    playAfterUpload = request->hasParam("play");
+  }
+  if (request != uploader) {
+    return;
+  }
+  upload.write(data, length);
+  if (index + length >= total) {
+    upload.end();
+  }
+}
+
+/**
+ * @brief Request callback of `POST /api/timeline`, called once the whole body has arrived.
+ */
+void LocalApi::finishUpload(AsyncWebServerRequest* request) {
+  if (request != uploader) {
+    AsyncWebParameter* number = request->getParam("number");
+    if (number == nullptr || !validNumber(number->value().c_str())) {
+      request->send(400, "text/plain", "Add ?number=N, N of 1 to 7 digits");
+    } else if (sync.busy()) {
+      request->send(503, "text/plain", "Sync running, try again shortly");
+    } else if (busy()) {
+      request->send(409, "text/plain", "Another upload is in progress");
+    } else if (request->contentLength() == 0) {
+      request->send(400, "text/plain", "No timeline in the body");
+    } else {
+      request->send(500, "text/plain", "Timeline could not be saved");
+    }
+    return;
+  }
+  uploader = nullptr;
+  if (upload.status() != TimelineUpload::Received) {
+    request->send(400, "text/plain", "Timeline JSON invalid or incomplete, not saved");
+    return;
+  }
+  char reply[64];
+  TextBuffer text(reply, sizeof(reply));
+  text.format("{\"number\": \"%s\", \"received\": %u}", upload.number(), upload.received());
+  request->send(202, "application/json", reply);
+}
+
+/**
+ * @brief `GET /api/status`: where the last upload has got to.
+ */
+void LocalApi::sendStatus(AsyncWebServerRequest* request) {
+  static const char* names[] = {"none", "receiving", "received", "sorting", "compiling", "done", "failed"};
+  char reply[128];
+  TextBuffer text(reply, sizeof(reply));
+  text.format("{\"upload\": \"%s\", \"number\": \"%s\", \"received\": %u, \"compiled\": %u, \"ms\": %lu}",
+              names[upload.status()], upload.number(), upload.received(), upload.compiled(), upload.duration());
+  request->send(200, "application/json", reply);
+}
+
+/**
+ * @brief Returns `true` for 1 to 7 digits, so the number is safe to put in a file path.
+ */
+bool LocalApi::validNumber(const char* number) {
+  size_t length = strlen(number);
+  return length > 0 && length < 8 && strspn(number, "0123456789") == length;
+}
@@ -0,0 +1,126 @@
+#include "LoopScheduler.h"
+
+#include <coredecls.h>
+
+/**
+ * @brief Asks for the next `loop()` pass to run by `deadline`, in `millis()`.
+ *
+ * @note The earliest deadline asked for during a pass wins. A deadline already past makes
+ *       the next pass run straight away.
+ */
+void LoopScheduler::wakeBy(unsigned long deadline) {
+  if (!wakeSet || (long)(deadline - wakeAt) < 0) {
+    wakeAt = deadline;
+    wakeSet = true;
+  }
+}
+
+/**
+ * @brief Asks for the next `loop()` pass to run within `wait` ms; 0 for straight away.
+ */
+void LoopScheduler::wakeIn(unsigned long wait) {
+  if (wait < LOOP_MAX_SLEEP) {
+    wakeBy(millis() + wait);
+  }
+}
+
+/**
+ * @brief Ends the current sleep now, or makes the next one only yield.
+ *
+ * @note Safe to call from network callbacks, e.g. when a WebSocket command has been queued
+ *       for `loop()`: the sleep is an `esp_delay()`, which `esp_schedule()` resumes.
+ */
+void LoopScheduler::wake() {
+  woken = true;
+  esp_schedule();
+}
+
+/**
+ * @brief Sleeps until the earliest deadline asked for since the last call, or for
+ *        `LOOP_MAX_SLEEP` if none was, then forgets the deadlines.
+ *
+ * @note Call once, at the end of `loop()`. When something is already due, or `wake()` has
+ *       been called since the last sleep, it only yields, so the Wi-Fi stack still gets
+ *       its time.
+ */
+void LoopScheduler::sleep() {
+  unsigned long now = millis();
+  long wait = LOOP_MAX_SLEEP;
+  if (wakeSet && (long)(wakeAt - now) < wait) {
+    wait = (long)(wakeAt - now);
+  }
+  wakeSet = false;
+  passes++;
+
+  if (wait <= 0 || woken) {
+    woken = false;
+    yield();
+    return;
+  }
+  esp_delay(wait, [this]() { return !woken; }); // delay(), ended early by wake()
+  woken = false;
+  sleeps++;
+  sleptMs += millis() - now;
+}
+
+/**
+ * @brief Switches the Wi-Fi modem off, for playback from flash with no network.
+ *
+ * @note The caller stops the clock sync and SNTP with it, as `loop()` does. `radioOn()`
+ *       brings the modem back; the caller then reconnects, and starts them again once
+ *       connected.
+ */
+void LoopScheduler::radioOff() {
+  if (radioAsleep) {
+    return;
+  }
+  WiFi.mode(WIFI_OFF);
+  WiFi.forceSleepBegin();
+  radioAsleep = true;
+  Serial.println("Wi-Fi modem off for offline playback.");
+}
+
+/**
+ * @brief Wakes the Wi-Fi modem switched off by `radioOff()` and puts it back in station mode.
+ */
+void LoopScheduler::radioOn() {
+  if (!radioAsleep) {
+    return;
+  }
+  WiFi.forceSleepWake();
+  delay(1);
+  WiFi.mode(WIFI_STA);
+  radioAsleep = false;
+  Serial.println("Wi-Fi modem on.");
+}
+
+/**
+ * @brief Returns `true` while the modem is switched off by `radioOff()`.
+ */
+bool LoopScheduler::radioSleeping() {
+  return radioAsleep;
+}
+
+/**
+ * @brief Prints how much of the time since the last report `loop()` spent asleep, then
+ *        starts counting afresh.
+ */
+void LoopScheduler::report(Print& out) {
+  unsigned long now = millis();
+  unsigned long span = now - reportStart;
+  out.print("Loop: passes ");
+  out.print(passes);
+  out.print(", slept ");
+  out.print(sleeps);
+  out.print(" times for ms ");
+  out.print(sleptMs);
+  out.print(" of ");
+  out.print(span);
+  out.print(" (");
+  out.print(span > 0 ? (uint32_t)((uint64_t)sleptMs * 100 / span) : 0);
+  out.println("%)");
+  passes = 0;
+  sleeps = 0;
+  sleptMs = 0;
+  reportStart = now;
+}
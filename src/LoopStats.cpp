@@ -0,0 +1,75 @@
+#include "LoopStats.h"
+
+LoopStats loopStats;
+
+/**
+ * @brief Call at the start of every `loop()` pass; counts the time since the last one.
+ */
+void LoopStats::loopStarted() {
+  uint32_t now = micros();
+  if (looping) {
+    loopPeriod.add(now - lastLoopStart);
+  }
+  lastLoopStart = now;
+  looping = true;
+}
+
+/**
+ * @brief The cycle counter, to pass to `endPlayback()`.
+ */
+uint32_t LoopStats::startTiming() {
+  return ESP.getCycleCount();
+}
+
+/**
+ * @brief Counts the time since `startTiming()` as one pass of the playback branch.
+ */
+void LoopStats::endPlayback(uint32_t started) {
+  playback.add((uint64_t)(ESP.getCycleCount() - started) * 1000 / ESP.getCpuFreqMHz());
+}
+
+/**
+ * @brief Samples the free heap and the largest free block, at most every
+ *        `STATS_HEAP_INTERVAL` ms.
+ */
+void LoopStats::sampleHeap() {
+  unsigned long now = millis();
+  if (heapSampled && now - lastHeapSample < STATS_HEAP_INTERVAL) {
+    return;
+  }
+  freeHeap.add(ESP.getFreeHeap());
+  maxBlock.add(ESP.getMaxFreeBlockSize());
+  lastHeapSample = now;
+  heapSampled = true;
+}
+
+/**
+ * @brief Empties every histogram, e.g. at the start of a show.
+ */
+void LoopStats::clear() {
+  loopPeriod.clear();
+  playback.clear();
+  lateness.clear();
+  http.clear();
+  flash.clear();
+  freeHeap.clear();
+  maxBlock.clear();
+  looping = false;
+  heapSampled = false;
+  since = millis();
+}
+
+/**
+ * @brief Prints every histogram, one per line.
+ */
+void LoopStats::report(Print& out) {
+  out.print("Stats over ms: ");
+  out.println(millis() - since);
+  loopPeriod.report(out, "  loop period", "us");
+  playback.report(out, "  playback", "ns");
+  lateness.report(out, "  event lateness", "ms");
+  http.report(out, "  HTTP request", "us");
+  flash.report(out, "  flash I/O", "us");
+  freeHeap.report(out, "  free heap", "bytes");
+  maxBlock.report(out, "  max free block", "bytes");
+}
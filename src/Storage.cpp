@@ -0,0 +1,153 @@
+#include "Storage.h"
+#include "LoopStats.h"
+
+Storage storage;
+
+/**
+ * @brief Mounts the filesystem, unless it is already mounted.
+ *
+ * Called from `setup()`; the other methods also call it, so the first file access mounts
+ * the filesystem if `setup()` has not.
+ *
+ * @return `true` if the filesystem is mounted.
+ */
+bool Storage::begin() {
+  if (isMounted) {
+    return true;
+  }
+  unsigned long started = micros();
+  isMounted = LittleFS.begin();
+  counters.mounts++;
+  counters.mountUs += micros() - started;
+  if (!isMounted) {
+    Serial.println("LittleFS mount failed.");
+  }
+  return isMounted;
+}
+
+/**
+ * @brief Returns `true` once the filesystem has been mounted.
+ */
+bool Storage::mounted() {
+  return isMounted;
+}
+
+/**
+ * @brief Opens a file.
+ *
+ * @param path The file path.
+ * @param mode "r", "w", "a" or "r+" as for `LittleFS.open()`.
+ *
+ * @return The file, which is false if it could not be opened.
+ */
+File Storage::open(const char* path, const char* mode) {
+  if (!begin()) {
+    return File();
+  }
+  unsigned long started = micros();
+  File file = LittleFS.open(path, mode);
+  uint32_t took = micros() - started;
+  counters.opens++;
+  counters.openUs += took;
+  loopStats.flash.add(took);
+  return file;
+}
+
+/**
+ * @brief Returns `true` if the file exists.
+ */
+bool Storage::exists(const char* path) {
+  return begin() && LittleFS.exists(path);
+}
+
+/**
+ * @brief Deletes a file.
+ *
+ * @return `false` if it did not exist or could not be deleted.
+ */
+bool Storage::remove(const char* path) {
+  return begin() && LittleFS.remove(path);
+}
+
+/**
+ * @brief Renames a file, replacing any file already at `to`.
+ */
+bool Storage::rename(const char* from, const char* to) {
+  return begin() && LittleFS.rename(from, to);
+}
+
+/**
+ * @brief Reads from a file, counting the time taken.
+ *
+ * @return The number of bytes read.
+ */
+size_t Storage::read(File& file, uint8_t* buffer, size_t length) {
+  unsigned long started = micros();
+  int count = file.read(buffer, length);
+  uint32_t took = micros() - started;
+  counters.reads++;
+  counters.readUs += took;
+  loopStats.flash.add(took);
+  if (count <= 0) {
+    return 0;
+  }
+  counters.readBytes += count;
+  return count;
+}
+
+/**
+ * @brief Writes to a file, counting the time taken.
+ *
+ * @return The number of bytes written.
+ */
+size_t Storage::write(File& file, const uint8_t* data, size_t length) {
+  unsigned long started = micros();
+  size_t count = file.write(data, length);
+  uint32_t took = micros() - started;
+  counters.writes++;
+  counters.writeBytes += count;
+  counters.writeUs += took;
+  loopStats.flash.add(took);
+  return count;
+}
+
+/**
+ * @brief Writes a string (without its terminator) to a file.
+ */
+size_t Storage::write(File& file, const char* text) {
+  return write(file, (const uint8_t*)text, strlen(text));
+}
+
+/**
+ * @brief The flash I/O counters since boot.
+ */
+const StorageStats& Storage::stats() {
+  return counters;
+}
+
+/**
+ * @brief Prints the flash I/O counters, e.g. to `Serial`.
+ */
+void Storage::report(Print& out) {
+  out.print("Flash: mounts ");
+  out.print(counters.mounts);
+  out.print(" (us ");
+  out.print(counters.mountUs);
+  out.print("), opens ");
+  out.print(counters.opens);
+  out.print(" (us ");
+  out.print(counters.openUs);
+  out.print("), reads ");
+  out.print(counters.reads);
+  out.print(" / bytes ");
+  out.print(counters.readBytes);
+  out.print(" (us ");
+  out.print(counters.readUs);
+  out.print("), writes ");
+  out.print(counters.writes);
+  out.print(" / bytes ");
+  out.print(counters.writeBytes);
+  out.print(" (us ");
+  out.print(counters.writeUs);
+  out.println(")");
+}
@@ -0,0 +1,102 @@
+#include "TextBuffer.h"
+#include <stdarg.h>
+
+/**
+ * @brief Starts an empty text in `buffer`.
+ *
+ * @param buffer The array to build the text in. It must outlive the TextBuffer.
+ * @param size Its size in bytes, including the terminator.
+ */
+TextBuffer::TextBuffer(char* buffer, size_t size) : buffer(buffer), size(size) {
+  clear();
+}
+
+/**
+ * @brief Appends one character.
+ *
+ * @return 1, or 0 if the buffer is full.
+ */
+size_t TextBuffer::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+/**
+ * @brief Appends as much of `data` as fits.
+ *
+ * @return The number of bytes appended.
+ */
+size_t TextBuffer::write(const uint8_t* data, size_t length) {
+  if (size == 0) {
+    overflow = overflow || length > 0;
+    return 0;
+  }
+  size_t space = size - 1 - used;
+  if (length > space) {
+    length = space;
+    overflow = true;
+  }
+  memcpy(buffer + used, data, length);
+  used += length;
+  buffer[used] = '\0';
+  return length;
+}
+
+/**
+ * @brief Appends printf-style, straight into the buffer.
+ *
+ * @return `false` if the text did not fit (see `overflowed()`).
+ *
+ * @note Unlike `Print::printf()`, which formats long output on the heap.
+ */
+bool TextBuffer::format(const char* format, ...) {
+  if (size == 0) {
+    overflow = true;
+    return false;
+  }
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer + used, size - used, format, args);
+  va_end(args);
+  if (length < 0) {
+    buffer[used] = '\0';
+    overflow = true;
+  } else if ((size_t)length >= size - used) {
+    used = size - 1; // vsnprintf() kept what fits
+    overflow = true;
+  } else {
+    used += length;
+  }
+  return !overflow;
+}
+
+/**
+ * @brief Empties the text and clears `overflowed()`.
+ */
+void TextBuffer::clear() {
+  used = 0;
+  overflow = false;
+  if (size > 0) {
+    buffer[0] = '\0';
+  }
+}
+
+/**
+ * @brief The text so far, terminated.
+ */
+const char* TextBuffer::c_str() {
+  return buffer;
+}
+
+/**
+ * @brief Length of the text so far, without the terminator.
+ */
+size_t TextBuffer::length() {
+  return used;
+}
+
+/**
+ * @brief Returns `true` if anything has been cut off since the last `clear()`.
+ */
+bool TextBuffer::overflowed() {
+  return overflow;
+}
@@ -0,0 +1,168 @@
+#include "TimelineBenchmark.h"
+
+static const uint16_t benchSizes[] = {10, 100, 1000, 10000};
+
+TimelineBenchmark::TimelineBenchmark(TimelineManager& manager, ColourPatterns& patterns)
+    : manager(manager), patterns(patterns) {
+}
+
+/**
+ * @brief Runs every timeline size and prints the results, then removes the benchmark's
+ *        timeline.
+ */
+void TimelineBenchmark::run(Print& out) {
+  out.println("Benchmark: parse, compile, activate and play synthetic timelines");
+  for (uint16_t events : benchSizes) {
+    if (!runOne(events, out)) {
+      out.print("Benchmark failed at events: ");
+      out.println(events);
+      break;
+    }
+  }
+  manager.timelineCache().invalidate(BENCH_TIMELINE);
+  manager.clearTimeline(BENCH_TIMELINE);
+}
+
+/**
+ * @brief Benchmarks one timeline size and prints the results.
+ *
+ * @return `false` if the timeline could not be written or loaded.
+ */
+bool TimelineBenchmark::runOne(uint16_t events, Print& out) {
+  uint32_t heapBefore = ESP.getFreeHeap();
+  lowestFree = heapBefore;
+
+  uint32_t parseUs = 0;
+  uint32_t compileUs = 0;
+  if (!build(events, parseUs, compileUs)) {
+    return false;
+  }
+  manager.setAlreadyGotData(false); // the last size's file is no longer playing, so it is replaced
+  manager.installTimeline(BENCH_TIMELINE);
+
+  uint32_t started = ESP.getCycleCount();
+  bool loaded = manager.loadTimeline(BENCH_TIMELINE);
+  uint32_t activateUs = cyclesToMicros(ESP.getCycleCount() - started);
+  sampleHeap();
+  started = ESP.getCycleCount();
+  loaded = loaded && manager.loadTimeline(BENCH_TIMELINE);
+  uint32_t reactivateUs = cyclesToMicros(ESP.getCycleCount() - started);
+  sampleHeap();
+  if (!loaded) {
+    return false;
+  }
+
+  Histogram idleTicks;
+  Histogram eventTicks;
+  play(idleTicks, eventTicks);
+  uint32_t heapAfter = ESP.getFreeHeap();
+
+  out.print("Benchmark events ");
+  out.print(events);
+  out.print(": parse us ");
+  out.print(parseUs);
+  out.print(", compile us ");
+  out.print(compileUs);
+  out.print(", activate us ");
+  out.print(activateUs);
+  out.print(" then ");
+  out.print(reactivateUs);
+  out.print(", heap peak ");
+  out.print(heapBefore - lowestFree);
+  out.print(" held ");
+  out.print((int32_t)(heapBefore - heapAfter));
+  out.println(" bytes");
+  idleTicks.report(out, "  idle ticks", "ns");
+  eventTicks.report(out, "  event ticks", "ns");
+  return true;
+}
+
+/**
+ * @brief Makes up a timeline of `events` events and streams it through the parser into the
+ *        compiler, as a download does, leaving `/timeline99.new`.
+ *
+ * The JSON is generated a block at a time, so it is never held in RAM whole. Timings and
+ * patterns come from a fixed pseudo-random sequence, the same on every run.
+ */
+bool TimelineBenchmark::build(uint16_t events, uint32_t& parseUs, uint32_t& compileUs) {
+  TimelineCompiler compiler;
+  TimelineParser parser(compiler);
+  if (!storage.begin() || !compiler.begin(BENCH_TIMELINE)) {
+    return false;
+  }
+
+  uint32_t parseCycles = 0;
+  uint32_t seed = events;
+  uint32_t timing = 0;
+  char block[BENCH_BLOCK + 24];
+  size_t length = 1;
+  block[0] = '{';
+  for (uint16_t i = 0; i < events; i++) {
+    seed = seed * 1664525 + 1013904223; // Numerical Recipes LCG
+    timing += 1 + (seed >> 16) % (2 * BENCH_EVENT_GAP);
+    length += snprintf(block + length, sizeof(block) - length, "%s\"%lu\":[%u,0,0]",
+                       i > 0 ? "," : "", (unsigned long)timing, (unsigned)((seed >> 8) % 14));
+    if (i == events - 1) {
+      block[length++] = '}';
+    }
+    if (length >= BENCH_BLOCK || i == events - 1) {
+      uint32_t started = ESP.getCycleCount();
+      parser.write((const uint8_t*)block, length);
+      parseCycles += ESP.getCycleCount() - started;
+      sampleHeap();
+      length = 0;
+    }
+  }
+  parseUs = cyclesToMicros(parseCycles);
+  if (!parser.done()) {
+    compiler.abort();
+    return false;
+  }
+
+  uint32_t started = ESP.getCycleCount();
+  bool compiled = compiler.compile();
+  compileUs = cyclesToMicros(ESP.getCycleCount() - started);
+  sampleHeap();
+  return compiled;
+}
+
+/**
+ * @brief Plays the loaded timeline for `BENCH_PLAY_MS`, timing every tick in ns.
+ */
+void TimelineBenchmark::play(Histogram& idleTicks, Histogram& eventTicks) {
+  uint32_t mhz = ESP.getCpuFreqMHz();
+  manager.setPlaying(true);
+  uint8_t previous = manager.checkTimelineData();
+  unsigned long started = millis();
+  while (millis() - started < BENCH_PLAY_MS) {
+    uint32_t cycles = ESP.getCycleCount();
+    uint8_t signal = manager.checkTimelineData();
+    patterns.changeColours(signal);
+    uint32_t ns = (uint64_t)(ESP.getCycleCount() - cycles) * 1000 / mhz;
+    if (signal != previous) {
+      eventTicks.add(ns);
+      previous = signal;
+    } else {
+      idleTicks.add(ns);
+    }
+    if ((idleTicks.count() & 0x3FF) == 0) {
+      sampleHeap();
+    }
+    yield();
+  }
+}
+
+void TimelineBenchmark::sampleHeap() {
+  uint32_t free = ESP.getFreeHeap();
+  if (free < lowestFree) {
+    lowestFree = free;
+  }
+}
+
+/**
+ * @brief Cycles to microseconds. The cycle counter wraps after 53 s at 80 MHz, far longer
+ *        than any one stage takes.
+ */
+uint32_t TimelineBenchmark::cyclesToMicros(uint32_t cycles) {
+  return cycles / ESP.getCpuFreqMHz();
+}
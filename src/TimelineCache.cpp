@@ -0,0 +1,248 @@
+#include "TimelineCache.h"
+
+/**
+ * @brief Frees every cached timeline.
+ */
+TimelineCache::~TimelineCache() {
+  for (Entry& entry : entries) {
+    if (entry.data != nullptr) {
+      release(entry);
+    }
+  }
+}
+
+/**
+ * @brief Returns the in-RAM copy of a timeline, reading it from flash on a miss.
+ *
+ * The returned copy is pinned until the next successful call, and only then is the
+ * previously returned one unpinned, so the caller must switch playback to the new copy
+ * straight away. If this returns `nullptr` the playing copy stays pinned and valid; call
+ * `unpin()` once playback has moved to flash instead.
+ *
+ * @param timelineNumber The number of the timeline as text.
+ * @param size Set to the size of the returned copy.
+ *
+ * @return The timeline file contents, or `nullptr` if the file is missing, invalid or does
+ *         not fit in `TIMELINE_CACHE_BUDGET` alongside the playing copy.
+ */
+const uint8_t* TimelineCache::acquire(const char* timelineNumber, size_t& size) {
+  Entry* entry = find(timelineNumber);
+  if (entry != nullptr) {
+    hitCount++;
+  } else {
+    missCount++;
+    entry = load(timelineNumber);
+    if (entry == nullptr) {
+      return nullptr;
+    }
+  }
+  unpin();
+  entry->pinned = true;
+  entry->lastUsed = ++clock;
+  size = entry->size;
+  return entry->data;
+}
+
+/**
+ * @brief Drops the cached copy of a timeline after its file has been replaced.
+ *
+ * @param timelineNumber The number of the timeline as text.
+ *
+ * @note A copy that is playing stays valid until another timeline is acquired.
+ */
+void TimelineCache::invalidate(const char* timelineNumber) {
+  Entry* entry = find(timelineNumber);
+  if (entry == nullptr) {
+    return;
+  }
+  if (entry->pinned) {
+    entry->stale = true;
+  } else {
+    release(*entry);
+  }
+}
+
+/**
+ * @brief Number of `acquire()` calls served from RAM.
+ */
+uint32_t TimelineCache::hits() {
+  return hitCount;
+}
+
+/**
+ * @brief Number of `acquire()` calls that had to go to flash.
+ */
+uint32_t TimelineCache::misses() {
+  return missCount;
+}
+
+/**
+ * @brief Number of timelines dropped to make room for another.
+ */
+uint32_t TimelineCache::evictions() {
+  return evictionCount;
+}
+
+/**
+ * @brief Bytes of RAM currently used by cached timelines.
+ */
+size_t TimelineCache::used() {
+  return bytesUsed;
+}
+
+/**
+ * @brief Finds the current (not stale) copy of a timeline.
+ */
+TimelineCache::Entry* TimelineCache::find(const char* timelineNumber) {
+  for (Entry& entry : entries) {
+    if (entry.data != nullptr && !entry.stale && strcmp(entry.number, timelineNumber) == 0) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Reads a timeline file into RAM and checks its CRC.
+ *
+ * @return The new entry, or `nullptr` if the file could not be cached.
+ */
+TimelineCache::Entry* TimelineCache::load(const char* timelineNumber) {
+  char path[32];
+  formatTimelinePath(path, sizeof(path), timelineNumber);
+  if (strlen(timelineNumber) >= sizeof(entries[0].number) || !storage.begin() || !storage.exists(path)) {
+    return nullptr;
+  }
+  File file = storage.open(path, "r");
+  if (!file) {
+    return nullptr;
+  }
+  size_t size = file.size();
+  if (size == 0 || size > TIMELINE_CACHE_BUDGET) {
+    file.close();
+    return nullptr;
+  }
+
+  // Allocate before evicting anything. Evict only if the heap is short, and only if
+  // freeing every unpinned copy would leave enough free heap in total for this one.
+  uint8_t* data = (uint8_t*)malloc(size);
+  if (data == nullptr && ESP.getFreeHeap() + (bytesUsed - pinnedBytes()) >= size) {
+    while (data == nullptr && evictOldest()) {
+      data = (uint8_t*)malloc(size);
+    }
+  }
+  bool ok = data != nullptr && storage.read(file, data, size) == size;
+  file.close();
+
+  TimelineReader reader;
+  ok = ok && reader.open(data, size) && reader.verify();
+  reader.close();
+  if (!ok || !makeRoom(size)) {
+    free(data);
+    return nullptr;
+  }
+
+  Entry* entry = nullptr;
+  for (Entry& candidate : entries) {
+    if (candidate.data == nullptr) {
+      entry = &candidate;
+      break;
+    }
+  }
+  strcpy(entry->number, timelineNumber);
+  entry->data = data;
+  entry->size = size;
+  entry->pinned = false;
+  entry->stale = false;
+  bytesUsed += size;
+  return entry;
+}
+
+/**
+ * @brief Evicts least-recently-used timelines until `size` bytes and a slot are free.
+ *
+ * @return `false`, having evicted nothing, if pinned entries leave too little room.
+ */
+bool TimelineCache::makeRoom(size_t size) {
+  uint8_t pinnedCount = 0;
+  for (Entry& entry : entries) {
+    if (entry.data != nullptr && entry.pinned) {
+      pinnedCount++;
+    }
+  }
+  if (pinnedCount >= TIMELINE_CACHE_SLOTS || pinnedBytes() + size > TIMELINE_CACHE_BUDGET) {
+    return false;
+  }
+  while (true) {
+    bool freeSlot = false;
+    for (Entry& entry : entries) {
+      if (entry.data == nullptr) {
+        freeSlot = true;
+      }
+    }
+    if (freeSlot && bytesUsed + size <= TIMELINE_CACHE_BUDGET) {
+      return true;
+    }
+    evictOldest();
+  }
+}
+
+/**
+ * @brief Frees the least recently used entry that is not pinned.
+ *
+ * @return `false` if every entry is empty or pinned.
+ */
+bool TimelineCache::evictOldest() {
+  Entry* oldest = nullptr;
+  for (Entry& entry : entries) {
+    if (entry.data != nullptr && !entry.pinned && (oldest == nullptr || entry.lastUsed < oldest->lastUsed)) {
+      oldest = &entry;
+    }
+  }
+  if (oldest == nullptr) {
+    return false;
+  }
+  release(*oldest);
+  evictionCount++;
+  return true;
+}
+
+/**
+ * @brief Bytes held by pinned entries, which cannot be evicted.
+ */
+size_t TimelineCache::pinnedBytes() {
+  size_t bytes = 0;
+  for (Entry& entry : entries) {
+    if (entry.data != nullptr && entry.pinned) {
+      bytes += entry.size;
+    }
+  }
+  return bytes;
+}
+
+/**
+ * @brief Frees an entry's copy of the timeline.
+ */
+void TimelineCache::release(Entry& entry) {
+  free(entry.data);
+  bytesUsed -= entry.size;
+  entry.data = nullptr;
+  entry.size = 0;
+  entry.pinned = false;
+  entry.stale = false;
+}
+
+/**
+ * @brief Unpins the playing entry, freeing it if it has gone stale. Call when playback
+ *        moves to a timeline that is not cached.
+ */
+void TimelineCache::unpin() {
+  for (Entry& entry : entries) {
+    if (entry.pinned) {
+      entry.pinned = false;
+      if (entry.stale) {
+        release(entry);
+      }
+    }
+  }
+}
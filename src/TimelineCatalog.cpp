@@ -0,0 +1,233 @@
+#include "TimelineCatalog.h"
+
+/**
+ * @brief Reads the catalog from flash, once.
+ *
+ * @return `true` if the catalog is in RAM. A missing file gives an empty catalog.
+ *
+ * @note The file is read in blocks through `storage`, not a byte per call.
+ */
+bool TimelineCatalog::load() {
+  if (loaded) {
+    return true;
+  }
+  if (!storage.begin()) {
+    return false;
+  }
+  loaded = true;
+  if (!storage.exists(CATALOG_PATH)) {
+    return true;
+  }
+  File file = storage.open(CATALOG_PATH, "r");
+  if (!file) {
+    return true;
+  }
+
+  uint8_t slot = 0;
+  char line[sizeof(Entry::number) + CATALOG_VERSION_SIZE + 22];
+  size_t length = 0;
+  uint8_t chunk[64];
+  size_t chunkLength = 0;
+  size_t chunkPos = 0;
+  while (slot < CATALOG_SLOTS) {
+    if (chunkPos == chunkLength) {
+      chunkLength = storage.read(file, chunk, sizeof(chunk));
+      chunkPos = 0;
+    }
+    int c = chunkPos < chunkLength ? chunk[chunkPos++] : -1;
+    if (c < 0 || c == '\n') {
+      line[length] = '\0';
+      char* version = strchr(line, ' ');
+      char* start = version != nullptr ? strchr(version + 1, ' ') : nullptr;
+      if (start != nullptr) {
+        *start++ = '\0';
+      }
+      if (version != nullptr && version - line < (int)sizeof(Entry::number) && strlen(version + 1) < CATALOG_VERSION_SIZE) {
+        *version++ = '\0';
+        strcpy(entries[slot].number, line);
+        strcpy(entries[slot].version, strcmp(version, "-") == 0 ? "" : version);
+        entries[slot].start = start != nullptr ? strtoull(start, nullptr, 10) : 0;
+        slot++;
+      }
+      length = 0;
+      if (c < 0) {
+        break;
+      }
+    } else if (length < sizeof(line) - 1) {
+      line[length++] = c;
+    }
+  }
+  file.close();
+  return true;
+}
+
+/**
+ * @brief Writes the catalog to flash if it has changed since it was read.
+ *
+ * @return `false` if the file could not be written.
+ */
+bool TimelineCatalog::save() {
+  if (!dirty) {
+    return true;
+  }
+  if (!storage.begin()) {
+    return false;
+  }
+  File file = storage.open(CATALOG_PATH, "w");
+  if (!file) {
+    return false;
+  }
+  char line[sizeof(Entry::number) + CATALOG_VERSION_SIZE + 22];
+  bool ok = true;
+  for (Entry& entry : entries) {
+    if (entry.number[0] != '\0') {
+      int length = snprintf(line, sizeof(line), "%s %s", entry.number, entry.version[0] != '\0' ? entry.version : "-");
+      if (entry.start != 0) {
+        // no 64-bit printf on every core, so the digits are written by hand
+        char digits[21];
+        uint8_t count = 0;
+        for (uint64_t value = entry.start; value > 0; value /= 10) {
+          digits[count++] = '0' + value % 10;
+        }
+        line[length++] = ' ';
+        while (count > 0) {
+          line[length++] = digits[--count];
+        }
+      }
+      line[length++] = '\n';
+      line[length] = '\0';
+      ok = ok && storage.write(file, line) == strlen(line);
+    }
+  }
+  file.close();
+  if (!ok) {
+    return false;
+  }
+  dirty = false;
+  return true;
+}
+
+/**
+ * @brief The stored version of a timeline, or `nullptr` if it is not in the catalog.
+ */
+const char* TimelineCatalog::version(const char* timelineNumber) {
+  Entry* entry = find(timelineNumber);
+  return entry != nullptr ? entry->version : nullptr;
+}
+
+/**
+ * @brief Checks whether the timeline on flash is the given version.
+ *
+ * @return `true` if the catalog has this version and its file (or a download of it waiting
+ *         to be activated) is still there. An empty version never matches.
+ */
+bool TimelineCatalog::upToDate(const char* timelineNumber, const char* version) {
+  const char* stored = this->version(timelineNumber);
+  if (stored == nullptr || version[0] == '\0' || strcmp(stored, version) != 0) {
+    return false;
+  }
+  char path[32];
+  formatTimelinePath(path, sizeof(path), timelineNumber);
+  if (storage.exists(path)) {
+    return true;
+  }
+  formatTimelinePath(path, sizeof(path), timelineNumber, "new");
+  return storage.exists(path);
+}
+
+/**
+ * @brief Records the version of a timeline that has just been downloaded.
+ *
+ * @return `false` if the number or version is too long, or the catalog is full.
+ */
+bool TimelineCatalog::set(const char* timelineNumber, const char* version) {
+  if (strlen(version) >= CATALOG_VERSION_SIZE) {
+    return false;
+  }
+  Entry* entry = add(timelineNumber);
+  if (entry == nullptr) {
+    return false;
+  }
+  if (strcmp(entry->version, version) != 0) {
+    strcpy(entry->version, version);
+    dirty = true;
+  }
+  return true;
+}
+
+/**
+ * @brief The scheduled start of a timeline in Unix time milliseconds, or 0 if it has none.
+ */
+uint64_t TimelineCatalog::start(const char* timelineNumber) {
+  Entry* entry = find(timelineNumber);
+  return entry != nullptr ? entry->start : 0;
+}
+
+/**
+ * @brief Records the scheduled start of a timeline from the manifest.
+ *
+ * @param start Unix time in milliseconds, or 0 to play it as soon as it is loaded.
+ *
+ * @return `false` if the number is too long or the catalog is full.
+ */
+bool TimelineCatalog::setStart(const char* timelineNumber, uint64_t start) {
+  Entry* entry = start != 0 ? add(timelineNumber) : find(timelineNumber);
+  if (entry == nullptr) {
+    return start == 0;
+  }
+  if (entry->start != start) {
+    entry->start = start;
+    dirty = true;
+  }
+  return true;
+}
+
+/**
+ * @brief Forgets a timeline, so that the next sync downloads it again.
+ */
+void TimelineCatalog::remove(const char* timelineNumber) {
+  Entry* entry = find(timelineNumber);
+  if (entry != nullptr) {
+    entry->number[0] = '\0';
+    entry->version[0] = '\0';
+    entry->start = 0;
+    dirty = true;
+  }
+}
+
+/**
+ * @brief Finds the entry for a timeline.
+ */
+TimelineCatalog::Entry* TimelineCatalog::find(const char* timelineNumber) {
+  load();
+  for (Entry& entry : entries) {
+    if (entry.number[0] != '\0' && strcmp(entry.number, timelineNumber) == 0) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Finds the entry for a timeline, adding an empty one if there is none.
+ *
+ * @return `nullptr` if the number is too long or the catalog is full.
+ */
+TimelineCatalog::Entry* TimelineCatalog::add(const char* timelineNumber) {
+  if (strlen(timelineNumber) >= sizeof(Entry::number)) {
+    return nullptr;
+  }
+  Entry* entry = find(timelineNumber);
+  if (entry != nullptr) {
+    return entry;
+  }
+  for (Entry& candidate : entries) {
+    if (candidate.number[0] == '\0') {
+      strcpy(candidate.number, timelineNumber);
+      candidate.version[0] = '\0';
+      candidate.start = 0;
+      return &candidate;
+    }
+  }
+  return nullptr;
+}
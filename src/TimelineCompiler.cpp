@@ -0,0 +1,464 @@
+#include "TimelineCompiler.h"
+
+#include <new>
+
+/**
+ * @brief Starts staging events for a timeline.
+ *
+ * @param timelineNumber The number of the timeline, used to build the file paths.
+ *
+ * @return `true` if the staging file could be created.
+ *
+ * @note Files are opened through `storage`, which mounts the filesystem on first use.
+ */
+bool TimelineCompiler::begin(const char* timelineNumber) {
+  formatTimelinePath(stagingPath, sizeof(stagingPath), timelineNumber, "raw");
+  formatTimelinePath(sortedPath, sizeof(sortedPath), timelineNumber, "srt");
+  formatTimelinePath(outputPath, sizeof(outputPath), timelineNumber, "new");
+  if (sorting()) {
+    endSort(); // a compile that was never finished or aborted
+  }
+  stage = Staging;
+  staged = 0;
+  inOrder = true;
+  lastStagedTiming = 0;
+  compiled = 0;
+  staging = storage.open(stagingPath, "w");
+  return (bool)staging;
+}
+
+/**
+ * @brief Stages one parsed event on flash.
+ *
+ * @param record The event, in whatever order the source provides.
+ *
+ * @return `false` if the event could not be written.
+ */
+bool TimelineCompiler::onEvent(const TimelineRecord& record) {
+  if (!staging || staged == 0xFFFF) {
+    return false;
+  }
+  if (storage.write(staging, (const uint8_t*)&record, sizeof(record)) != sizeof(record)) {
+    return false;
+  }
+  if (staged > 0 && record.timing < lastStagedTiming) {
+    inOrder = false;
+  }
+  lastStagedTiming = record.timing;
+  staged++;
+  return true;
+}
+
+/**
+ * @brief Sorts, deduplicates and merges the staged events and writes the binary timeline.
+ *
+ * Runs `startCompile()`, `sortStep()` and `compileStep()` to completion.
+ *
+ * @return `true` if the binary timeline file was written. The staging file is removed
+ *         either way.
+ *
+ * @note The output is written to `/timelineN.new`, never to the file that may be playing;
+ *       see TimelineManager::installTimeline().
+ */
+bool TimelineCompiler::compile() {
+  if (!startCompile()) {
+    return false;
+  }
+  bool sorted = false;
+  while (sortStep(0xFFFF, sorted) && !sorted) {
+  }
+  if (!sorted) {
+    return false;
+  }
+  bool finished = false;
+  while (compileStep(0xFFFF, finished) && !finished) {
+  }
+  return finished;
+}
+
+/**
+ * @brief Prepares to compile the staged events.
+ *
+ * In-order input (the usual case) is ready to compile at once. Out-of-order input is only
+ * opened for sorting here; `sortStep()` does the sorting.
+ *
+ * @return `false` if there is nothing to compile or the files could not be opened, in
+ *         which case the staging file has been removed.
+ */
+bool TimelineCompiler::startCompile() {
+  if (staging) {
+    staging.close();
+  }
+  haveShown = false;
+  havePending = false;
+  havePrevious = false;
+  previousTiming = 0;
+  compiled = 0;
+
+  bool ok = staged > 0;
+  if (ok && inOrder) {
+    ok = startEncoding();
+  } else if (ok) {
+    Serial.println("Timeline events out of order, sorting.");
+    runBuffer = new (std::nothrow) TimelineRecord[COMPILER_SORT_RUN];
+    sortInput = storage.open(stagingPath, "r+");
+    sortPosition = 0;
+    stage = SortingRuns;
+    ok = runBuffer != nullptr && sortInput;
+  }
+  if (!ok) {
+    finishCompile(false);
+  }
+  return ok;
+}
+
+/**
+ * @brief Does one bounded slice of sorting out-of-order events.
+ *
+ * Sorts one run of `COMPILER_SORT_RUN` events, or reads the heads of up to `maxEvents`
+ * sorted runs, or merges up to `maxEvents` events. Call repeatedly (e.g. once per
+ * `loop()`) until `sorted` is set, then call `compileStep()`.
+ *
+ * @param maxEvents The most runs to start or events to merge in this call.
+ * @param sorted Set to `true` once the events are in order and ready to compile; at once
+ *               if they arrived in order.
+ *
+ * @return `false` if sorting failed; the staging file has been removed.
+ */
+bool TimelineCompiler::sortStep(uint16_t maxEvents, bool& sorted) {
+  sorted = stage == Encoding;
+  if (sorted) {
+    return true;
+  }
+  bool ok;
+  switch (stage) {
+    case SortingRuns:
+      ok = sortRun();
+      break;
+    case LoadingRuns:
+      ok = loadRuns(maxEvents);
+      break;
+    case MergingRuns:
+      ok = mergeRuns(maxEvents);
+      break;
+    default:
+      return false; // startCompile() was not called
+  }
+  if (!ok) {
+    finishCompile(false);
+    return false;
+  }
+  sorted = stage == Encoding;
+  return true;
+}
+
+/**
+ * @brief Returns `true` from `startCompile()` until out-of-order events have been sorted.
+ */
+bool TimelineCompiler::sorting() {
+  return stage == SortingRuns || stage == LoadingRuns || stage == MergingRuns;
+}
+
+/**
+ * @brief Compiles up to `maxEvents` staged events.
+ *
+ * Call repeatedly (e.g. once per `loop()`) until `finished` is set. The length of one pass
+ * is taken from the deduplicated events before colour merging, so dropping a repeated
+ * colour at the end does not shorten the show: the last event is held for as long as the
+ * gap before it (one second if there is only one event).
+ *
+ * @param maxEvents The most staged events to read in this call.
+ * @param finished Set to `true` once the binary timeline file has been written.
+ *
+ * @return `false` if compiling failed; the output and staging files have been removed.
+ */
+bool TimelineCompiler::compileStep(uint16_t maxEvents, bool& finished) {
+  finished = false;
+  if (stage != Encoding) {
+    return false; // startCompile() not called, or sortStep() not finished
+  }
+  bool ok = true;
+  TimelineRecord chunk[8];
+  uint16_t done = 0;
+  while (ok && done < maxEvents) {
+    int length = storage.read(input, (uint8_t*)chunk, sizeof(chunk));
+    if (length <= 0) {
+      finished = true;
+      break;
+    }
+    for (int i = 0; ok && i < length / (int)sizeof(TimelineRecord); i++) {
+      if (havePending && chunk[i].timing == pending.timing) {
+        pending = chunk[i]; // same time: only the last one would ever show
+        continue;
+      }
+      if (havePending) {
+        ok = emit(pending);
+        previousTiming = pending.timing;
+        havePrevious = true;
+      }
+      pending = chunk[i];
+      havePending = true;
+    }
+    done += length / sizeof(TimelineRecord);
+  }
+
+  if (ok && finished) {
+    if (havePending) {
+      ok = emit(pending);
+      uint32_t lastGap = havePrevious ? pending.timing - previousTiming : 1000;
+      writer.setDuration(pending.timing + lastGap);
+    }
+    ok = finishCompile(ok);
+  } else if (!ok) {
+    finishCompile(false);
+  }
+  if (!ok) {
+    finished = false;
+  }
+  return ok;
+}
+
+/**
+ * @brief Discards the staged events, and the partly compiled output if compiling has started.
+ */
+void TimelineCompiler::abort() {
+  if (staging) {
+    staging.close();
+  }
+  if (input || sorting()) {
+    finishCompile(false);
+    return;
+  }
+  storage.remove(stagingPath);
+}
+
+/**
+ * @brief Number of events in the compiled timeline.
+ */
+uint16_t TimelineCompiler::count() {
+  return compiled;
+}
+
+/**
+ * @brief Sorts the next run of `COMPILER_SORT_RUN` staged events in place with an insertion
+ *        sort, keeping events with equal timings in order.
+ *
+ * After the last run, starts merging the runs, or compiling if there is only one.
+ */
+bool TimelineCompiler::sortRun() {
+  uint16_t first = sortPosition;
+  uint16_t n = staged - first < COMPILER_SORT_RUN ? staged - first : COMPILER_SORT_RUN;
+  size_t bytes = n * sizeof(TimelineRecord);
+  bool ok = sortInput.seek((uint32_t)first * sizeof(TimelineRecord), SeekSet)
+            && storage.read(sortInput, (uint8_t*)runBuffer, bytes) == bytes;
+  for (uint16_t i = 1; ok && i < n; i++) {
+    TimelineRecord record = runBuffer[i];
+    int j = i - 1;
+    while (j >= 0 && runBuffer[j].timing > record.timing) {
+      runBuffer[j + 1] = runBuffer[j];
+      j--;
+    }
+    runBuffer[j + 1] = record;
+  }
+  ok = ok && sortInput.seek((uint32_t)first * sizeof(TimelineRecord), SeekSet)
+       && storage.write(sortInput, (const uint8_t*)runBuffer, bytes) == bytes;
+  if (!ok) {
+    return false;
+  }
+  sortPosition += n;
+  if (sortPosition < staged) {
+    return true;
+  }
+  endSort();
+  return staged <= COMPILER_SORT_RUN ? startEncoding() : startMerge();
+}
+
+/**
+ * @brief Opens the sorted runs and the merged file, for `loadRuns()` and `mergeRuns()`.
+ */
+bool TimelineCompiler::startMerge() {
+  runCount = (staged + COMPILER_SORT_RUN - 1) / COMPILER_SORT_RUN;
+  runs = new (std::nothrow) Run[runCount];
+  sortInput = storage.open(stagingPath, "r");
+  sortOutput = storage.open(sortedPath, "w");
+  sortPosition = 0;
+  stage = LoadingRuns;
+  return runs != nullptr && sortInput && sortOutput;
+}
+
+/**
+ * @brief Reads the head event of up to `maxRuns` more runs; once every run has its head,
+ *        arranges them as a heap and starts merging.
+ */
+bool TimelineCompiler::loadRuns(uint16_t maxRuns) {
+  for (uint16_t loaded = 0; loaded < maxRuns && sortPosition < runCount; loaded++, sortPosition++) {
+    Run& run = runs[sortPosition];
+    run.next = sortPosition * COMPILER_SORT_RUN;
+    run.end = run.next + COMPILER_SORT_RUN < staged ? run.next + COMPILER_SORT_RUN : staged;
+    if (!readHead(run)) {
+      return false;
+    }
+  }
+  if (sortPosition < runCount) {
+    return true;
+  }
+  for (uint16_t slot = runCount / 2; slot-- > 0;) {
+    siftDown(slot);
+  }
+  sortPosition = 0;
+  stage = MergingRuns;
+  return true;
+}
+
+/**
+ * @brief Writes up to `maxEvents` events to the merged file, the earliest run head first.
+ *
+ * Only the head event of each run is kept in RAM. Ties go to the earlier run, so events
+ * with equal timings stay in the order they were received. Once every event has been
+ * written, the merged file replaces the staging file and compiling starts.
+ */
+bool TimelineCompiler::mergeRuns(uint16_t maxEvents) {
+  for (uint16_t done = 0; done < maxEvents && runCount > 0; done++) {
+    Run& earliest = runs[0];
+    if (storage.write(sortOutput, (const uint8_t*)&earliest.head, sizeof(TimelineRecord)) != sizeof(TimelineRecord)) {
+      return false;
+    }
+    sortPosition++;
+    if (earliest.next < earliest.end) {
+      if (!readHead(earliest)) {
+        return false;
+      }
+    } else {
+      earliest = runs[--runCount]; // run exhausted
+    }
+    siftDown(0);
+  }
+  if (runCount > 0) {
+    return true;
+  }
+  bool ok = sortPosition == staged;
+  endSort();
+  if (ok) {
+    storage.remove(stagingPath);
+    ok = storage.rename(sortedPath, stagingPath);
+  }
+  return ok && startEncoding();
+}
+
+/**
+ * @brief Reads the event at `run.next` into `run.head` and moves past it.
+ */
+bool TimelineCompiler::readHead(Run& run) {
+  if (!sortInput.seek((uint32_t)run.next * sizeof(TimelineRecord), SeekSet)
+      || storage.read(sortInput, (uint8_t*)&run.head, sizeof(TimelineRecord)) != sizeof(TimelineRecord)) {
+    return false;
+  }
+  run.next++;
+  return true;
+}
+
+/**
+ * @brief Moves the run in `slot` down the heap until neither child comes before it.
+ */
+void TimelineCompiler::siftDown(uint16_t slot) {
+  for (;;) {
+    uint32_t child = 2 * (uint32_t)slot + 1;
+    if (child >= runCount) {
+      return;
+    }
+    if (child + 1 < runCount && before(runs[child + 1], runs[child])) {
+      child++;
+    }
+    if (!before(runs[child], runs[slot])) {
+      return;
+    }
+    Run swapped = runs[slot];
+    runs[slot] = runs[child];
+    runs[child] = swapped;
+    slot = child;
+  }
+}
+
+/**
+ * @brief Whether run `a`'s head goes before run `b`'s: earlier timing, then earlier run.
+ *
+ * Runs cover separate ranges of the staging file, so the run whose next event comes first
+ * in the file is the earlier run.
+ */
+bool TimelineCompiler::before(const Run& a, const Run& b) {
+  return a.head.timing < b.head.timing || (a.head.timing == b.head.timing && a.next < b.next);
+}
+
+/**
+ * @brief Opens the sorted staging file and the output, for `compileStep()`.
+ */
+bool TimelineCompiler::startEncoding() {
+  stage = Encoding;
+  if (!writer.begin(outputPath)) {
+    return false;
+  }
+  input = storage.open(stagingPath, "r");
+  return (bool)input;
+}
+
+/**
+ * @brief Closes the files and frees the RAM used for sorting.
+ */
+void TimelineCompiler::endSort() {
+  if (sortInput) {
+    sortInput.close();
+  }
+  if (sortOutput) {
+    sortOutput.close();
+  }
+  delete[] runBuffer;
+  runBuffer = nullptr;
+  delete[] runs;
+  runs = nullptr;
+  runCount = 0;
+}
+
+/**
+ * @brief Closes the input, finishes or aborts the output and removes the staging file.
+ *
+ * @param ok Whether every event was written.
+ *
+ * @return `true` if the binary timeline file is complete.
+ */
+bool TimelineCompiler::finishCompile(bool ok) {
+  if (sorting()) {
+    endSort();
+    storage.remove(sortedPath);
+  }
+  stage = Staging;
+  if (input) {
+    input.close();
+  }
+  if (ok) {
+    ok = writer.finish();
+  } else {
+    writer.abort();
+  }
+  if (!ok) {
+    storage.remove(outputPath);
+  }
+  storage.remove(stagingPath);
+  return ok;
+}
+
+/**
+ * @brief Writes an event unless it repeats the colour already showing.
+ */
+bool TimelineCompiler::emit(const TimelineRecord& record) {
+  if (haveShown && record.pattern == shown.pattern && record.red == shown.red
+      && record.green == shown.green && record.blue == shown.blue) {
+    return true;
+  }
+  if (!writer.append(record)) {
+    return false;
+  }
+  shown = record;
+  haveShown = true;
+  compiled++;
+  return true;
+}
@@ -0,0 +1,164 @@
+#include "TimelineDownload.h"
+
+TimelineDownload::TimelineDownload() : parser(compiler) {
+  timelineNumber[0] = '\0';
+}
+
+/**
+ * @brief Starts converting the body of a timeline response.
+ *
+ * @param http An HTTPClient whose GET request returned `HTTP_CODE_OK`, with the
+ *             `Transfer-Encoding` header collected. It must stay open until the download
+ *             has finished.
+ * @param timelineNumber The number of the timeline, used to build the file paths.
+ *
+ * @return `false` if the filesystem could not be mounted or the staging file created.
+ */
+bool TimelineDownload::begin(HTTPClient& http, const char* timelineNumber) {
+  if (strlen(timelineNumber) >= sizeof(this->timelineNumber)) {
+    state = Failed;
+    return false;
+  }
+  strcpy(this->timelineNumber, timelineNumber);
+  if (!storage.begin() || !compiler.begin(timelineNumber)) {
+    state = Failed;
+    return false;
+  }
+  parser.reset();
+  body.begin(http.getStreamPtr(), http.getSize(), http.header("Transfer-Encoding").equalsIgnoreCase("chunked"));
+  lastData = millis();
+  phase = Receiving;
+  state = Busy;
+  return true;
+}
+
+/**
+ * @brief Does one bounded slice of the download.
+ *
+ * While receiving, parses whatever part of the body has already arrived, up to
+ * `DOWNLOAD_SLICE_BYTES`. Once the document is complete, sorts the events if they arrived
+ * out of order, one run or `DOWNLOAD_SLICE_EVENTS` merged events per call, then compiles
+ * up to `DOWNLOAD_SLICE_EVENTS` events per call.
+ *
+ * @return `Busy` until the binary file has been written (`Done`) or the download has been
+ *         given up (`Failed`, leaving no file behind).
+ *
+ * @note The result is written to `/timelineN.new`; TimelineManager::installTimeline() moves
+ *       it into place.
+ */
+TimelineDownload::Status TimelineDownload::step() {
+  if (state != Busy) {
+    return state;
+  }
+
+  if (phase == Receiving) {
+    uint8_t buffer[64];
+    size_t parsed = 0;
+    while (parsed < DOWNLOAD_SLICE_BYTES && !body.finished() && !body.failed() && !parser.failed()) {
+      int length = body.read(buffer, sizeof(buffer));
+      if (length <= 0) {
+        break;
+      }
+      parser.write(buffer, length);
+      parsed += length;
+      lastData = millis();
+    }
+
+    if (body.failed() || parser.failed() || (body.finished() && !parser.done())) {
+      compiler.abort();
+      return fail("Timeline download incomplete, not saved.");
+    }
+    if (!body.finished()) {
+      if (millis() - lastData > DOWNLOAD_TIMEOUT) {
+        compiler.abort();
+        return fail("Timeline download timed out.");
+      }
+      return state;
+    }
+    if (!compiler.startCompile()) {
+      return fail("Timeline download incomplete, not saved.");
+    }
+    phase = compiler.sorting() ? Sorting : Compiling;
+    return state;
+  }
+
+  if (phase == Sorting) {
+    bool sorted = false;
+    if (!compiler.sortStep(DOWNLOAD_SLICE_EVENTS, sorted)) {
+      return fail("Timeline could not be sorted, not saved.");
+    }
+    if (sorted) {
+      phase = Compiling;
+    }
+    return state;
+  }
+
+  bool finished = false;
+  if (!compiler.compileStep(DOWNLOAD_SLICE_EVENTS, finished)) {
+    return fail("Timeline could not be compiled, not saved.");
+  }
+  if (finished) {
+    char legacyFilePath[32];
+    formatTimelinePath(legacyFilePath, sizeof(legacyFilePath), timelineNumber, "txt");
+    if (storage.exists(legacyFilePath)) {
+      storage.remove(legacyFilePath); // JSON text file from older firmware
+    }
+    Serial.print("Timeline events received: ");
+    Serial.print(parser.count());
+    Serial.print(", compiled: ");
+    Serial.println(compiler.count());
+    phase = Finished;
+    state = Done;
+  }
+  return state;
+}
+
+/**
+ * @brief Gives up on a download in progress, leaving no file behind.
+ */
+void TimelineDownload::abort() {
+  if (state != Busy) {
+    return;
+  }
+  compiler.abort();
+  phase = Finished;
+  state = Failed;
+}
+
+/**
+ * @brief The result of the last `step()`.
+ */
+TimelineDownload::Status TimelineDownload::status() {
+  return state;
+}
+
+/**
+ * @brief The number of the timeline being downloaded.
+ */
+const char* TimelineDownload::number() {
+  return timelineNumber;
+}
+
+/**
+ * @brief Number of events parsed from the response so far.
+ */
+uint16_t TimelineDownload::received() {
+  return parser.count();
+}
+
+/**
+ * @brief Number of events in the compiled timeline.
+ */
+uint16_t TimelineDownload::compiled() {
+  return compiler.count();
+}
+
+/**
+ * @brief Marks the download as failed and logs why.
+ */
+TimelineDownload::Status TimelineDownload::fail(const char* reason) {
+  Serial.println(reason);
+  phase = Finished;
+  state = Failed;
+  return state;
+}
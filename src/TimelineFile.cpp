@@ -0,0 +1,442 @@
+#include "TimelineFile.h"
+
+/**
+ * @brief Updates a CRC-32 (IEEE 802.3) with a block of data.
+ *
+ * Bitwise implementation, so no lookup table is kept in RAM.
+ *
+ * @param crc The CRC so far; start with 0.
+ * @param data The bytes to add.
+ * @param length Number of bytes in `data`.
+ *
+ * @return The updated CRC.
+ */
+uint32_t timelineCrc32(uint32_t crc, const uint8_t* data, size_t length) {
+  crc = ~crc;
+  while (length--) {
+    crc ^= *data++;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+/**
+ * @brief Builds the flash path of a timeline file without allocating.
+ *
+ * @param buffer Destination for the path, e.g. "/timeline3.bin".
+ * @param size Size of `buffer` in bytes.
+ * @param timelineNumber The timeline number as text.
+ * @param extension File extension without the dot, "bin" for the playable file.
+ */
+void formatTimelinePath(char* buffer, size_t size, const char* timelineNumber, const char* extension) {
+  snprintf(buffer, size, "/timeline%s.%s", timelineNumber, extension);
+}
+
+/**
+ * @brief Creates a binary timeline file and writes a placeholder header.
+ *
+ * @param path The file path to create (an existing file is replaced). The seek index is
+ *             staged next to it with an ".idx" extension.
+ *
+ * @return `true` if the files could be created.
+ *
+ * @note Files are opened through `storage`, which mounts the filesystem on first use.
+ */
+bool TimelineWriter::begin(const char* path) {
+  strncpy(indexPath, path, sizeof(indexPath) - 5);
+  indexPath[sizeof(indexPath) - 5] = '\0';
+  char* extension = strrchr(indexPath, '.');
+  strcpy(extension != nullptr ? extension : indexPath + strlen(indexPath), ".idx");
+
+  memset(&header, 0, sizeof(header));
+  header.magic = TIMELINE_FILE_MAGIC;
+  header.version = TIMELINE_FILE_VERSION;
+  header.indexInterval = TIMELINE_INDEX_INTERVAL;
+  offset = sizeof(header);
+  previousTiming = 0;
+
+  file = storage.open(path, "w");
+  indexFile = storage.open(indexPath, "w");
+  ok = file && indexFile && storage.write(file, (const uint8_t*)&header, sizeof(header)) == sizeof(header);
+  return ok;
+}
+
+/**
+ * @brief Encodes one event and appends it to the file.
+ *
+ * @param record The event to write. Events must be appended in time order.
+ *
+ * @return `true` if the event was written.
+ */
+bool TimelineWriter::append(const TimelineRecord& record) {
+  if (!ok || header.eventCount == 0xFFFF || record.timing < previousTiming) {
+    ok = false;
+    return false;
+  }
+
+  uint32_t value = record.timing - previousTiming;
+  if (header.eventCount % TIMELINE_INDEX_INTERVAL == 0) {
+    TimelineIndexEntry entry = {record.timing, offset};
+    if (storage.write(indexFile, (const uint8_t*)&entry, sizeof(entry)) != sizeof(entry)) {
+      ok = false;
+      return false;
+    }
+    header.indexCount++;
+    value = record.timing; // keyframe: absolute timing
+  }
+
+  uint8_t encoded[9];
+  size_t length = 0;
+  do {
+    uint8_t b = value & 0x7F;
+    value >>= 7;
+    encoded[length++] = value ? (b | 0x80) : b;
+  } while (value);
+  encoded[length++] = record.pattern;
+  encoded[length++] = record.red;
+  encoded[length++] = record.green;
+  encoded[length++] = record.blue;
+
+  if (!put(encoded, length)) {
+    return false;
+  }
+  previousTiming = record.timing;
+  header.eventCount++;
+  return true;
+}
+
+/**
+ * @brief Sets the length of one pass through the timeline, stored in the header.
+ *
+ * @param duration Milliseconds from the start of the timeline until it loops.
+ */
+void TimelineWriter::setDuration(uint32_t duration) {
+  header.duration = duration;
+}
+
+/**
+ * @brief Appends the seek index, writes the final header and closes the file.
+ *
+ * @return `true` if every event, the index and the header were written.
+ */
+bool TimelineWriter::finish() {
+  if (indexFile) {
+    indexFile.close();
+  }
+  if (ok) {
+    header.indexOffset = offset;
+    File index = storage.open(indexPath, "r");
+    uint8_t chunk[64];
+    while (ok && index && index.available() > 0) {
+      int length = storage.read(index, chunk, sizeof(chunk));
+      if (length <= 0) {
+        break;
+      }
+      ok = put(chunk, length);
+    }
+    if (index) {
+      index.close();
+    }
+    ok = ok && offset == header.indexOffset + header.indexCount * sizeof(TimelineIndexEntry);
+    ok = ok && file.seek(0, SeekSet) && storage.write(file, (const uint8_t*)&header, sizeof(header)) == sizeof(header);
+  }
+  if (file) {
+    file.close();
+  }
+  storage.remove(indexPath);
+  return ok;
+}
+
+/**
+ * @brief Closes the file without writing the final header.
+ *
+ * @note The caller should remove the incomplete file.
+ */
+void TimelineWriter::abort() {
+  ok = false;
+  if (file) {
+    file.close();
+  }
+  if (indexFile) {
+    indexFile.close();
+  }
+  storage.remove(indexPath);
+}
+
+/**
+ * @brief Number of events appended so far.
+ */
+uint16_t TimelineWriter::count() {
+  return header.eventCount;
+}
+
+/**
+ * @brief Writes bytes to the file and adds them to the CRC.
+ */
+bool TimelineWriter::put(const uint8_t* data, size_t length) {
+  if (storage.write(file, data, length) != length) {
+    ok = false;
+    return false;
+  }
+  header.crc = timelineCrc32(header.crc, data, length);
+  offset += length;
+  return true;
+}
+
+/**
+ * @brief Opens a binary timeline file and validates its header.
+ *
+ * @param path The file path to open.
+ *
+ * @return `true` if the file exists and has a header of the current version.
+ *
+ * @note Files are opened through `storage`, which mounts the filesystem on first use.
+ */
+bool TimelineReader::open(const char* path) {
+  image = nullptr;
+  header.eventCount = 0;
+  bufferLength = 0;
+  if (!storage.exists(path)) {
+    return false;
+  }
+  file = storage.open(path, "r");
+  if (!file) {
+    return false;
+  }
+  if (storage.read(file, (uint8_t*)&header, sizeof(header)) != sizeof(header) || !checkHeader()) {
+    file.close();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Opens a copy of a binary timeline file held in RAM and validates its header.
+ *
+ * @param image The file contents.
+ * @param size Size of `image` in bytes.
+ *
+ * @return `true` if `image` has a header of the current version and holds the whole file.
+ *
+ * @note `image` must stay valid until the reader is closed.
+ */
+bool TimelineReader::open(const uint8_t* image, size_t size) {
+  this->image = nullptr;
+  header.eventCount = 0;
+  if (image == nullptr || size < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, image, sizeof(header));
+  if (!checkHeader() || header.indexOffset + header.indexCount * sizeof(TimelineIndexEntry) > size) {
+    header.eventCount = 0;
+    return false;
+  }
+  this->image = image;
+  imageSize = size;
+  return true;
+}
+
+/**
+ * @brief Number of events in the open file, as recorded in its header.
+ */
+uint16_t TimelineReader::count() {
+  return header.eventCount;
+}
+
+/**
+ * @brief Length of one pass through the timeline in milliseconds.
+ */
+uint32_t TimelineReader::duration() {
+  return header.duration;
+}
+
+/**
+ * @brief CRC-32 of the event data and index, as recorded in the header.
+ *
+ * Two valid files with the same CRC, count and duration hold the same timeline.
+ */
+uint32_t TimelineReader::crc() {
+  return header.crc;
+}
+
+/**
+ * @brief Checks the CRC of the event data and index.
+ *
+ * The file is read in small chunks, so this works for timelines of any length.
+ *
+ * @return `true` if the whole file is present and the CRC matches the header.
+ */
+bool TimelineReader::verify() {
+  uint32_t end = header.indexOffset + header.indexCount * sizeof(TimelineIndexEntry);
+  if (image != nullptr) {
+    uint32_t crc = timelineCrc32(0, image + sizeof(TimelineHeader), end - sizeof(TimelineHeader));
+    return crc == header.crc;
+  }
+  if (!file || !file.seek(sizeof(TimelineHeader), SeekSet)) {
+    return false;
+  }
+  bufferLength = 0;
+  uint32_t crc = 0;
+  uint32_t position = sizeof(TimelineHeader);
+  while (position < end) {
+    size_t length = end - position < sizeof(buffer) ? end - position : sizeof(buffer);
+    if (storage.read(file, buffer, length) != length) {
+      return false;
+    }
+    crc = timelineCrc32(crc, buffer, length);
+    position += length;
+  }
+  if (crc != header.crc) {
+    Serial.println("Timeline file CRC mismatch.");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Position of the first event in the file.
+ */
+TimelinePosition TimelineReader::start() {
+  TimelinePosition position = {0, sizeof(TimelineHeader), 0};
+  return position;
+}
+
+/**
+ * @brief Finds the keyframe to start decoding from to reach a given time.
+ *
+ * Binary search over the seek index, so at most `indexInterval` events have to be decoded
+ * after it to reach the event active at `ms`.
+ *
+ * @param ms Playback time in milliseconds since the start of the timeline.
+ * @param position Set to the last keyframe at or before `ms`, or to `start()`.
+ *
+ * @return `false` if the index could not be read.
+ */
+bool TimelineReader::find(long ms, TimelinePosition& position) {
+  int lo = 0;
+  int hi = header.indexCount; // first entry with a timing > ms
+  TimelineIndexEntry found = {0, 0};
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    TimelineIndexEntry entry;
+    uint32_t entryOffset = header.indexOffset + mid * sizeof(entry);
+    if (image != nullptr) {
+      memcpy(&entry, image + entryOffset, sizeof(entry));
+    } else if (!file.seek(entryOffset, SeekSet)
+               || storage.read(file, (uint8_t*)&entry, sizeof(entry)) != sizeof(entry)) {
+      return false;
+    }
+    if ((long)entry.timing <= ms) {
+      found = entry;
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == 0) {
+    position = start();
+  } else {
+    position.index = (lo - 1) * header.indexInterval;
+    position.offset = found.offset;
+    position.timing = found.timing;
+  }
+  return true;
+}
+
+/**
+ * @brief Decodes the event at `position` and moves `position` on to the next one.
+ *
+ * @param record Set to the decoded event.
+ * @param position The event to decode; updated to the following event.
+ *
+ * @return `false` past the last event or if the file is truncated.
+ */
+bool TimelineReader::next(TimelineRecord& record, TimelinePosition& position) {
+  if (position.index >= header.eventCount) {
+    return false;
+  }
+  uint32_t at = position.offset;
+  uint32_t value = 0;
+  uint8_t shift = 0;
+  int b;
+  do {
+    b = byteAt(at++);
+    if (b < 0 || shift > 28) {
+      return false;
+    }
+    value |= (uint32_t)(b & 0x7F) << shift;
+    shift += 7;
+  } while (b & 0x80);
+
+  int values[4];
+  for (int i = 0; i < 4; i++) {
+    values[i] = byteAt(at++);
+    if (values[i] < 0) {
+      return false;
+    }
+  }
+
+  record.timing = position.index % header.indexInterval == 0 ? value : position.timing + value;
+  record.pattern = values[0];
+  record.red = values[1];
+  record.green = values[2];
+  record.blue = values[3];
+
+  position.index++;
+  position.offset = at;
+  position.timing = record.timing;
+  return true;
+}
+
+/**
+ * @brief Closes the file if it is open.
+ */
+void TimelineReader::close() {
+  image = nullptr;
+  if (file) {
+    file.close();
+  }
+}
+
+/**
+ * @brief Returns one byte of event data, reading ahead into `buffer` as needed.
+ *
+ * @return The byte, or -1 past the end of the event data.
+ */
+int TimelineReader::byteAt(uint32_t offset) {
+  if (image != nullptr) {
+    return offset < header.indexOffset ? image[offset] : -1;
+  }
+  if (offset < bufferOffset || offset >= bufferOffset + bufferLength) {
+    if (offset >= header.indexOffset || !file.seek(offset, SeekSet)) {
+      return -1;
+    }
+    uint32_t length = header.indexOffset - offset;
+    if (length > sizeof(buffer)) {
+      length = sizeof(buffer);
+    }
+    bufferOffset = offset;
+    bufferLength = storage.read(file, buffer, length);
+    if (bufferLength == 0) {
+      return -1;
+    }
+  }
+  return buffer[offset - bufferOffset];
+}
+
+/**
+ * @brief Checks the header just read for the magic number and current version.
+ */
+bool TimelineReader::checkHeader() {
+  if (header.magic != TIMELINE_FILE_MAGIC
+      || header.version != TIMELINE_FILE_VERSION
+      || header.indexInterval == 0
+      || header.indexOffset < sizeof(header)) {
+    Serial.println("Timeline file header invalid.");
+    header.eventCount = 0;
+    return false;
+  }
+  return true;
+}
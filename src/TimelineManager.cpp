@@ -1,4 +1,6 @@
 #include "TimelineManager.h"
+#include "LoopStats.h"
+#include "TextBuffer.h"
 
 /**
  * @brief Constructs an instance of the TimelineManager class.
@@ -11,7 +13,8 @@
  * @param serverIP The IP address or hostname of the server for communication.
  * @param email The email address used for authentication.
  * @param passwordJwt The JWT password used for authentication.
- * @param client A WiFiClient object for network communication.
+ * @param client A WiFiClient object for network communication. All API calls share one
+ *               keep-alive connection on it (see ApiSession).
  *
  * @note The constructor initializes class members with the provided values and can be
  *       used to set up the TimelineManager instance for managing timelines and
@@ -19,316 +22,596 @@
  * @note You can customize this class further based on your application's needs.
  */
 TimelineManager::TimelineManager(const char* jwtFilePath, const char* serverIP, const char* email, const char* passwordJwt, WiFiClient client) : 
-jwtFilePath(jwtFilePath), serverIP(serverIP), email(email), passwordJwt(passwordJwt), client(client){
+jwtFilePath(jwtFilePath), serverIP(serverIP), email(email), passwordJwt(passwordJwt), client(client), session(this->client, serverIP){
     // Initialize any members if needed
    
 }
 
 /**
- * @brief Reads a JWT token from a file and returns it as a String.
+ * @brief Reads a JWT token from a file.
  *
- * This function attempts to read a JWT token from a specified file path using LittleFS.
- * If the file exists, it reads the token from the file and returns it as a String.
- * If the file does not exist, it calls the `updateToken()` function to potentially
- * generate a new token and then reads it from the file.
+ * This function attempts to read a JWT token from a specified file path on flash.
+ * If the file exists, it reads the token from the file into `buffer`.
  *
- * @return A String containing the JWT token read from the file, or an empty String if
- *         the token could not be read or generated.
+ * @param buffer Receives the token, or an empty string if there is no saved token.
+ * @param size The size of `buffer`; a longer file is cut off.
  *
- * @see updateToken() - This function may call `updateToken()` to generate a new token if
- *                      the file does not exist.
+ * @return `true` if a token was read.
+ *
+ * @note Only `updateToken()` needs this, at startup; API calls use the copy in RAM.
  */
-String TimelineManager::readJWTTokenFromFile() { //todo: else update token? 
+bool TimelineManager::readJWTTokenFromFile(char* buffer, size_t size) {
   Serial.println("readJWTTokenFromFile called");
-  String jwtToken = "";
-
-  if (LittleFS.begin()) {
-    if (LittleFS.exists(jwtFilePath)) {
-      File file = LittleFS.open(jwtFilePath, "r");
-      if (file) {
-        jwtToken = file.readString();
-        Serial.println("jwtToken from disk: " + jwtToken);
-        file.close();
-      }
-    } else {
-      updateToken(); 
-      File file = LittleFS.open(jwtFilePath, "r");
-      if (file) {
-        jwtToken = file.readString();
-        Serial.println("jwtToken from disk: " + jwtToken);
-        file.close();
-      }
+  buffer[0] = '\0';
+
+  if (storage.exists(jwtFilePath)) {
+    File file = storage.open(jwtFilePath, "r");
+    if (file) {
+      size_t length = storage.read(file, (uint8_t*)buffer, size - 1);
+      buffer[length] = '\0';
+      Serial.print("jwtToken from disk: ");
+      Serial.println(buffer);
+      file.close();
     }
-    LittleFS.end();
   }
 
-  return jwtToken;
+  return buffer[0] != '\0';
 }
 
 /**
  * @brief Saves a JWT token to a file.
  *
- * This function takes a JWT token as input and saves it to a specified file path using LittleFS.
+ * This function takes a JWT token as input and saves it to a specified file path on flash.
  *
  * @param token The JWT token to be saved to the file.
  */
 void TimelineManager::saveJWTTokenToFile(const char* token) {
-  if (LittleFS.begin()) {
-    File file = LittleFS.open(jwtFilePath, "w");
-    if (file) {
-      file.print(token);
-      file.close();
-      Serial.println("JWT token saved to file.");
-    }
-    LittleFS.end();
+  File file = storage.open(jwtFilePath, "w");
+  if (file) {
+    storage.write(file, token);
+    file.close();
+    Serial.println("JWT token saved to file.");
+  }
+}
+
+/**
+ * @brief Makes a JWT token the one used for API calls.
+ *
+ * The token is kept in RAM and its `exp` and `iat` claims are decoded, so `gotTokenTrue()`
+ * can report it as expired shortly before the server would reject it.
+ *
+ * @param newToken The JWT token.
+ * @param persist Whether to save it to flash. It is only written if it differs from the
+ *                token already in use.
+ *
+ * @return `false` if the token is empty or too long to store.
+ */
+bool TimelineManager::setTokenValue(const char* newToken, bool persist) {
+  size_t length = strlen(newToken);
+  if (length == 0 || length >= sizeof(token)) {
+    Serial.println("JWT token missing or too long.");
+    return false;
+  }
+  bool changed = strcmp(token, newToken) != 0;
+  if (changed) {
+    strcpy(token, newToken);
+  }
+  if (persist && changed) {
+    saveJWTTokenToFile(token);
+  }
+
+  tokenReceived = millis();
+  tokenExpiry = 0;
+  tokenIssued = 0;
+  if (jwtNumericClaim(token, "exp", tokenExpiry)) {
+    jwtNumericClaim(token, "iat", tokenIssued);
+    Serial.print("JWT token expires at (unix time): ");
+    Serial.println(tokenExpiry);
   }
+  gotToken = true;
+  return true;
+}
+
+/**
+ * @brief Seconds until the token in use expires.
+ *
+ * Uses the server's clock from the `Date` header of recent responses if there is one.
+ * Before any response, a token that has just been issued is timed from its `iat` claim.
+ *
+ * @param remaining Set to the seconds left, negative once expired.
+ *
+ * @return `false` if the expiry is unknown (no `exp` claim, or a saved token and no server
+ *         time yet).
+ */
+bool TimelineManager::tokenTimeRemaining(long& remaining) {
+  if (tokenExpiry == 0) {
+    return false;
+  }
+  uint32_t now;
+  if (session.serverTime(now)) {
+    remaining = (int32_t)(tokenExpiry - now);
+    return true;
+  }
+  if (tokenIssued != 0 && tokenFresh) {
+    remaining = (int32_t)(tokenExpiry - tokenIssued) - (int32_t)((millis() - tokenReceived) / 1000);
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Sends an authorised GET request on the shared session.
+ *
+ * A `401 Unauthorized` response clears `gotToken`, so the next sync logs in again.
+ *
+ * @return The HTTP status code, negative if the connection failed.
+ */
+int TimelineManager::apiGet(const char* path) {
+  int httpCode = session.get(path, token);
+  if (httpCode == HTTP_CODE_UNAUTHORIZED) {
+    Serial.println("JWT token rejected, will re-authenticate.");
+    gotToken = false;
+  }
+  return httpCode;
 }
 
 /**
  * @brief Clears the data for a specific timeline.
  *
- * This function clears the data for a specific timeline identified by its number.
+ * This function removes the binary file of a specific timeline identified by its number,
+ * along with any downloaded copy waiting to replace it, and drops it from the catalog so
+ * that the next sync downloads it again.
  *
  * @param timelineNumber The number of the timeline to be cleared.
  */
-void TimelineManager::clearTimeline(String timelineNumber) {
-  String timelineFilePath = "/timeline" + timelineNumber + ".txt"; 
-  if (LittleFS.begin()) {
-    File file = LittleFS.open(timelineFilePath, "w");
-    if (file) {
-      file.close();
-      Serial.println("Timeline data cleared.");
-    }
-    LittleFS.end();
+void TimelineManager::clearTimeline(const char* timelineNumber) {
+  char timelineFilePath[32];
+  char pendingFilePath[32];
+  formatTimelinePath(timelineFilePath, sizeof(timelineFilePath), timelineNumber);
+  formatTimelinePath(pendingFilePath, sizeof(pendingFilePath), timelineNumber, "new");
+  if (storage.remove(timelineFilePath)) {
+    Serial.println("Timeline data cleared.");
   }
+  storage.remove(pendingFilePath);
+  catalog.remove(timelineNumber);
+  catalog.save();
 }
 
 /**
- * @brief Saves timeline data to a specified file.
+ * @brief Streams timeline JSON from an HTTP response into a binary timeline file.
+ *
+ * This function runs a TimelineDownload to completion: the response body is read straight
+ * from `http.getStreamPtr()` in small blocks and fed through a TimelineParser, which stages
+ * each (timing, r, g, b) event on flash as soon as it is parsed, then the TimelineCompiler
+ * sorts, deduplicates and delta-encodes the events into the binary file. The JSON is
+ * converted once, here; playback loads the binary file directly (see `loadTimeline()`).
  *
- * This function takes timeline data and a file path as input and saves the data to the
- * specified file using LittleFS.
+ * @param http An HTTPClient whose GET request returned `HTTP_CODE_OK`, with the
+ *             `Transfer-Encoding` header collected.
+ * @param timelineNumber The number of the timeline, used to build the file path.
  *
- * @param timelineData The timeline data to be saved to the file.
- * @param timelineFilePath The file path where the timeline data should be saved.
+ * @return `true` if the whole document was parsed and the binary file written.
+ *
+ * @note This blocks until the download is complete. `loop()` uses TimelineSync instead,
+ *       which runs the same download a slice at a time.
+ * @note An incomplete or invalid download leaves no file behind.
+ * @see installTimeline() - Moves the new file into place.
  */
-void TimelineManager::saveTimeline(const String& timelineData, String timelineFilePath) {
-  if (LittleFS.begin()) {
-    File file = LittleFS.open(timelineFilePath, "w");
-    if (file) {
-      file.print(timelineData);
-      file.close();
-      Serial.println("Timeline data saved to file.");
-    }
-    LittleFS.end();
+bool TimelineManager::saveTimeline(HTTPClient& http, const char* timelineNumber) {
+  TimelineDownload download;
+  if (!download.begin(http, timelineNumber)) {
+    return false;
+  }
+  while (download.step() == TimelineDownload::Busy) {
+    delay(1);
+  }
+  if (download.status() != TimelineDownload::Done) {
+    return false;
   }
+  installTimeline(timelineNumber);
+  return true;
 }
 
 /**
- * @brief Loads timeline data from a file for a specific timeline.
+ * @brief Moves a freshly downloaded timeline into place.
  *
- * This function loads timeline data from a file associated with a specific timeline
- * identified by its number. It returns the loaded data as a String.
+ * Downloads are compiled into `/timelineN.new`, which is checked first: a copy that fails
+ * its CRC, or that holds the same timeline as `/timelineN.bin`, is deleted and the file on
+ * flash is kept. Otherwise, if timeline N is not playing, the new file replaces
+ * `/timelineN.bin` straight away. If it is playing it is left alone, so playback carries on
+ * undisturbed, and it is replaced the next time it is activated with `loadTimeline()`.
  *
- * @param timelineNumber The number of the timeline for which data should be loaded.
+ * @param timelineNumber The number of the downloaded timeline.
+ */
+void TimelineManager::installTimeline(const char* timelineNumber) {
+  if (!checkPendingTimeline(timelineNumber)) {
+    return;
+  }
+  if (already_got_data && strcmp(activeNumber, timelineNumber) == 0) {
+    Serial.println("Timeline is playing, new version kept until it is activated again.");
+    return;
+  }
+  promoteTimeline(timelineNumber);
+}
+
+/**
+ * @brief Checks a downloaded timeline before it is allowed to replace the one on flash.
  *
- * @return A String containing the loaded timeline data, or an empty String if the data
- *         could not be loaded.
+ * Reads `/timelineN.new` back and checks its CRC, so a file cut short by a reset or a
+ * flash error is never moved into place. If `/timelineN.bin` is intact and has the same
+ * CRC, count and duration the download is identical to it and is deleted, which saves
+ * erasing and rewriting the flash blocks of a timeline that has not changed.
+ *
+ * @return `true` if there is a valid, different `/timelineN.new` to move into place.
+ *
+ * @note A corrupt download is also dropped from the catalog, so the next sync fetches it
+ *       again.
  */
- String TimelineManager::loadTimeline(String timelineNumber) {
-  String timelineFilePath = "/timeline" + timelineNumber + ".txt";
-  String timelineData="";
-  if (LittleFS.begin()) {
-    if (LittleFS.exists(timelineFilePath)) {
-      File file = LittleFS.open(timelineFilePath, "r");
-      if (file) {
-        timelineData = file.readString();
-        file.close();
-        Serial.println("Timeline data loaded from disk:");
-        Serial.println(timelineData);
-        processTimelineData(timelineData); // Process the timeline data - todo: need to re-add this! 
-      }
+bool TimelineManager::checkPendingTimeline(const char* timelineNumber) {
+  char timelineFilePath[32];
+  char pendingFilePath[32];
+  formatTimelinePath(timelineFilePath, sizeof(timelineFilePath), timelineNumber);
+  formatTimelinePath(pendingFilePath, sizeof(pendingFilePath), timelineNumber, "new");
+  if (!storage.exists(pendingFilePath)) {
+    return false;
+  }
+
+  TimelineReader pending;
+  bool valid = pending.open(pendingFilePath) && pending.verify();
+  pending.close();
+  if (!valid) {
+    Serial.println("Downloaded timeline is corrupt, discarded.");
+    storage.remove(pendingFilePath);
+    catalog.remove(timelineNumber);
+    catalog.save();
+    return false;
+  }
+
+  TimelineReader current;
+  bool same = current.open(timelineFilePath)
+              && current.crc() == pending.crc()
+              && current.count() == pending.count()
+              && current.duration() == pending.duration()
+              && current.verify();
+  current.close();
+  if (same) {
+    Serial.println("Downloaded timeline is unchanged, flash not rewritten.");
+    storage.remove(pendingFilePath);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Replaces a timeline file with its downloaded copy, if there is one.
+ *
+ * The rename replaces the old file in one step, so a reset at any point leaves either the
+ * old or the new timeline on flash, never neither.
+ *
+ * @return `true` if the file was replaced.
+ *
+ * @note Call `checkPendingTimeline()` first.
+ */
+bool TimelineManager::promoteTimeline(const char* timelineNumber) {
+  char timelineFilePath[32];
+  char pendingFilePath[32];
+  formatTimelinePath(timelineFilePath, sizeof(timelineFilePath), timelineNumber);
+  formatTimelinePath(pendingFilePath, sizeof(pendingFilePath), timelineNumber, "new");
+  if (!storage.exists(pendingFilePath)) {
+    return false;
+  }
+  if (!storage.rename(pendingFilePath, timelineFilePath)) {
+    return false;
+  }
+  cache.invalidate(timelineNumber);
+  return true;
+}
+
+/**
+ * @brief Opens a binary timeline file for playback and starts playing it.
+ *
+ * This function fills the event window from the start of the timeline, with no JSON
+ * parsing. Recently played timelines that fit the cache budget are played from their copy
+ * in RAM, so switching back to one is a pointer swap. Others are checked and streamed from
+ * flash as playback advances, so timelines of any length play with the same RAM use.
+ *
+ * @param timelineNumber The number of the timeline to load.
+ *
+ * @return `true` if the timeline was loaded and playback started.
+ *
+ * @note A newer download of the timeline waiting in `/timelineN.new` is checked and moved
+ *       into place first (see `installTimeline()`).
+ *
+ * @note The new timeline is checked before it replaces the one playing, which plays on if
+ *       it cannot be loaded. A missing or corrupt file is cleared so that `loop()` fetches
+ *       it again, unless it is still playing from its copy in RAM.
+ *
+ * @see saveTimeline() - Writes the binary file at download time.
+ * @see EventWindow - The RAM ring buffer that playback reads from.
+ * @see TimelineCache - The in-RAM copies of recently played timelines.
+ */
+bool TimelineManager::loadTimeline(const char* timelineNumber) {
+  bool active = already_got_data && strcmp(activeNumber, timelineNumber) == 0;
+  if (checkPendingTimeline(timelineNumber)) {
+    if (active) {
+      window.unload(); // it may be streaming the file about to be replaced
     }
-    LittleFS.end();
-  }
-  return timelineData;
-}
-
-/**
- * @brief Processes timeline data from a JSON string.
- *
- * This function processes timeline data provided as a JSON string. It extracts timing
- * information and RGB colour values for each event in the timeline, populating the
- * respective arrays for further use.
- *
- * @param timelineData A JSON-formatted string containing timeline data.
- *
- * @note This function assumes that the JSON data has a specific format with timing
- *       information and RGB colour values.
- * @note The `colours` and `timings` arrays are populated with the RGB colour values and
- *       corresponding timings, respectively.
- * @note If no data is present in the timeline, this function resets relevant flags and
- *       may clear the timeline file.
- * @note After processing the data, the function sets the `already_got_data` flag to
- *       indicate that data has been successfully processed.
- *
- * @see clearTimeline(String timelineNumber) - Clears the timeline data if no data is
- *                                            present.
- * @see getTimelineNumber() - Used to retrieve the timeline number for clearing the
- *                            timeline data.
- */
-void TimelineManager::processTimelineData(const String& timelineData) {
-  // Serial.println("processTimelineData");
-  DynamicJsonDocument led_doc(1500);
-  deserializeJson(led_doc, timelineData);
-  JsonObject root = led_doc.as<JsonObject>();
-
-  int iter = 0;
-  for (JsonPair kv : root) {
-    // String key = kv.key().c_str();
-    // JsonObject subDict = kv.value().as<JsonObject>();
-    // iter = 0;
-    // // Process the sub-dictionary
-    // for (JsonPair subKv : subDict) {
-    Serial.print("got ");
-    Serial.println(kv.key().c_str());
-    timeline_keys[iter] = kv.key().c_str(); //should be the last one here..
-    iter++;
-    // }
-  }
-  Serial.print("iter: ");
-  Serial.println(iter);
-  if(iter == 0){ //nothing here? re-set? todo: does this solve freezing??
-    already_got_data = false;
-    gotToken = false;
-    String timelineNumber = getTimelineNumber(); //todo: is this right, using current timeline here? 
-    clearTimeline(timelineNumber);
-    return;
+    promoteTimeline(timelineNumber);
   }
 
-  maxTimingsNum = iter;
+  unsigned long started = micros();
+  size_t imageSize = 0;
+  const uint8_t* image = cache.acquire(timelineNumber, imageSize);
+  bool loaded;
+  if (image != nullptr) {
+    loaded = window.load(image, imageSize);
+  } else {
+    char timelineFilePath[32];
+    formatTimelinePath(timelineFilePath, sizeof(timelineFilePath), timelineNumber);
+    loaded = window.load(timelineFilePath);
+    if (loaded) {
+      cache.unpin(); // the copy that was playing is no longer needed
+    }
+  }
+  unsigned long elapsed = micros() - started;
 
-  for (int i = 0; i < iter; i++) {
-    if (timeline_keys[i][0] == '\0') { // check for empty string
-      Serial.println("end");
-    } else {
-      redVal = led_doc[timeline_keys[i]][0];
-      greenVal = led_doc[timeline_keys[i]][1];
-      blueVal = led_doc[timeline_keys[i]][2];
-
-      redInt = redVal.as<int>();
-      // initialise arrays for timings: 
-      colours[i] = redInt;
-      timings[i] = atol(timeline_keys[i]);
-      
-      // if (redInt == 13) {
-      //   Serial.println("LUCKY 13!!!");
-      // }
-      greenInt = greenVal.as<int>();
-      blueInt = blueVal.as<int>();
-      Serial.print("got colours for ");
-      Serial.print(timeline_keys[i]);
-      Serial.print(": ");
-      Serial.print(redInt);
-      Serial.print(", ");
-      Serial.print(greenInt);
-      Serial.print(", ");
-      Serial.println(blueInt);
+  if (!loaded) {
+    Serial.print("Timeline ");
+    Serial.print(timelineNumber);
+    Serial.println(" missing or corrupt, not loaded.");
+    bool playing = window.size() > 0;
+    if (!playing) {
+      already_got_data = false; // nothing left to play
+      maxTimingsNum = 0;
+    }
+    if (!active || !playing) {
+      clearTimeline(timelineNumber);
     }
+    return false;
   }
-  // Print the colours array
-      Serial.print("Colours from disk: ");
-      for (int i = 0; i < iter; i++) {
-        Serial.print(colours[i]);
-        Serial.print(" ");
-      }
-      Serial.println(); // Print a new line after the array
-      // Print the timeline array
-      Serial.print("Timings from disk: ");
-      for (int i = 0; i < iter; i++) {
-        Serial.print(timings[i]);
-        Serial.print(" ");
-      }
-      Serial.println(); // Print a new line after the array
+
+  Serial.print("Timeline events: ");
+  Serial.print(window.size());
+  Serial.print(", activated in us: ");
+  Serial.print(elapsed);
+  Serial.print(image != nullptr ? " (from RAM)" : " (from flash)");
+  Serial.print(", cache hits/misses: ");
+  Serial.print(cache.hits());
+  Serial.print("/");
+  Serial.println(cache.misses());
+
+  maxTimingsNum = window.size();
+  strncpy(activeNumber, timelineNumber, sizeof(activeNumber) - 1);
+  activeNumber[sizeof(activeNumber) - 1] = '\0';
   already_got_data = true;
-  // digitalWrite(led, LOW);
+  activatePlayback();
+  return true;
+}
+
+/**
+ * @brief Prepares the playback cursor for a freshly loaded timeline.
+ *
+ * Takes the length of one pass through the timeline from the file and rewinds the cursor to
+ * the start. The timeline loops after that length.
+ *
+ * @note Called once the event window has been loaded.
+ * @see TimelineCompiler::compile() - Where the length of a pass is worked out.
+ * @see alignPlayback() - Moves the start to the scheduled time or the shared clock.
+ */
+void TimelineManager::activatePlayback() {
+  loopLength = window.duration();
+  if (loopLength <= 0) {
+    loopLength = 1;
+  }
+  scheduledStart = catalog.start(activeNumber);
+  waitingForStart = false;
+  playStartTime = playbackTime();
+  pausedAt = 0;
+  seek(0);
+  alignPlayback();
+}
+
+/**
+ * @brief Lines playback up with the wall clock or the shared clock, if there is one.
+ *
+ * A timeline with a scheduled start is timed from it on the SNTP clock: until then the
+ * LEDs are off, and after it playback is wherever the schedule puts it, so every poi starts
+ * on the same millisecond and one that is switched on late joins in at the right point.
+ * Otherwise, once ClockSync is synced, passes through the timeline are made to start at
+ * whole multiples of its length on the shared clock, so every poi playing the same timeline
+ * is at the same point in it, however long ago each one loaded it.
+ *
+ * @note Called when a timeline is loaded, when either clock is set or locks on to a
+ *       leader, and when the scheduled start arrives.
+ */
+void TimelineManager::alignPlayback() {
+  unsigned long now = playbackTime();
+  clockLocks = clock != nullptr ? clock->locks() : 0;
+  wallSyncs = wallClock != nullptr ? wallClock->syncs() : 0;
+  if (scheduledStart != 0 && wallClock != nullptr && wallClock->valid()) {
+    uint64_t epoch = wallClock->epochMillis();
+    if (epoch < scheduledStart) {
+      waitingForStart = true;
+      window.rewind();
+      signal = TIMELINE_SIGNAL_OFF;
+      return;
+    }
+    waitingForStart = false;
+    long elapsed = (long)((epoch - scheduledStart) % loopLength);
+    playStartTime = now - elapsed;
+    seek(elapsed);
+  } else if (clock != nullptr && clock->synced()) {
+    playStartTime = now - now % loopLength;
+    seek(now - playStartTime);
+  }
+}
+
+/**
+ * @brief Picks up a change to the active timeline's scheduled start, e.g. after a sync.
+ */
+void TimelineManager::updateSchedule() {
+  if (!already_got_data) {
+    return;
+  }
+  uint64_t start = catalog.start(activeNumber);
+  if (start != scheduledStart) {
+    scheduledStart = start;
+    waitingForStart = false;
+    alignPlayback();
+  }
+}
+
+/**
+ * @brief The time playback runs on: the shared clock if there is one, `millis()` if not.
+ */
+unsigned long TimelineManager::playbackTime() {
+  return clock != nullptr ? clock->sharedMillis() : millis();
+}
+
+/**
+ * @brief Moves the playback cursor to a point in the timeline.
+ *
+ * The cursor is placed on the event active at `ms` (a binary search, O(log n)) and `signal`
+ * is set to that event's colour, so playback continues from the right place in a single
+ * call. Times past the end of the timeline wrap around.
+ *
+ * @param ms Playback time in milliseconds since the start of the timeline.
+ *
+ * @note `playStartTime` is not changed; use this to resynchronise the cursor with the clock.
+ */
+void TimelineManager::seek(unsigned long ms) {
+  if (maxTimingsNum <= 0 || loopLength <= 0) {
+    return;
+  }
+  TimelineRecord active;
+  if (window.seek(ms % loopLength, active) >= 0) {
+    signal = active.pattern;
+  }
+}
+
+/**
+ * @brief Moves playback to a point in the timeline, e.g. from a live controller.
+ *
+ * Unlike `seek()`, the timeline carries on from `ms` rather than from where the clock
+ * says it should be. If playback is stopped it resumes from `ms` once started again.
+ *
+ * @param ms Milliseconds into the timeline; past its end wraps around.
+ *
+ * @note A scheduled start or a newly locked shared clock lines playback up again.
+ */
+void TimelineManager::playFrom(unsigned long ms) {
+  if (maxTimingsNum <= 0 || loopLength <= 0) {
+    return;
+  }
+  long position = (long)(ms % loopLength);
+  waitingForStart = false;
+  playStartTime = playbackTime() - position;
+  pausedAt = position;
+  seek(position);
+}
+
+/**
+ * @brief Shows a pattern in place of the timeline's, until the timeline's next event.
+ *
+ * While playback is stopped the pattern stays until something else changes it.
+ *
+ * @param pattern The signal `checkTimelineData()` returns from now on.
+ */
+void TimelineManager::setSignal(uint8_t pattern) {
+  signal = pattern;
+}
 
-  //todo: test: 
-  playStartTime = millis();
+/**
+ * @brief Returns `true` if timeline N is on flash, installed or waiting to be.
+ */
+bool TimelineManager::hasTimeline(const char* timelineNumber) {
+  char timelineFilePath[32];
+  formatTimelinePath(timelineFilePath, sizeof(timelineFilePath), timelineNumber);
+  if (storage.exists(timelineFilePath)) {
+    return true;
+  }
+  formatTimelinePath(timelineFilePath, sizeof(timelineFilePath), timelineNumber, "new");
+  return storage.exists(timelineFilePath);
 }
 
+/**
+ * @brief Returns the `millis()` time at which the next colour change is due.
+ *
+ * @return The absolute `millis()` value of the next event, or of the loop restart when the
+ *         last event is playing, converted from the shared clock if playback runs on one.
+ *         While waiting for a scheduled start, the start or one minute from now if sooner.
+ */
+unsigned long TimelineManager::nextEventDeadline() {
+  if (waitingForStart) {
+    uint64_t epoch = wallClock->epochMillis();
+    uint64_t wait = epoch < scheduledStart ? scheduledStart - epoch : 0;
+    return millis() + (unsigned long)(wait < 60000 ? wait : 60000);
+  }
+  const TimelineRecord* next = window.current();
+  unsigned long due = playStartTime + (next != nullptr ? (long)next->timing : loopLength);
+  return due - playbackTime() + millis(); // from the shared clock to millis()
+}
 
+/**
+ * @brief Advances timeline playback and returns the colour that should be showing now.
+ *
+ * The event window's cursor always points at the next event to fire. Each call fires that
+ * event once its timing has passed, then lets the window refill from flash ahead of the
+ * playhead. If `loop()` was blocked for longer than one event gap the cursor is moved with
+ * `seek()` to the correct event instead of restarting the show, and when the end of the
+ * timeline is reached playback loops.
+ *
+ * @return The current colour signal to pass to `ColourPatterns::changeColours()`.
+ *
+ * @note Events must be sorted by timing in ascending order.
+ *
+ * @see seek() - Binary-search repositioning of the cursor.
+ * @see nextEventDeadline() - When the next call will change the signal.
+ */
 uint8_t TimelineManager::checkTimelineData(){
-  // test:
-  if (playing)
+  if (!playing || maxTimingsNum <= 0 || loopLength <= 0)
+  {
+    return signal;
+  }
+
+  if ((clock != nullptr && clock->locks() != clockLocks) || (wallClock != nullptr && wallClock->syncs() != wallSyncs))
   {
-    // Serial.println("checking Timeline here");
-    if (runNum > maxTimingsNum - 2) //todo: ???
+    alignPlayback(); // a clock has just been set, or has locked on to a leader
+  }
+  if (waitingForStart)
+  {
+    if (wallClock->epochMillis() < scheduledStart)
     {
-      // Serial.println("initialising runNum and playStartTime");s
-      runNum = 0;
-      playStartTime = millis();
+      return signal; // off until the scheduled start
     }
-    // another sanity check:
-    if (timings[runNum] > 0)
-    {      
-      // Serial.print("Checking timing for ");
-      // Serial.print(timings[runNum]);
-      currentMillisTimeline = millis() - playStartTime; // reset the clock! At the beginning of play this should be 0!
-      
-      if (currentMillisTimeline < timings[0])
-      {
-        // Serial.print("< ");
-        // Serial.println(runNum);
-        // runNum++;
-      }
-      //   I think currently timings[] array must be in time order to work. If the last time is smaller than the previous nothing happens? todo: sort?
-      else if (currentMillisTimeline >= timings[runNum] && currentMillisTimeline <= timings[runNum + 1]) // todo: this omits the last signal..?
-      {                                                                                    // saved signal
-                                                                                           // Serial.print("== ");
-        // Serial.print(runNum);
-        // Serial.print(" of: ");
-        // Serial.println(maxTimingsNum-1);
-        // sanity check:
-        // if (colours[runNum] < 13)
-        // { // max is 22 otherwise it's a bogus signal
-          signal = colours[runNum];
-          // long time = timings[runNum];
-          // flashy = flashes[runNum];
-          // Serial.print("colour is set to: ");
-          // Serial.println(colours[runNum]);
-          // Serial.print("timings is set to: ");
-          // Serial.println(timings[runNum]);
-          // patternHandler.changeColours(colours[runNum]); //todo: do this in loop..
-          runNum++;
-          //todo: deal with colours here - separate funciton
-        // }
-      }
-      else if (currentMillisTimeline >= timings[runNum+1])
-      {
-        runNum = maxTimingsNum; // went over - trigger reset
-      }
-      else 
-      {
-        //test code:  
-        // Serial.println("what else? ");
-        // Serial.println("runNum: ");
-        // Serial.println(runNum);
-        // Serial.print("millis: ");
-        // Serial.println(millis());
-        // Serial.print("currentMillis2: ");
-        // Serial.println(currentMillis2);
-        // Serial.print("timings[runNum]: ");
-        // Serial.println(timings[runNum]);
-        // Serial.print("timings[runNum + 1]: ");
-        // Serial.println(timings[runNum + 1]);      
-   
-        // playStartTime = millis();
-        // Serial.println("resetting playStartTime");
-        // runNum++;
-      }
+    alignPlayback();
+  }
+
+  currentMillisTimeline = playbackTime() - playStartTime;
+  if (currentMillisTimeline >= loopLength)
+  {
+    // end of the timeline (possibly several passes if we stalled): loop back
+    long passes = currentMillisTimeline / loopLength;
+    playStartTime += passes * loopLength;
+    currentMillisTimeline -= passes * loopLength;
+    window.rewind();
+  }
+
+  const TimelineRecord* next = window.current();
+  if (next != nullptr && currentMillisTimeline >= (long)next->timing)
+  {
+    loopStats.lateness.add(currentMillisTimeline - next->timing);
+    const TimelineRecord* after = window.following();
+    if (after != nullptr && currentMillisTimeline >= (long)after->timing)
+    {
+      seek(currentMillisTimeline); // missed more than one event, jump straight to the right one
+    }
+    else
+    {
+      signal = next->pattern;
+      window.advance();
+      window.refill(); // top up ahead of the playhead while the next event is still due
     }
-    
   }
   return signal;
 }
@@ -338,7 +621,8 @@ uint8_t TimelineManager::checkTimelineData(){
  *
  * This function sends an HTTP POST request to a remote server with the provided email
  * and password to obtain an authentication token. If the authentication is successful,
- * the token is saved to a file using the `saveJWTTokenToFile` function.
+ * the token is kept in RAM for the following API calls, and saved to a file using the
+ * `saveJWTTokenToFile` function if it has changed.
  *
  * @return `true` if authentication is successful and the token is obtained, `false`
  *         otherwise.
@@ -347,37 +631,36 @@ uint8_t TimelineManager::checkTimelineData(){
  *       of the server at the specified URL.
  * @note The authentication token is parsed from the JSON response received from the
  *       server.
- * @note If authentication is successful, the `gotToken` flag may be set or handled
- *       globally in your application.
+ * @note If authentication is successful, the `gotToken` flag is set.
  * @note In case of any errors or failed authentication, this function returns `false`.
  *
- * @see saveJWTTokenToFile(const char* token) - Used to save the obtained token to a file.
+ * @see setTokenValue() - Stores the token and decodes its expiry.
  */
 bool TimelineManager::authenticate() {
-  HTTPClient http;
-  http.begin(client, "http://" + String(serverIP) + "/api/login"); //localhost
-  // http.begin(client, "http://magicpoi.circusscientist.com/api/login"); //server - todo: delete hard coding if above works..
-  http.addHeader("Content-Type", "application/json");
-
-  Serial.println("[HTTP] POST...");
-  int httpCode = http.POST("{\"email\":\"" + String(email) + "\",\"password\":\"" + String(passwordJwt) + "\"}");
+  char login[LOGIN_BODY_SIZE];
+  TextBuffer body(login, sizeof(login));
+  if (!body.format("{\"email\":\"%s\",\"password\":\"%s\"}", email, passwordJwt)) {
+    Serial.println("Email and password too long for the login request.");
+    return false;
+  }
+  int httpCode = session.post("/api/login", login);
+  bool authenticated = false;
 
   // httpCode will be negative on error
   if (httpCode > 0) {
     if (httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_CREATED) {
-      // Parse the response JSON to get the token
+      // Parse the response JSON to get the token, straight off the connection
       DynamicJsonDocument doc(1024);
-      DeserializationError error = deserializeJson(doc, http.getString());
+      DeserializationError error = deserializeJson(doc, session);
       if (error) {
         Serial.println("Failed to parse JSON.");
-        return false;
+      } else {
+        tokenFresh = true;
+        authenticated = setTokenValue(doc["token"] | "", true);
+        if (authenticated) {
+          Serial.println("Authentication successful.");
+        }
       }
-      
-    //   strcpy(token, doc["token"]);
-      saveJWTTokenToFile(doc["token"]);
-      Serial.println("Authentication successful.");
-    //   gotToken = true; //todo: global - need to return and deal with in main
-      return true;
     } else {
       Serial.print("[HTTP] Error code: ");
       Serial.println(httpCode);
@@ -386,8 +669,8 @@ bool TimelineManager::authenticate() {
     Serial.println("Connection failed.");
   }
 
-  http.end();
-  return false;
+  session.end();
+  return authenticated;
 }
 
 /**
@@ -397,25 +680,32 @@ bool TimelineManager::authenticate() {
  * total number of timelines. It uses the provided client object and server
  * authentication token for communication.
  * 
- * @return String containing the API response with the current active timeline number.
- *         An empty string is returned if the request fails.
- */
-String TimelineManager::getTimelineNumber() {
-  String token = readJWTTokenFromFile();
-  HTTPClient http;
-  http.begin(client, "http://" + String(serverIP) + "/lite/api/get-current-timeline-number"); //localhost
-  // http.begin(client, "http://magicpoi.circusscientist.com/lite/api/get-current-timeline-number"); //server - todo: delete hard coding
-  http.addHeader("Authorization", "Bearer " + String(token));
-
-  Serial.println("[HTTP] GET...");
-  int httpCode = http.GET();
-  String response = "";
+ * @param number Receives the API response with the current active timeline number,
+ *               without surrounding whitespace. It is left empty if the request fails or
+ *               the response does not fit.
+ * @param size The size of `number`.
+ *
+ * @return `true` if a number was received.
+ */
+bool TimelineManager::getTimelineNumber(char* number, size_t size) {
+  int httpCode = apiGet("/lite/api/get-current-timeline-number");
+  number[0] = '\0';
   // httpCode will be negative on error
   if (httpCode > 0) {
     if (httpCode == HTTP_CODE_OK) {
+      if (session.readBody(number, size) < 0) {
+        Serial.println("Timeline number missing or too long.");
+        number[0] = '\0';
+        session.close(); // the rest of the body is still on the connection
+        return false;
+      }
+      // trim the whitespace around the number
+      size_t start = strspn(number, " \t\r\n");
+      size_t length = strcspn(number + start, " \t\r\n");
+      memmove(number, number + start, length);
+      number[length] = '\0';
       // Print the API response
-      response = http.getString();
-      Serial.println(response);
+      Serial.println(number);
       
     } else {
       Serial.print("[HTTP] Error code: ");
@@ -427,8 +717,8 @@ String TimelineManager::getTimelineNumber() {
     
   }
 
-  http.end();
-  return response;
+  session.end();
+  return number[0] != '\0';
 }
 
 /**
@@ -438,24 +728,22 @@ String TimelineManager::getTimelineNumber() {
  * total number of timelines. It uses the provided client object and server
  * authentication token for communication.
  * 
- * @return String containing the API response with the total number of timelines.
- *         An empty string is returned if the request fails.
+ * @return The total number of timelines, 0 if the request fails.
  */
-String TimelineManager::getTotalTimelines(){
+int TimelineManager::getTotalTimelines(){
   Serial.println("getTotalTimelines called");
-  String token = readJWTTokenFromFile();
-  HTTPClient http;
-  http.begin(client, "http://" + String(serverIP) + "/lite/api/get-current-timeline-number"); //localhost url
-  // http.begin(client, "http://magicpoi.circusscientist.com/lite/api/get-total-timelines"); //todo: delete hard coding
-  http.addHeader("Authorization", "Bearer " + String(token));
-
-  // Send the GET request and receive HTTP response code
-  int httpCode = http.GET();
-  String response = "";
+  int httpCode = apiGet("/lite/api/get-current-timeline-number"); //localhost url
+  // magicpoi.circusscientist.com uses /lite/api/get-total-timelines - todo: delete hard coding
+
+  char response[12] = "";
   if (httpCode > 0) {
     if (httpCode == HTTP_CODE_OK) {
       // Read the API response content
-      response = http.getString();
+      if (session.readBody(response, sizeof(response)) < 0) {
+        Serial.println("Total timelines missing or too long.");
+        session.close(); // the rest of the body is still on the connection
+        return 0;
+      }
       Serial.println(response);
       
     } else {
@@ -470,49 +758,78 @@ String TimelineManager::getTotalTimelines(){
     
   }
 
-  http.end();
+  session.end();
 
-  return response; 
+  return atoi(response); 
 }
 
-void TimelineManager::getTimeline(String tln) {
-  String timelineFilePath = "/timeline" + tln + ".txt";
-  String token = readJWTTokenFromFile();
-  Serial.println("downloading timeline number: " + tln);
-  HTTPClient http;
-  http.begin(client, "http://" + String(serverIP) + "/lite/api/load-timeline?number=" + tln); //localhost
-  // http.begin(client, "http://magicpoi.circusscientist.com/lite/api/load-timeline?number=" + tln); todo: delete hard coding
-  http.addHeader("Authorization", "Bearer " + String(token));
-
-  Serial.println("[HTTP] GET...");
-  int httpCode = http.GET();
-  String response = "";
-  // httpCode will be negative on error
+/**
+ * @brief Fetches the timeline manifest from the magic poi server.
+ *
+ * The manifest lists every timeline with its version, as a JSON object of the form
+ * `{"<number>": "<version>", ...}`. The version is a content hash or revision number, so
+ * a local mirror serving the same timelines serves the same manifest.
+ *
+ * @param manifest Receives the manifest, parsed straight from the connection so the
+ *                 response is never held in RAM as text.
+ *
+ * @return `false` if the request fails, e.g. on servers without the manifest endpoint, or
+ *         the response is not a JSON object.
+ *
+ * @see TimelineSync - Compares the manifest with the TimelineCatalog and downloads only
+ *      the timelines that changed.
+ */
+bool TimelineManager::getManifest(JsonDocument& manifest){
+  int httpCode = apiGet("/lite/api/timeline-manifest");
+  bool received = false;
   if (httpCode > 0) {
     if (httpCode == HTTP_CODE_OK) {
-      // Print the API response
-      // DynamicJsonDocument led_doc(1500);
-      String payload = http.getString();
-      saveTimeline(payload, timelineFilePath);
-      delay(10);
-      loadTimeline(tln); //todo: don't do this every time, for multiple loads! 
-      
-    //   already_got_data = true; //todo: global, need to return and do in main 
-    //   digitalWrite(led, LOW); //todo: global, need to return and do in main 
-      
+      received = !deserializeJson(manifest, session) && manifest.is<JsonObject>();
+      if (!received) {
+        Serial.println("Failed to parse manifest.");
+      }
     } else {
       Serial.print("[HTTP] Error code: ");
       Serial.println(httpCode);
-      // gotToken=false;
-      
     }
   } else {
     Serial.println("Connection failed.");
-    // gotToken=false;
   }
 
-  http.end();
-  
+  if (received) {
+    session.end();
+  } else {
+    session.close(); // the body may not have been read to the end
+  }
+  return received;
+}
+
+/**
+ * @brief Starts an authorised GET request for a timeline.
+ *
+ * On `HTTP_CODE_OK` the response body is left unread in `apiSession().http()` for a
+ * TimelineDownload. The caller must call `apiSession().end()` when it has read the whole
+ * body, or `apiSession().close()` if it gave up.
+ *
+ * @param tln The number of the timeline to request.
+ *
+ * @return The HTTP status code, negative if the connection failed.
+ */
+int TimelineManager::requestTimeline(const char* tln) {
+  Serial.print("downloading timeline number: ");
+  Serial.println(tln);
+  char path[API_URL_SIZE];
+  TextBuffer pathText(path, sizeof(path));
+  pathText.format("/lite/api/load-timeline?number=%s", tln);
+  int httpCode = apiGet(path);
+  // httpCode will be negative on error
+  if (httpCode <= 0) {
+    Serial.println("Connection failed.");
+  } else if (httpCode != HTTP_CODE_OK) {
+    Serial.print("[HTTP] Error code: ");
+    Serial.println(httpCode);
+  }
+  return httpCode;
 }
 
 /**
@@ -520,35 +837,53 @@ void TimelineManager::getTimeline(String tln) {
  *
  * This function sends an HTTP GET request to a remote server to retrieve a timeline
  * identified by its number. The timeline data is saved to a file and can be loaded
- * using the `loadTimeline` function.
+ * using the `loadTimeline` function. The timeline that is playing is not changed.
  *
  * @param tln The number of the timeline to be retrieved.
  *
  * @note This function relies on external HTTP communication and assumes the availability
  *       of the server at the specified URL.
- * @note It first reads the JWT token from a file using the `readJWTTokenFromFile`
- *       function to include in the HTTP request's authorization header.
+ * @note It logs in first if there is no valid JWT token in RAM.
  * @note If the HTTP request is successful (HTTP_CODE_OK), the received timeline data is
  *       saved to a file and can be loaded later.
  * @note In case of any errors or a failed HTTP request, this function handles errors and
  *       does not load the timeline data.
  *
- * @see readJWTTokenFromFile() - Used to obtain the JWT token for authentication.
- * @see saveTimeline(const String& timelineData, String timelineFilePath) - Used to save
- *        the received timeline data to a file.
- * @see loadTimeline(String timelineNumber) - Used to load the timeline data after it has
- *        been saved.
+ * @see saveTimeline(HTTPClient& http, const char* timelineNumber) - Used to stream
+ *        the received timeline data into a binary file.
+ * @see TimelineSync - Does the same without blocking `loop()`.
+ */
+void TimelineManager::getTimeline(const char* tln) {
+  if (!gotTokenTrue() && !authenticate()) {
+    return;
+  }
+  int httpCode = requestTimeline(tln);
+  if (httpCode == HTTP_CODE_OK && saveTimeline(session.http(), tln)) { // parsed straight from the stream and converted to binary once, here
+    session.end();
+  } else {
+    session.close();
+  }
+}
+
+/**
+ * @brief Retrieves and saves every timeline from the remote server.
+ *
+ * @note Blocks until all downloads have finished; see TimelineSync for the version used by
+ *       `loop()`.
  */
 void TimelineManager::getAllTimelines(){
-  int number_of_timelines = getTotalTimelines().toInt();
-  Serial.println("number_of_timelines: " + String(number_of_timelines));
+  int number_of_timelines = getTotalTimelines();
+  Serial.print("number_of_timelines: ");
+  Serial.println(number_of_timelines);
   if(number_of_timelines > 10){
     number_of_timelines = 10; //limit number, can be removed
   }
   for(int i = 1; i < number_of_timelines; i++){
     
-    String timelineNumberString = String(i);
-    Serial.println("should be downloading timeline number: " + timelineNumberString);
+    char timelineNumberString[12];
+    snprintf(timelineNumberString, sizeof(timelineNumberString), "%d", i);
+    Serial.print("should be downloading timeline number: ");
+    Serial.println(timelineNumberString);
     getTimeline(timelineNumberString);
   }
 }
@@ -564,23 +899,21 @@ void TimelineManager::getAllTimelines(){
  *       starts to potentially avoid the need for re-authentication.
  * @note It reads the saved token from a file using the `readJWTTokenFromFile` function.
  * @note If a saved token is successfully loaded, it is copied into the `token` array for
- *       further use.
+ *       further use; API calls use that copy and never read the file again.
  * @note The `gotToken` flag is set to `true` if a saved token is found and loaded.
  */
 void TimelineManager::updateToken(){
   Serial.println("updating jwt token?");
-  String savedToken = readJWTTokenFromFile();
-  if (!savedToken.isEmpty()) {
-    strncpy(token, savedToken.c_str(), sizeof(token) - 1);
-    token[sizeof(token) - 1] = '\0'; // Null-terminate the token string
-    // strncpy(jwtToken, savedToken.c_str(), sizeof(jwtToken) - 1);
-    // jwtToken[sizeof(jwtToken) - 1] = '\0'; // Null-terminate the token string
-    gotToken = true;
-    Serial.println("Using saved JWT token:");
-    Serial.println(token);
+  char savedToken[sizeof(token)];
+  if (readJWTTokenFromFile(savedToken, sizeof(savedToken))) {
+    tokenFresh = false; // issued at an unknown time, expiry only known once the server's clock is
+    if (setTokenValue(savedToken, false)) {
+      Serial.println("Using saved JWT token:");
+      Serial.println(token);
+    }
   }
   // globaltimelineData = loadTimeline(); //todo: if there is timeline already in timeline.txt then none of loop will run currently
-//todo: need a websocket GUI interface to turn this on again
+// switching timelines from a GUI: see LiveControl
 }
 
 /**
@@ -610,12 +943,20 @@ void TimelineManager::setAlreadyGotData(bool setting){
 /**
  * @brief Checks if an authentication token has been obtained.
  *
- * This function returns `true` if an authentication token has been obtained; otherwise,
- * it returns `false`.
+ * This function returns `true` if an authentication token has been obtained and is not
+ * about to expire; otherwise, it returns `false`.
  *
  * @return `true` if an authentication token has been obtained; `false` otherwise.
+ *
+ * @note A token within `JWT_REFRESH_MARGIN` seconds of its `exp` claim counts as expired,
+ *       so the device logs in again before a request fails.
  */
 bool TimelineManager::gotTokenTrue(){
+  long remaining;
+  if (gotToken && tokenTimeRemaining(remaining) && remaining <= JWT_REFRESH_MARGIN) {
+    Serial.println("JWT token about to expire, will re-authenticate.");
+    gotToken = false;
+  }
   return gotToken;
 }
 
@@ -631,14 +972,78 @@ void TimelineManager::setToken(bool setting){
   gotToken = setting;
 }
 
+/**
+ * @brief Gives access to the cache of recently played timelines, e.g. for its counters.
+ *
+ * @return The TimelineCache used by `loadTimeline()`.
+ */
+TimelineCache& TimelineManager::timelineCache(){
+  return cache;
+}
+
+/**
+ * @brief Gives access to the shared keep-alive connection to the server, e.g. for its
+ *        latency counters.
+ *
+ * @return The ApiSession used by every API call.
+ */
+ApiSession& TimelineManager::apiSession(){
+  return session;
+}
+
+/**
+ * @brief Gives access to the catalog of timeline versions stored on flash.
+ *
+ * @return The TimelineCatalog used by TimelineSync and `clearTimeline()`.
+ */
+TimelineCatalog& TimelineManager::timelineCatalog(){
+  return catalog;
+}
+
 /**
  * @brief Sets the flag indicating whether playback is in progress.
  *
  * This function allows you to set the `playing` flag, which indicates whether playback
- * of timeline data is in progress.
+ * of timeline data is in progress. Stopping holds the colour showing and the point in
+ * the timeline; starting again carries on from that point.
  *
  * @param setting The value to set for the `playing` flag (`true` or `false`).
  */
 void TimelineManager::setPlaying(bool setting){
+  if (setting == playing) {
+    return;
+  }
+  if (!setting) {
+    pausedAt = loopLength > 0 ? (long)(playbackTime() - playStartTime) % loopLength : 0;
+  } else {
+    playStartTime = playbackTime() - pausedAt;
+  }
   playing = setting;
+}
+
+/**
+ * @brief Plays timelines on a clock shared with other poi instead of on `millis()`.
+ *
+ * Once the clock is synced, passes through the timeline start at whole multiples of its
+ * length on the shared clock, so poi playing the same timeline stay in phase.
+ *
+ * @param clock The ClockSync to follow, or `nullptr` for `millis()`. It must outlive this
+ *              TimelineManager.
+ */
+void TimelineManager::setClock(ClockSync* clock){
+  this->clock = clock;
+  clockLocks = 0;
+}
+
+/**
+ * @brief Plays timelines that have a scheduled start from that time on an SNTP clock.
+ *
+ * @param wallClock The WallClock to use, or `nullptr` to ignore schedules. It must outlive
+ *                  this TimelineManager.
+ *
+ * @see TimelineCatalog::start() - Where the schedule from the manifest is kept.
+ */
+void TimelineManager::setWallClock(WallClock* wallClock){
+  this->wallClock = wallClock;
+  wallSyncs = 0;
 }
\ No newline at end of file
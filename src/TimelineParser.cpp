@@ -0,0 +1,236 @@
+#include "TimelineParser.h"
+
+/**
+ * @brief Constructs a parser that passes each parsed event to `sink`.
+ *
+ * @param sink Receives every complete (timing, r, g, b) event, e.g. a TimelineWriter.
+ */
+TimelineParser::TimelineParser(TimelineEventSink& sink) : sink(sink) {
+}
+
+/**
+ * @brief Returns the parser to its initial state, ready for a new document.
+ */
+void TimelineParser::reset() {
+  state = ExpectObject;
+  eventCount = 0;
+}
+
+/**
+ * @brief Feeds one byte of JSON to the parser.
+ *
+ * @param c The next character of the document.
+ *
+ * @return 1, so the parser can be used as a Print target. Bytes after the closing brace or
+ *         after a syntax error are ignored.
+ *
+ * @note Keys that do not start with a digit (and their values) are skipped. Keys that
+ *       start with one but are not plain numbers or are too long for a timing, and colour
+ *       values with anything but digits in them or above 255, fail the document.
+ */
+size_t TimelineParser::write(uint8_t c) {
+  bool whitespace = c == ' ' || c == '\t' || c == '\r' || c == '\n';
+
+  switch (state) {
+    case ExpectObject:
+      if (c == '{') {
+        state = ExpectKey;
+      } else if (!whitespace) {
+        state = Failed;
+      }
+      break;
+
+    case ExpectKey:
+      if (c == '"') {
+        keyTiming = 0;
+        keyNumeric = true;
+        keyDigits = 0;
+        state = InKey;
+      } else if (c == '}') {
+        state = Done;
+      } else if (!whitespace) {
+        state = Failed;
+      }
+      break;
+
+    case InKey:
+      if (c == '"') {
+        keyNumeric = keyNumeric && keyDigits > 0;
+        state = keyNumeric && keyDigits > PARSER_MAX_KEY_DIGITS ? Failed : ExpectColon;
+      } else if (c >= '0' && c <= '9') {
+        if (keyDigits <= PARSER_MAX_KEY_DIGITS) {
+          keyTiming = keyTiming * 10 + (c - '0');
+          keyDigits++;
+        }
+      } else if (keyNumeric && keyDigits > 0) {
+        state = Failed; // a timing with something else in it, e.g. "1.5"
+      } else {
+        keyNumeric = false;
+      }
+      break;
+
+    case ExpectColon:
+      if (c == ':') {
+        state = ExpectValue;
+      } else if (!whitespace) {
+        state = Failed;
+      }
+      break;
+
+    case ExpectValue:
+      if (whitespace) {
+        break;
+      }
+      if (c == '[' && keyNumeric) {
+        valueIndex = 0;
+        currentValue = 0;
+        valueDigits = false;
+        valueEnded = false;
+        state = InArray;
+      } else {
+        // not an event: skip whatever value this is
+        skipDepth = 0;
+        skipInString = false;
+        skipEscape = false;
+        state = SkipValue;
+        write(c);
+      }
+      break;
+
+    case InArray:
+      if (c >= '0' && c <= '9') {
+        if (valueEnded) {
+          state = Failed; // e.g. "1 5"
+          break;
+        }
+        currentValue = currentValue * 10 + (c - '0');
+        if (currentValue > 255) {
+          state = Failed; // not a colour level
+          break;
+        }
+        valueDigits = true;
+      } else if (c == ',') {
+        finishValue();
+      } else if (c == ']') {
+        finishValue();
+        emitEvent();
+        if (state != Failed) {
+          state = ExpectComma;
+        }
+      } else if (whitespace || c == '"') {
+        valueEnded = valueDigits; // whitespace and quotes around numbers are allowed
+      } else {
+        state = Failed; // '.', '-', 'e' and so on: not a colour value
+      }
+      break;
+
+    case SkipValue:
+      if (skipInString) {
+        if (skipEscape) {
+          skipEscape = false;
+        } else if (c == '\\') {
+          skipEscape = true;
+        } else if (c == '"') {
+          skipInString = false;
+        }
+      } else if (c == '"') {
+        skipInString = true;
+      } else if (c == '[' || c == '{') {
+        skipDepth++;
+      } else if ((c == ']' || c == '}') && skipDepth > 0) {
+        skipDepth--;
+      } else if (skipDepth == 0 && (c == ',' || c == '}')) {
+        state = ExpectComma;
+        write(c);
+      }
+      break;
+
+    case ExpectComma:
+      if (c == ',') {
+        state = ExpectKey;
+      } else if (c == '}') {
+        state = Done;
+      } else if (!whitespace) {
+        state = Failed;
+      }
+      break;
+
+    case Done:
+    case Failed:
+      break;
+  }
+  return 1;
+}
+
+/**
+ * @brief Feeds a block of JSON to the parser.
+ *
+ * @param data The next bytes of the document.
+ * @param length Number of bytes in `data`.
+ *
+ * @return `length`.
+ */
+size_t TimelineParser::write(const uint8_t* data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    write(data[i]);
+  }
+  return length;
+}
+
+/**
+ * @brief Returns `true` once the closing brace of the document has been parsed.
+ */
+bool TimelineParser::done() {
+  return state == Done;
+}
+
+/**
+ * @brief Returns `true` if the document was not valid timeline JSON.
+ */
+bool TimelineParser::failed() {
+  return state == Failed;
+}
+
+/**
+ * @brief Number of events passed to the sink so far.
+ */
+uint16_t TimelineParser::count() {
+  return eventCount;
+}
+
+/**
+ * @brief Stores the number just parsed as the next colour value.
+ */
+void TimelineParser::finishValue() {
+  if (valueDigits && valueIndex < 3) {
+    values[valueIndex++] = currentValue;
+  }
+  currentValue = 0;
+  valueDigits = false;
+  valueEnded = false;
+}
+
+/**
+ * @brief Passes the completed event to the sink.
+ *
+ * Missing colour values are treated as 0. The first value selects the pattern.
+ */
+void TimelineParser::emitEvent() {
+  if (valueIndex == 0) {
+    return;
+  }
+  while (valueIndex < 3) {
+    values[valueIndex++] = 0;
+  }
+  TimelineRecord record;
+  record.timing = keyTiming;
+  record.pattern = values[0];
+  record.red = values[0];
+  record.green = values[1];
+  record.blue = values[2];
+  if (sink.onEvent(record)) {
+    eventCount++;
+  } else {
+    state = Failed;
+  }
+}
@@ -0,0 +1,295 @@
+#include "TimelineSync.h"
+
+TimelineSync::TimelineSync(TimelineManager& manager) : manager(manager) {
+}
+
+/**
+ * @brief Starts a sync, unless one is already running.
+ *
+ * @param fetchActiveNumber Whether to ask the server which timeline is active (see
+ *                          `activeNumber()`).
+ */
+void TimelineSync::start(bool fetchActiveNumber) {
+  if (busy()) {
+    return;
+  }
+  this->fetchActiveNumber = fetchActiveNumber;
+  heapAtStart = ESP.getFreeHeap();
+  serverNumber[0] = '\0';
+  totalTimelines = 0;
+  pendingCount = 0;
+  nextPending = 0;
+  failures = 0;
+  if (!manager.gotTokenTrue()) {
+    state = Authenticate;
+  } else {
+    state = fetchActiveNumber ? GetNumber : GetManifest;
+  }
+}
+
+/**
+ * @brief Does one bounded slice of the sync. Call once per `loop()`.
+ *
+ * @note Does nothing unless a sync has been started.
+ */
+void TimelineSync::step() {
+  switch (state) {
+    case Authenticate:
+      if (!manager.authenticate()) {
+        fail("Authentication failed.");
+        break;
+      }
+      state = fetchActiveNumber ? GetNumber : GetManifest;
+      break;
+
+    case GetNumber:
+      if (!manager.getTimelineNumber(serverNumber, sizeof(serverNumber))) {
+        manager.setToken(false); // most likely an expired token, log in again next time
+        fail("no timelineNumber available in loop?");
+        break;
+      }
+      Serial.print("got timeline number in loop: ");
+      Serial.println(serverNumber);
+      state = GetManifest;
+      break;
+
+    case GetManifest: {
+      DynamicJsonDocument manifest(SYNC_MANIFEST_CAPACITY);
+      state = manager.getManifest(manifest) && readManifest(manifest) ? RequestTimeline : GetTotal;
+      break;
+    }
+
+    case GetTotal: // no manifest: download everything
+      totalTimelines = manager.getTotalTimelines();
+      Serial.print("number_of_timelines: ");
+      Serial.println(totalTimelines);
+      if (totalTimelines > SYNC_MAX_TIMELINES) {
+        totalTimelines = SYNC_MAX_TIMELINES; //limit number, can be removed
+      }
+      for (int i = 1; i <= totalTimelines; i++) {
+        char number[12];
+        snprintf(number, sizeof(number), "%d", i);
+        queue(number, "");
+      }
+      if (serverNumber[0] != '\0') {
+        queue(serverNumber, "");
+      }
+      state = RequestTimeline;
+      break;
+
+    case RequestTimeline:
+      requestNext();
+      break;
+
+    case Download:
+      switch (download.step()) {
+        case TimelineDownload::Busy:
+          break;
+        case TimelineDownload::Done:
+          manager.apiSession().end();
+          manager.installTimeline(download.number());
+          if (pending[nextPending - 1].version[0] != '\0') {
+            manager.timelineCatalog().set(download.number(), pending[nextPending - 1].version);
+          } else {
+            manager.timelineCatalog().remove(download.number()); // version unknown
+          }
+          manager.timelineCatalog().save();
+          state = RequestTimeline;
+          break;
+        default:
+          manager.apiSession().close(); // body not read to the end
+          failures++;
+          state = RequestTimeline;
+          break;
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Returns `true` while a sync is in progress.
+ */
+bool TimelineSync::busy() {
+  return state != Idle && state != Done && state != Failed;
+}
+
+/**
+ * @brief Returns `true` once after a sync has finished.
+ *
+ * @note Individual timelines that failed to download are counted in `downloadFailures()`.
+ */
+bool TimelineSync::finished() {
+  if (state != Done) {
+    return false;
+  }
+  state = Idle;
+  return true;
+}
+
+/**
+ * @brief Returns `true` once after a sync has been given up (no login or timeline number).
+ */
+bool TimelineSync::failed() {
+  if (state != Failed) {
+    return false;
+  }
+  state = Idle;
+  return true;
+}
+
+/**
+ * @brief The active timeline number reported by the server, empty if it was not fetched.
+ */
+const char* TimelineSync::activeNumber() {
+  return serverNumber;
+}
+
+/**
+ * @brief The number of timelines on the server, as of the last sync.
+ *
+ * @note With a manifest this is the highest timeline number it lists.
+ */
+int TimelineSync::total() {
+  return totalTimelines;
+}
+
+/**
+ * @brief Number of timelines that failed to download in the last sync.
+ */
+uint8_t TimelineSync::downloadFailures() {
+  return failures;
+}
+
+/**
+ * @brief Free heap at the end of the last sync less the free heap at its start, in bytes.
+ *
+ * Negative if the sync left memory allocated. The first sync opens the keep-alive
+ * connection, which stays allocated; after that a sync should come to zero.
+ */
+int32_t TimelineSync::heapChange() {
+  return heapChanged;
+}
+
+/**
+ * @brief Queues the timelines in the server's manifest that are missing or out of date.
+ *
+ * @param manifest The manifest from TimelineManager::getManifest(), a JSON object of the
+ *                 form `{"<number>": "<version>", ...}`. An entry can also be
+ *                 `{"version": "<version>", "start": <unix time ms>}` to schedule the
+ *                 timeline to start at a set time.
+ *
+ * @return `false` if there is no valid manifest, so every timeline should be downloaded.
+ */
+bool TimelineSync::readManifest(JsonDocument& manifest) {
+  JsonObject timelines = manifest.as<JsonObject>();
+  // the active timeline first, so it can be activated as soon as possible
+  if (serverNumber[0] != '\0' && timelines.containsKey(serverNumber)) {
+    readManifestEntry(serverNumber, timelines[serverNumber]);
+  }
+  for (JsonPair timeline : timelines) {
+    const char* number = timeline.key().c_str();
+    int numeric = atoi(number);
+    if (numeric > totalTimelines) {
+      totalTimelines = numeric;
+    }
+    if (strcmp(serverNumber, number) == 0) {
+      continue;
+    }
+    readManifestEntry(number, timeline.value());
+  }
+  manager.timelineCatalog().save(); // scheduled starts, if any changed
+  Serial.print("Timelines in manifest: ");
+  Serial.print(timelines.size());
+  Serial.print(", changed: ");
+  Serial.println(pendingCount);
+  return true;
+}
+
+/**
+ * @brief Records the scheduled start of one manifest entry and queues the timeline if it
+ *        is out of date.
+ */
+void TimelineSync::readManifestEntry(const char* number, JsonVariant entry) {
+  JsonVariant version = entry;
+  uint64_t start = 0;
+  if (entry.is<JsonObject>()) {
+    version = entry["version"];
+    start = (uint64_t)(entry["start"] | 0.0); // a double holds any Unix time in ms exactly
+  }
+  char revision[12]; // a numeric version, as text
+  const char* text = "";
+  if (version.is<const char*>()) {
+    text = version.as<const char*>();
+  } else if (!version.isNull()) {
+    snprintf(revision, sizeof(revision), "%ld", version.as<long>());
+    text = revision;
+  }
+
+  TimelineCatalog& catalog = manager.timelineCatalog();
+  catalog.setStart(number, start);
+  if (!catalog.upToDate(number, text)) {
+    queue(number, text);
+  }
+}
+
+/**
+ * @brief Adds a timeline to the download queue, unless it is already queued or the queue
+ *        is full.
+ *
+ * @param number The number of the timeline.
+ * @param version Its version from the manifest, or empty.
+ */
+void TimelineSync::queue(const char* number, const char* version) {
+  if (pendingCount >= SYNC_MAX_TIMELINES || strlen(number) >= sizeof(pending[0].number)
+      || strlen(version) >= sizeof(pending[0].version)) {
+    return;
+  }
+  for (uint8_t i = 0; i < pendingCount; i++) {
+    if (strcmp(pending[i].number, number) == 0) {
+      return;
+    }
+  }
+  strcpy(pending[pendingCount].number, number);
+  strcpy(pending[pendingCount].version, version);
+  pendingCount++;
+}
+
+/**
+ * @brief Requests the next queued timeline, or finishes the sync once all have been
+ *        downloaded.
+ */
+void TimelineSync::requestNext() {
+  if (nextPending >= pendingCount) {
+    Serial.print("Timeline sync finished, downloaded: ");
+    Serial.print(pendingCount - failures);
+    Serial.print(", failed: ");
+    Serial.print(failures);
+    heapChanged = (int32_t)(ESP.getFreeHeap() - heapAtStart);
+    Serial.print(", heap change: ");
+    Serial.print(heapChanged);
+    Serial.print(" bytes, fragmentation: ");
+    Serial.print(ESP.getHeapFragmentation());
+    Serial.println("%");
+    state = Done;
+    return;
+  }
+
+  const char* number = pending[nextPending++].number;
+  if (manager.requestTimeline(number) == HTTP_CODE_OK && download.begin(manager.apiSession().http(), number)) {
+    state = Download;
+  } else {
+    manager.apiSession().close();
+    failures++;
+  }
+}
+
+/**
+ * @brief Gives up on the sync and logs why.
+ */
+void TimelineSync::fail(const char* reason) {
+  Serial.println(reason);
+  state = Failed;
+}
@@ -0,0 +1,180 @@
+#include "TimelineUpload.h"
+
+TimelineUpload::TimelineUpload() : parser(compiler) {
+  timelineNumber[0] = '\0';
+}
+
+/**
+ * @brief Starts receiving a timeline, abandoning any upload still in progress.
+ *
+ * @param timelineNumber The number to save it as, used to build the file paths.
+ *
+ * @return `false` if the number is too long, or the filesystem could not be mounted or the
+ *         staging file created.
+ */
+bool TimelineUpload::begin(const char* timelineNumber) {
+  abort();
+  if (strlen(timelineNumber) == 0 || strlen(timelineNumber) >= sizeof(this->timelineNumber)) {
+    state = Failed;
+    return false;
+  }
+  strcpy(this->timelineNumber, timelineNumber);
+  if (!storage.begin() || !compiler.begin(timelineNumber)) {
+    state = Failed;
+    return false;
+  }
+  parser.reset();
+  started = millis();
+  lastData = started;
+  took = 0;
+  state = Receiving;
+  return true;
+}
+
+/**
+ * @brief Parses the next piece of the body, staging its events on flash.
+ *
+ * @return `false` once the upload has failed, e.g. on invalid JSON or a full filesystem.
+ */
+bool TimelineUpload::write(const uint8_t* data, size_t length) {
+  if (state != Receiving) {
+    return false;
+  }
+  parser.write(data, length);
+  lastData = millis();
+  if (parser.failed()) {
+    compiler.abort();
+    fail("Timeline upload invalid, not saved.");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Marks the body as complete; `step()` then compiles it.
+ *
+ * @return `false` if the body was not a whole timeline.
+ */
+bool TimelineUpload::end() {
+  if (state != Receiving) {
+    return false;
+  }
+  if (!parser.done()) {
+    compiler.abort();
+    fail("Timeline upload incomplete, not saved.");
+    return false;
+  }
+  state = Received;
+  return true;
+}
+
+/**
+ * @brief Does one bounded slice of the work: sorts one run of out-of-order events, merges
+ *        or compiles up to `UPLOAD_SLICE_EVENTS` events, or gives up on a body that has
+ *        stopped arriving.
+ *
+ * @return `Sorting` or `Compiling` until the binary file has been written (`Done`) or the
+ *         upload has been given up (`Failed`, leaving no file behind). `Receiving` while the
+ *         body is still arriving.
+ */
+TimelineUpload::Status TimelineUpload::step() {
+  if (state == Receiving) {
+    if (millis() - lastData > UPLOAD_TIMEOUT) {
+      compiler.abort();
+      return fail("Timeline upload timed out.");
+    }
+    return state;
+  }
+  if (state == Received) {
+    if (!compiler.startCompile()) {
+      return fail("Timeline upload could not be compiled, not saved.");
+    }
+    state = compiler.sorting() ? Sorting : Compiling;
+    return state;
+  }
+  if (state == Sorting) {
+    bool sorted = false;
+    if (!compiler.sortStep(UPLOAD_SLICE_EVENTS, sorted)) {
+      return fail("Timeline upload could not be sorted, not saved.");
+    }
+    if (sorted) {
+      state = Compiling;
+    }
+    return state;
+  }
+  if (state != Compiling) {
+    return state;
+  }
+
+  bool finished = false;
+  if (!compiler.compileStep(UPLOAD_SLICE_EVENTS, finished)) {
+    return fail("Timeline upload could not be compiled, not saved.");
+  }
+  if (finished) {
+    took = millis() - started;
+    Serial.print("Timeline ");
+    Serial.print(timelineNumber);
+    Serial.print(" uploaded, events received: ");
+    Serial.print(parser.count());
+    Serial.print(", compiled: ");
+    Serial.print(compiler.count());
+    Serial.print(", in ms: ");
+    Serial.println(took);
+    state = Done;
+  }
+  return state;
+}
+
+/**
+ * @brief Gives up on an upload in progress, leaving no file behind.
+ */
+void TimelineUpload::abort() {
+  if (state == Receiving || state == Received || state == Sorting || state == Compiling) {
+    compiler.abort();
+    state = Failed;
+  }
+}
+
+/**
+ * @brief Where the last upload has got to.
+ */
+TimelineUpload::Status TimelineUpload::status() {
+  return state;
+}
+
+/**
+ * @brief The number the timeline is being saved as.
+ */
+const char* TimelineUpload::number() {
+  return timelineNumber;
+}
+
+/**
+ * @brief Number of events parsed from the body so far.
+ */
+uint16_t TimelineUpload::received() {
+  return parser.count();
+}
+
+/**
+ * @brief Number of events in the compiled timeline.
+ */
+uint16_t TimelineUpload::compiled() {
+  return compiler.count();
+}
+
+/**
+ * @brief Milliseconds from the start of the upload to the compiled file, 0 until `Done`.
+ */
+unsigned long TimelineUpload::duration() {
+  return took;
+}
+
+/**
+ * @brief Logs why the upload was given up and marks it failed.
+ */
+TimelineUpload::Status TimelineUpload::fail(const char* reason) {
+  Serial.println(reason);
+  state = Failed;
+  return state;
+}
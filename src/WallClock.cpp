@@ -0,0 +1,72 @@
+#include "WallClock.h"
+#include <time.h>
+#include <sys/time.h>
+#include <coredecls.h>
+#include <sntp.h>
+
+static volatile uint16_t syncCount = 0; // times SNTP has set the clock, see WallClock::syncs()
+
+/**
+ * @brief Starts SNTP. The clock is valid once the first reply has arrived.
+ *
+ * @param server The NTP server's hostname or IP address.
+ *
+ * @note Needs Wi-Fi to be connected. Calling it again once started does nothing.
+ */
+void WallClock::begin(const char* server) {
+  if (isStarted) {
+    return;
+  }
+  settimeofday_cb([]() { syncCount++; });
+  configTime(0, 0, server); // UTC; schedules are in Unix time
+  isStarted = true;
+  Serial.print("SNTP started with server ");
+  Serial.println(server);
+}
+
+/**
+ * @brief Stops SNTP, e.g. while the Wi-Fi modem is off. `begin()` starts it again.
+ *
+ * @note The system clock keeps running, so `valid()` and `epochMillis()` still work, only
+ *       without the hourly correction.
+ */
+void WallClock::stop() {
+  if (!isStarted) {
+    return;
+  }
+  sntp_stop();
+  isStarted = false;
+  Serial.println("SNTP stopped.");
+}
+
+/**
+ * @brief Returns `true` once `begin()` has been called.
+ */
+bool WallClock::started() {
+  return isStarted;
+}
+
+/**
+ * @brief Returns `true` once SNTP has set the clock.
+ */
+bool WallClock::valid() {
+  return time(nullptr) >= (time_t)WALL_CLOCK_MIN_EPOCH;
+}
+
+/**
+ * @brief The current Unix time in milliseconds.
+ *
+ * @note Meaningless until `valid()` returns `true`.
+ */
+uint64_t WallClock::epochMillis() {
+  struct timeval now;
+  gettimeofday(&now, nullptr);
+  return (uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+/**
+ * @brief Number of times SNTP has set the clock; the clock may step each time this changes.
+ */
+uint16_t WallClock::syncs() {
+  return syncCount;
+}
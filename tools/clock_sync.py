@@ -0,0 +1,371 @@
+#!/usr/bin/env python3
+"""Host-side leader and follower for the poi clock sync protocol (see include/ClockSync.h),
+and a check of the firmware's own follower.
+
+Run a leader on a computer so every poi on the LAN follows its clock:
+
+    python3 tools/clock_sync.py leader
+
+Check the firmware's follower with no hardware: run a leader on loopback and two or more
+native builds of the firmware (pio run -e native) as followers, each on the real clock with
+its own address, clock offset and drift (--clock-offset, --clock-drift), and report how far
+each one's shared clock is from the leader's:
+
+    python3 tools/clock_sync.py check --followers 3 --duration 60
+
+Each follower is asked for its clock (the `clock` serial command) every second, and the
+shared clock it prints is compared with the leader's at the moment the line is read. The
+leader's clock is the host's monotonic clock, so this includes the few tens of us a line
+takes to come through the pipe. Errors are taken once a follower has been locked --settle
+seconds, and the check fails if any follower never locks or is ever more than --tolerance-ms
+out.
+
+With --leader, a native build with CLOCK_SYNC_LEADER true leads instead, and its own
+`clock` readings stand for its clock. The `loop` report at the end says how many passes a
+second it woke for and how long it slept, the power side of CLOCK_LEADER_MAX_SLEEP:
+
+    pio run -e native_leader
+    python3 tools/clock_sync.py check --leader .pio/build/native_leader/program --followers 3
+
+`follower` follows a leader from a computer, e.g. to watch the offset to a poi that leads.
+It is a Python copy of the firmware's follower, with the constants read from
+include/ClockSync.h, and is not a test of the firmware; `check` is.
+"""
+
+import argparse
+import os
+import re
+import select
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+HEADER = os.path.join(HERE, "..", "include", "ClockSync.h")
+DEFAULT_FIRMWARE = os.path.join(HERE, "..", ".pio", "build", "native", "program")
+
+
+def firmware_constants():
+    """The CLOCK_* numbers defined in include/ClockSync.h, so this copy stays in step."""
+    constants = {}
+    try:
+        with open(HEADER) as f:
+            for line in f:
+                match = re.match(r"#define (CLOCK_\w+) (0x[0-9A-Fa-f]+|\d+)\b", line)
+                if match:
+                    constants[match.group(1)] = int(match.group(2), 0)
+    except OSError:
+        pass  # the tool copied away from the tree: the values below
+    return constants
+
+
+FIRMWARE = firmware_constants()
+PORT = FIRMWARE.get("CLOCK_SYNC_PORT", 4210)
+MAGIC = FIRMWARE.get("CLOCK_SYNC_MAGIC", 0x5343504D)  # "MPCS"
+VERSION = FIRMWARE.get("CLOCK_SYNC_VERSION", 1)
+BEACON, REQUEST, RESPONSE = 1, 2, 3
+PACKET = struct.Struct("<IBBHQQQ")  # magic, version, type, sequence, originate, receive, transmit
+
+SAMPLES = FIRMWARE.get("CLOCK_SYNC_SAMPLES", 8)
+MIN_SAMPLES = FIRMWARE.get("CLOCK_SYNC_MIN_SAMPLES", 4)
+MAX_DELAY = FIRMWARE.get("CLOCK_SYNC_MAX_DELAY", 10000)  # us
+DRIFT_SPAN = FIRMWARE.get("CLOCK_DRIFT_MIN_SPAN", 10000000)  # us
+MASK = (1 << 64) - 1
+
+
+def monotonic_us():
+    return time.monotonic_ns() // 1000
+
+
+class SimulatedClock:
+    """The host clock with a fixed offset and a rate error, in microseconds."""
+
+    def __init__(self, offset_ms=0.0, drift_ppm=0.0):
+        self.start = monotonic_us()
+        self.offset = int(offset_ms * 1000)
+        self.rate = 1.0 + drift_ppm / 1e6
+
+    def now(self):
+        return (self.start + self.offset + int((monotonic_us() - self.start) * self.rate)) & MASK
+
+
+def open_socket(port, address=""):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    if hasattr(socket, "SO_REUSEPORT"):
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+    sock.bind((address, port))
+    return sock
+
+
+def unpack(data):
+    if len(data) != PACKET.size:
+        return None
+    fields = PACKET.unpack(data)
+    if fields[0] != MAGIC or fields[1] != VERSION:
+        return None
+    return fields[2:]
+
+
+def run_leader(args):
+    clock = SimulatedClock(args.offset_ms, args.drift_ppm)
+    sock = open_socket(args.port, args.bind)
+    sequence = 0
+    next_beacon = 0.0
+    answered = 0
+    print(f"leading on port {args.port}, beacons to {args.broadcast}", flush=True)
+    while True:
+        now = time.monotonic()
+        if now >= next_beacon:
+            sequence = (sequence + 1) & 0xFFFF
+            sock.sendto(PACKET.pack(MAGIC, VERSION, BEACON, sequence, 0, 0, clock.now()),
+                        (args.broadcast, args.port))
+            next_beacon = now + args.interval
+        ready, _, _ = select.select([sock], [], [], max(0.0, next_beacon - time.monotonic()))
+        if not ready:
+            continue
+        data, source = sock.recvfrom(64)
+        arrived = clock.now()
+        packet = unpack(data)
+        if packet is None or packet[0] != REQUEST:
+            continue
+        _, seq, originate, _, _ = packet
+        sock.sendto(PACKET.pack(MAGIC, VERSION, RESPONSE, seq, originate, arrived, clock.now()), source)
+        answered += 1
+        if args.verbose:
+            print(f"answered {source[0]}:{source[1]} ({answered})", flush=True)
+
+
+class Follower:
+    """A copy of the firmware's follower: least-delay sample of the last few, drift from an
+    anchor. For following from a computer; `check` tests the firmware's own."""
+
+    def __init__(self, clock):
+        self.clock = clock
+        self.samples = []
+        self.locked = False
+        self.best = None
+        self.anchor = None
+        self.drift = 0.0
+        self.have_drift = False
+
+    def shared(self):
+        local = self.clock.now()
+        if not self.locked:
+            return local
+        local_at, offset, _ = self.best
+        return local + offset + int(self.drift * (local - local_at))
+
+    def add(self, sample):
+        self.samples = (self.samples + [sample])[-SAMPLES:]
+        if len(self.samples) < MIN_SAMPLES:
+            return
+        candidate = min(self.samples, key=lambda s: s[2])
+        if not self.locked:
+            if candidate[2] > MAX_DELAY:
+                return
+            self.locked = True
+            self.best = self.anchor = candidate
+            return
+        if candidate[0] == self.best[0]:
+            return
+        span = candidate[0] - self.anchor[0]
+        if span >= DRIFT_SPAN:
+            measured = (candidate[1] - self.anchor[1]) / span
+            self.drift = self.drift + (measured - self.drift) / 4 if self.have_drift else measured
+            self.have_drift = True
+            self.anchor = candidate
+        self.best = candidate
+
+
+def run_follower(args):
+    clock = SimulatedClock(args.offset_ms, args.drift_ppm)
+    follower = Follower(clock)
+    beacons = open_socket(args.port)
+    requests = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)  # own port, so replies reach us
+    leader = None
+    sequence = 0
+    next_request = 0.0
+    next_report = time.monotonic() + 1.0
+    worst = 0
+    started = time.monotonic()
+    print(f"following on port {args.port}, offset {args.offset_ms} ms, drift {args.drift_ppm} ppm", flush=True)
+    while args.duration <= 0 or time.monotonic() - started < args.duration:
+        now = time.monotonic()
+        if leader is not None and now >= next_request:
+            sequence = (sequence + 1) & 0xFFFF
+            requests.sendto(PACKET.pack(MAGIC, VERSION, REQUEST, sequence, clock.now(), 0, 0), leader)
+            next_request = now + args.interval
+        ready, _, _ = select.select([beacons, requests], [], [], 0.05)
+        for sock in ready:
+            data, source = sock.recvfrom(64)
+            arrived = clock.now()
+            packet = unpack(data)
+            if packet is None:
+                continue
+            kind, seq, originate, receive, transmit = packet
+            if kind == BEACON and leader is None:
+                leader = (source[0], args.port)
+                next_request = 0.0
+                print(f"following leader {source[0]}", flush=True)
+            elif kind == RESPONSE and seq == sequence:
+                offset = ((receive - originate) + (transmit - arrived)) // 2
+                delay = (arrived - originate) - (transmit - receive)
+                follower.add((originate + (arrived - originate) // 2, offset, max(delay, 0)))
+        if time.monotonic() >= next_report:
+            next_report += 1.0
+            if follower.locked:
+                error = follower.shared() - monotonic_us()
+                if time.monotonic() - started > 3 * args.interval * SAMPLES:
+                    worst = max(worst, abs(error))
+                print(f"offset {follower.best[1] / 1000:.3f} ms, round trip {follower.best[2]} us, "
+                      f"drift {follower.drift * 1e6:.1f} ppm, error {error / 1000:.3f} ms", flush=True)
+    print(f"worst error after settling: {worst / 1000:.3f} ms", flush=True)
+    return 0 if worst < 5000 else 1
+
+
+def follower_clock(index):
+    """Offset in ms and drift in ppm of the index'th follower in a check, all different."""
+    return 500 + 1234 * index, (40, -25)[index % 2] * (1 + index // 2)
+
+
+def read_firmware_lines(process, clocks, loops, echo):
+    """Keeps each `clock` report with the host's clock when it was read, and each `loop`
+    report as passes, ms asleep and ms it covers."""
+    for line in process.stdout:
+        arrived = monotonic_us()
+        if echo:
+            print(f"[{process.pid}] {line}", end="", flush=True)
+        match = re.match(r"Clock sync: shared us (\d+)(.*)", line)
+        if match:
+            locks = re.search(r"locks (\d+)", match.group(2))
+            leading = "leading" in match.group(2)
+            clocks.append((arrived, int(match.group(1)), 1 if leading else int(locks.group(1)) if locks else 0))
+        match = re.match(r"Loop: passes (\d+), slept \d+ times for ms (\d+) of (\d+)", line)
+        if match:
+            loops.append(tuple(int(value) for value in match.groups()))
+
+
+def start_firmware(args, firmware, fs, duration, address, options, serial):
+    """Runs a native build on the real clock with its own address, web server port and
+    filesystem, and an API server that is never there, typing `serial` as MS:TEXT."""
+    cmd = [firmware, "--real", "--seconds", str(duration), "--ip", address,
+           "--listen", str(free_port()), "--server", f"127.0.0.1:{free_port()}", "--fs", fs] + options
+    for line in serial:
+        cmd += ["--serial", line]
+    process = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, text=True)
+    clocks, loops = [], []
+    reader = threading.Thread(target=read_firmware_lines, args=(process, clocks, loops, args.verbose), daemon=True)
+    reader.start()
+    return process, reader, clocks, loops
+
+
+def run_check(args):
+    for firmware in [args.firmware] + ([args.leader] if args.leader else []):
+        if not os.path.exists(firmware):
+            sys.exit(f"no native firmware at {firmware}, build it with pio run -e native (native_leader for --leader)")
+    duration = args.duration if args.duration > 0 else 60.0
+    readings = [f"{second * 1000}:clock" for second in range(1, int(duration))]
+    runs = []
+    with tempfile.TemporaryDirectory() as fs:
+        try:
+            if args.leader:
+                # the last loop report covers the time from the followers locking to the end
+                leader = start_firmware(args, args.leader, os.path.join(fs, "leader"), duration + 1, "127.0.0.1", [],
+                                        readings + ["5000:loop", f"{int(duration) * 1000}:loop"])
+            else:
+                leader = (subprocess.Popen([sys.executable, os.path.abspath(__file__), "leader", "--bind", "127.0.0.1",
+                                            "--broadcast", "127.255.255.255", "--port", str(PORT)],
+                                           stdout=subprocess.DEVNULL), None, None, None)
+            runs.append(leader)
+            followers = []
+            for index in range(args.followers):
+                offset_ms, drift_ppm = follower_clock(index)
+                follower = start_firmware(args, args.firmware, os.path.join(fs, str(index)), duration,
+                                          f"127.0.0.{index + 2}",
+                                          ["--clock-offset", str(offset_ms), "--clock-drift", str(drift_ppm)], readings)
+                runs.append(follower)
+                followers.append((offset_ms, drift_ppm) + follower)
+            for process, reader, _, _ in runs[1:] + (runs[:1] if args.leader else []):
+                process.wait()
+                reader.join()
+        finally:
+            for process, _, _, _ in runs:
+                if process.poll() is None:
+                    process.terminate()
+                    process.wait()
+
+    # The Python leader's clock is the host's monotonic clock; a native leader's is offset
+    # from it by however long it had been running, which its own readings give.
+    leader_offset = 0
+    if args.leader:
+        offsets = sorted(shared - arrived for arrived, shared, _ in leader[2])
+        if not offsets:
+            sys.exit("the leader never reported its clock")
+        leader_offset = offsets[len(offsets) // 2]
+        if leader[3]:
+            passes, slept_ms, span_ms = leader[3][-1]
+            print(f"leader: {passes * 1000 / max(span_ms, 1):.0f} passes a second, "
+                  f"asleep {slept_ms * 100 / max(span_ms, 1):.1f}% of {span_ms} ms")
+
+    failed = False
+    for index, (offset_ms, drift_ppm, _, _, clocks, _) in enumerate(followers):
+        locked = [line for line in clocks if line[2] > 0]
+        if not locked:
+            print(f"follower {index + 1} (offset {offset_ms} ms, drift {drift_ppm} ppm): never locked")
+            failed = True
+            continue
+        settled = [line for line in locked if line[0] - locked[0][0] >= args.settle * 1e6]
+        errors = [shared - arrived - leader_offset for arrived, shared, _ in settled]
+        if not errors:
+            print(f"follower {index + 1}: locked too late to settle, run for longer")
+            failed = True
+            continue
+        worst = max(errors, key=abs)
+        mean = sum(errors) / len(errors)
+        print(f"follower {index + 1} (offset {offset_ms} ms, drift {drift_ppm} ppm): "
+              f"error us mean {mean:.0f}, worst {worst}, over {len(errors)} readings")
+        failed = failed or abs(worst) > args.tolerance_ms * 1000
+    return 1 if failed else 0
+
+
+def free_port():
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("role", choices=["leader", "follower", "check"])
+    parser.add_argument("--port", type=int, default=PORT)
+    parser.add_argument("--broadcast", default="255.255.255.255", help="where the leader sends beacons")
+    parser.add_argument("--bind", default="", help="leader: address to answer on, 127.0.0.1 on loopback")
+    parser.add_argument("--interval", type=float, default=1.0, help="seconds between beacons or requests")
+    parser.add_argument("--offset-ms", type=float, default=0.0, help="simulated clock offset")
+    parser.add_argument("--drift-ppm", type=float, default=0.0, help="simulated clock rate error")
+    parser.add_argument("--duration", type=float, default=0.0,
+                        help="follower: seconds to run, 0 for ever; check: seconds to run, 0 for 60")
+    parser.add_argument("--firmware", default=DEFAULT_FIRMWARE, help="check: native firmware binary")
+    parser.add_argument("--followers", type=int, default=2, help="check: native followers to run")
+    parser.add_argument("--leader", help="check: native build to lead instead of this script, "
+                                         "built with CLOCK_SYNC_LEADER true (pio run -e native_leader)")
+    parser.add_argument("--settle", type=float, default=15.0, help="check: seconds after locking before errors count")
+    parser.add_argument("--tolerance-ms", type=float, default=1.0, help="check: largest error that passes")
+    parser.add_argument("--verbose", action="store_true")
+    args = parser.parse_args()
+    try:
+        if args.role == "check":
+            return run_check(args)
+        return run_leader(args) if args.role == "leader" else run_follower(args)
+    except KeyboardInterrupt:
+        return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
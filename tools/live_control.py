@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""Controls a poi live over its WebSocket channel (include/LiveControl.h), and measures it.
+
+    python3 tools/live_control.py 192.168.1.40 echo --count 1000
+    python3 tools/live_control.py 192.168.1.40 pattern 3
+    python3 tools/live_control.py 192.168.1.40 switch 2
+    python3 tools/live_control.py 192.168.1.40 stop
+    python3 tools/live_control.py 192.168.1.40 seek 30000
+    python3 tools/live_control.py 192.168.1.40 play
+    python3 tools/live_control.py 192.168.1.40 seek 30000 --repeat 200 --interval 30
+
+`echo` sends echo frames with their send time in them, one after the other's reply, and
+reports the round trips; the other commands print the poi's answer and how long it took.
+With --repeat a command is sent that many times, one after the other's reply, and the
+round trips are reported as echo's are. Switches and seeks are answered from loop(), so
+this measures how soon a sleeping loop() picks them up.
+For the native build (pio run -e native) use 127.0.0.1:8180.
+"""
+
+import argparse
+import base64
+import os
+import socket
+import struct
+import sys
+import time
+
+COMMANDS = {"echo": 0, "pattern": 1, "switch": 2, "play": 3, "stop": 4, "seek": 5}
+RESULTS = ["ok", "bad frame", "no timeline", "busy"]
+TARGET_MS = 20  # round trip the channel is meant to stay under
+
+
+class WebSocket:
+    """Just enough of a WebSocket client for binary frames, with no dependencies."""
+
+    def __init__(self, host, path, timeout):
+        address, _, port = host.partition(":")
+        self.sock = socket.create_connection((address, int(port or 80)), timeout=timeout)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        key = base64.b64encode(os.urandom(16)).decode()
+        self.sock.sendall((f"GET {path} HTTP/1.1\r\nHost: {host}\r\nUpgrade: websocket\r\n"
+                           f"Connection: Upgrade\r\nSec-WebSocket-Key: {key}\r\n"
+                           "Sec-WebSocket-Version: 13\r\n\r\n").encode())
+        head = b""
+        while b"\r\n\r\n" not in head:
+            data = self.sock.recv(1024)
+            if not data:
+                sys.exit("connection closed during the handshake")
+            head += data
+        head, _, self.buffer = head.partition(b"\r\n\r\n")
+        if not head.startswith(b"HTTP/1.1 101"):
+            sys.exit(f"not upgraded: {head.splitlines()[0].decode(errors='replace')}")
+
+    def send(self, payload):
+        mask = os.urandom(4)
+        length = len(payload)
+        if length < 126:
+            header = struct.pack("!BB", 0x82, 0x80 | length)
+        else:
+            header = struct.pack("!BBH", 0x82, 0x80 | 126, length)
+        masked = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        self.sock.sendall(header + mask + masked)
+
+    def receive(self):
+        """Returns the payload of the next data frame."""
+        while True:
+            first, length = self.read(2)
+            header = b""
+            if length & 0x7F == 126:
+                header = self.read(2)
+                length = struct.unpack("!H", header)[0]
+            elif length & 0x7F == 127:
+                header = self.read(8)
+                length = struct.unpack("!Q", header)[0]
+            else:
+                length &= 0x7F
+            payload = self.read(length)
+            opcode = first & 0x0F
+            if opcode == 0x8:
+                sys.exit("the poi closed the connection")
+            if opcode in (0x1, 0x2):
+                return payload
+
+    def read(self, count):
+        while len(self.buffer) < count:
+            data = self.sock.recv(4096)
+            if not data:
+                sys.exit("connection closed")
+            self.buffer += data
+        data, self.buffer = self.buffer[:count], self.buffer[count:]
+        return data
+
+
+def percentile(values, percent):
+    ordered = sorted(values)
+    rank = max(1, -(-len(ordered) * percent // 100))  # nearest rank
+    return ordered[rank - 1]
+
+
+def echo(ws, args):
+    padding = bytes(max(0, args.size - 10))
+    rtts = []
+    for seq in range(args.count):
+        sent = time.perf_counter_ns()
+        ws.send(struct.pack("<BBQ", 0, seq & 0xFF, sent) + padding)
+        reply = ws.receive()
+        now = time.perf_counter_ns()
+        if reply[0] != 0x80 or reply[1] != seq & 0xFF:
+            sys.exit(f"unexpected reply {reply[:3].hex()} to echo {seq}")
+        rtts.append((now - struct.unpack_from("<Q", reply, 2)[0]) / 1e6)
+        if args.interval:
+            time.sleep(args.interval / 1000)
+    over = sum(1 for rtt in rtts if rtt > TARGET_MS)
+    print(f"{len(rtts)} echoes of {max(args.size, 10)} bytes, round trip ms: min {min(rtts):.2f}, "
+          f"p50 {percentile(rtts, 50):.2f}, p90 {percentile(rtts, 90):.2f}, p99 {percentile(rtts, 99):.2f}, "
+          f"max {max(rtts):.2f}; over {TARGET_MS} ms: {over}")
+    return 1 if args.max_p99 is not None and percentile(rtts, 99) > args.max_p99 else 0
+
+
+def command(ws, args):
+    code = COMMANDS[args.command]
+    arguments = b""
+    if args.command == "pattern":
+        arguments = struct.pack("<B", args.value)
+    elif args.command in ("switch", "seek"):
+        arguments = struct.pack("<I", args.value)
+    rtts = []
+    for seq in range(1, args.repeat + 1):
+        sent = time.perf_counter()
+        ws.send(struct.pack("<BB", code, seq & 0xFF) + arguments)
+        reply = ws.receive()
+        took = (time.perf_counter() - sent) * 1000
+        result = RESULTS[reply[2]] if len(reply) > 2 and reply[2] < len(RESULTS) else reply.hex()
+        if args.repeat == 1:
+            print(f"{args.command}: {result} in {took:.2f} ms")
+        if result != "ok":
+            if args.repeat > 1:
+                print(f"{args.command} {seq}: {result}")
+            return 1
+        rtts.append(took)
+        if args.interval:
+            time.sleep(args.interval / 1000)
+    if args.repeat > 1:
+        over = sum(1 for rtt in rtts if rtt > TARGET_MS)
+        print(f"{len(rtts)} {args.command} commands, round trip ms: min {min(rtts):.2f}, "
+              f"p50 {percentile(rtts, 50):.2f}, p90 {percentile(rtts, 90):.2f}, p99 {percentile(rtts, 99):.2f}, "
+              f"max {max(rtts):.2f}; over {TARGET_MS} ms: {over}")
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host", help="poi address, HOST or HOST:PORT")
+    parser.add_argument("--path", default="/live", help="WebSocket path (default /live)")
+    parser.add_argument("--timeout", type=float, default=5, help="seconds to wait for a reply")
+    commands = parser.add_subparsers(dest="command", required=True)
+    measure = commands.add_parser("echo", help="measure round trips")
+    measure.add_argument("--count", type=int, default=200, help="echoes to send (default 200)")
+    measure.add_argument("--size", type=int, default=10, help="bytes per frame (default 10, the least)")
+    measure.add_argument("--interval", type=float, default=0, help="ms to wait between echoes")
+    measure.add_argument("--max-p99", type=float, help="exit 1 if the p99 round trip is above this many ms")
+    others = [
+        commands.add_parser("pattern", help="show a pattern now"),
+        commands.add_parser("switch", help="switch timeline"),
+        commands.add_parser("play", help="start playback"),
+        commands.add_parser("stop", help="stop playback, holding the colour"),
+        commands.add_parser("seek", help="play from a point"),
+    ]
+    others[0].add_argument("value", type=int, help="pattern 0-13, 14 off")
+    others[1].add_argument("value", type=int, help="timeline number")
+    others[4].add_argument("value", type=int, help="ms into the timeline")
+    for other in others:
+        other.add_argument("--repeat", type=int, default=1, help="times to send it, reporting the round trips")
+        other.add_argument("--interval", type=float, default=0, help="ms to wait between repeats")
+    args = parser.parse_args()
+
+    ws = WebSocket(args.host, args.path, args.timeout)
+    return echo(ws, args) if args.command == "echo" else command(ws, args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Local SNTP server for testing scheduled timeline starts (see include/WallClock.h).
+
+Serves this computer's clock, optionally shifted, so poi can be pointed at it with
+`#define NTP_SERVER "<this computer's IP>"` in secrets.h. Port 123 needs root:
+
+    sudo python3 tools/ntp_server.py serve
+    python3 tools/ntp_server.py serve --port 12300 --offset-ms 2500
+
+Check a server, this one or any other, the way the poi see it:
+
+    python3 tools/ntp_server.py query 127.0.0.1 --port 12300
+"""
+
+import argparse
+import socket
+import struct
+import sys
+import time
+
+NTP_EPOCH_OFFSET = 2208988800  # seconds from 1900-01-01 to 1970-01-01
+PACKET = struct.Struct("!BBbbII4sQQQQ")  # flags, stratum, poll, precision, root delay,
+                                          # root dispersion, reference id, 4 timestamps
+
+
+def to_ntp(unix_seconds):
+    return int((unix_seconds + NTP_EPOCH_OFFSET) * (1 << 32))
+
+
+def from_ntp(timestamp):
+    return timestamp / (1 << 32) - NTP_EPOCH_OFFSET
+
+
+def serve(args):
+    offset = args.offset_ms / 1000.0
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind((args.bind, args.port))
+    print(f"serving time on port {args.port}, offset {args.offset_ms} ms", flush=True)
+    while True:
+        data, source = sock.recvfrom(512)
+        received = time.time() + offset
+        if len(data) < PACKET.size or data[0] & 0x07 != 3:  # client mode only
+            continue
+        client_transmit = PACKET.unpack(data[:PACKET.size])[10]
+        reply = PACKET.pack(
+            (data[0] & 0x38) | 4,  # no leap warning, the client's version, server mode
+            1,                     # stratum 1: a reference clock
+            data[2], -20,          # client's poll interval, precision about a microsecond
+            0, 0, b"LOCL",
+            to_ntp(received), client_transmit, to_ntp(received), to_ntp(time.time() + offset))
+        sock.sendto(reply, source)
+        if args.verbose:
+            print(f"answered {source[0]}:{source[1]}", flush=True)
+
+
+def query(args):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(2.0)
+    sent = time.time()
+    sock.sendto(PACKET.pack(0x23, 0, 0, 0, 0, 0, b"\0\0\0\0", 0, 0, 0, to_ntp(sent)), (args.host, args.port))
+    data, _ = sock.recvfrom(512)
+    arrived = time.time()
+    fields = PACKET.unpack(data[:PACKET.size])
+    receive, transmit = from_ntp(fields[9]), from_ntp(fields[10])
+    offset = ((receive - sent) + (transmit - arrived)) / 2
+    delay = (arrived - sent) - (transmit - receive)
+    print(f"stratum {fields[1]}, offset {offset * 1000:.3f} ms, round trip {delay * 1000:.3f} ms")
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+    server = commands.add_parser("serve")
+    server.add_argument("--port", type=int, default=123)
+    server.add_argument("--bind", default="")
+    server.add_argument("--offset-ms", type=float, default=0.0, help="shift the time served")
+    server.add_argument("--verbose", action="store_true")
+    client = commands.add_parser("query")
+    client.add_argument("host")
+    client.add_argument("--port", type=int, default=123)
+    args = parser.parse_args()
+    try:
+        return serve(args) if args.command == "serve" else query(args)
+    except KeyboardInterrupt:
+        return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Stand-in for the magic poi API, for the native env (see lib/NativeHal/src/NativeHal.h).
+
+Serves the endpoints the firmware calls, over HTTP/1.1 with keep-alive, so a native run
+exercises the same requests, connection reuse and chunked bodies as a poi on Wi-Fi:
+
+    POST /api/login                             {"token": "<JWT with an exp claim>"}
+    GET  /lite/api/get-current-timeline-number  the current timeline number
+    GET  /lite/api/timeline-manifest            {"<number>": "<SHA-1 of the JSON>", ...}
+    GET  /lite/api/load-timeline?number=N       the timeline JSON, {"<ms>": [r, g, b], ...}
+
+Timelines are read from DIR/<number>.json, or made up if no directory is given:
+
+    python3 tools/stub_api_server.py
+    python3 tools/stub_api_server.py --timelines my_timelines --current 2 --chunked
+
+--shuffle sends the events of each made-up timeline out of order, so the firmware has to
+sort them; the timings are all different, so the sorted timeline is the same.
+"""
+
+import argparse
+import base64
+import hashlib
+import json
+import os
+import random
+import time
+from email.utils import formatdate
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlparse
+
+CHUNK_SIZE = 512  # bytes per chunk with --chunked, small enough to split events
+
+
+def demo_timelines(count, events, seed, shuffle=False):
+    """Makes up `count` timelines of `events` pattern changes each, the same for a seed."""
+    rng = random.Random(seed)
+    timelines = {}
+    for number in range(1, count + 1):
+        at = 0
+        body = []
+        for _ in range(events):
+            at += rng.randint(100, 3000)
+            body.append((str(at), [rng.randint(0, 13), 0, 0]))
+        if shuffle:
+            random.Random(seed + number).shuffle(body)
+        timelines[str(number)] = json.dumps(dict(body)).encode()
+    return timelines
+
+
+def load_timelines(directory):
+    timelines = {}
+    for name in sorted(os.listdir(directory)):
+        number, extension = os.path.splitext(name)
+        if extension == ".json" and number.isdigit():
+            with open(os.path.join(directory, name), "rb") as f:
+                timelines[number] = f.read()
+    return timelines
+
+
+def make_token(lifetime):
+    def part(value):
+        return base64.urlsafe_b64encode(json.dumps(value).encode()).rstrip(b"=").decode()
+    claims = {"sub": "native", "exp": int(time.time()) + lifetime}
+    return part({"alg": "none", "typ": "JWT"}) + "." + part(claims) + ".stub"
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"  # keep-alive, as the firmware expects
+
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", 0))
+        self.rfile.read(length)
+        if urlparse(self.path).path == "/api/login":
+            self.reply(200, json.dumps({"token": make_token(self.server.args.token_lifetime)}).encode())
+        else:
+            self.reply(404, b"not found")
+
+    def do_GET(self):
+        url = urlparse(self.path)
+        timelines = self.server.timelines
+        if url.path == "/lite/api/get-current-timeline-number":
+            self.reply(200, str(self.server.args.current).encode())
+        elif url.path == "/lite/api/timeline-manifest":
+            manifest = {n: hashlib.sha1(body).hexdigest() for n, body in timelines.items()}
+            self.reply(200, json.dumps(manifest).encode())
+        elif url.path == "/lite/api/load-timeline":
+            number = parse_qs(url.query).get("number", [""])[0]
+            if number in timelines:
+                self.reply(200, timelines[number], self.server.args.chunked)
+            else:
+                self.reply(404, b"no such timeline")
+        else:
+            self.reply(404, b"not found")
+
+    def reply(self, code, body, chunked=False):
+        self.send_response(code)
+        self.send_header("Content-Type", "application/json")
+        if chunked:
+            self.send_header("Transfer-Encoding", "chunked")
+        else:
+            self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        if chunked:
+            for at in range(0, len(body), CHUNK_SIZE):
+                chunk = body[at:at + CHUNK_SIZE]
+                self.wfile.write(b"%x\r\n%s\r\n" % (len(chunk), chunk))
+            self.wfile.write(b"0\r\n\r\n")
+        else:
+            self.wfile.write(body)
+
+    def date_time_string(self, timestamp=None):
+        return formatdate(timestamp, usegmt=True)
+
+    def log_message(self, format, *args):
+        if self.server.args.verbose:
+            super().log_message(format, *args)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--bind", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--timelines", metavar="DIR", help="directory of <number>.json timelines")
+    parser.add_argument("--count", type=int, default=3, help="made-up timelines (default 3)")
+    parser.add_argument("--events", type=int, default=200, help="events per made-up timeline (default 200)")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--shuffle", action="store_true", help="send made-up timelines' events out of order")
+    parser.add_argument("--current", type=int, default=1, help="current timeline number (default 1)")
+    parser.add_argument("--chunked", action="store_true", help="send timelines with chunked encoding")
+    parser.add_argument("--token-lifetime", type=int, default=3600, help="JWT lifetime in seconds")
+    parser.add_argument("--verbose", action="store_true", help="log every request")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer((args.bind, args.port), Handler)
+    server.args = args
+    server.timelines = load_timelines(args.timelines) if args.timelines else demo_timelines(args.count, args.events, args.seed, args.shuffle)
+    print(f"serving {len(server.timelines)} timelines on {args.bind}:{args.port}", flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
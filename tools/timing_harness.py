@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+"""Checks that timeline playback changes the LEDs on time, against a golden trace.
+
+Runs the native build of the firmware (pio run -e native) on its virtual clock against
+tools/stub_api_server.py, with the LED pins traced (see lib/NativeHal/src/NativeHal.h).
+A run without stalls is saved as the golden trace; later runs, with loop() held up by
+injected stalls or after a code change, are compared with it transition by transition:
+
+    python3 tools/timing_harness.py record golden.trace
+    python3 tools/timing_harness.py check golden.trace --stall 20000:300:2500 --max-late 5
+    python3 tools/timing_harness.py compare golden.trace other.trace
+
+Out-of-order timelines, which the firmware sorts a slice at a time while the current one
+plays, are checked against a golden trace of the same timelines sent in order:
+
+    python3 tools/timing_harness.py --events 5000 record golden.trace
+    python3 tools/timing_harness.py --events 5000 check golden.trace --shuffle --max-pass 5
+
+Each golden transition is matched with the next transition to the same LED levels in the
+run, within --window ms. The report gives how late the matched ones were, the golden
+transitions that never happened (missed) and the run's transitions that matched nothing
+(extra: duplicated or spurious changes). The longest loop() pass is given in host CPU time,
+since the virtual clock does not move while the firmware computes; --max-pass fails a run
+with a pass that long, e.g. one that sorts a whole timeline at once.
+"""
+
+import argparse
+import os
+import re
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_FIRMWARE = os.path.join(HERE, "..", ".pio", "build", "native", "program")
+
+
+def read_trace(path):
+    transitions = []
+    with open(path) as f:
+        for line in f:
+            if line.startswith("#") or not line.strip():
+                continue
+            us, red, green, blue = (int(v) for v in line.split())
+            transitions.append((us, (red, green, blue)))
+    return transitions
+
+
+def free_port():
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def run_firmware(args, trace_path, stalls, shuffle=False):
+    """Runs the firmware once, from an empty filesystem, writing its LED trace.
+
+    Returns the host CPU time of its longest loop() pass, in ms.
+    """
+    port = free_port()
+    server_cmd = [sys.executable, os.path.join(HERE, "stub_api_server.py"), "--port", str(port),
+                  "--seed", str(args.seed), "--events", str(args.events)]
+    if args.timelines:
+        server_cmd += ["--timelines", args.timelines]
+    if shuffle:
+        server_cmd += ["--shuffle"]
+    server = subprocess.Popen(server_cmd, stdout=subprocess.DEVNULL)
+    try:
+        for _ in range(50):  # until the server is listening
+            try:
+                socket.create_connection(("127.0.0.1", port), timeout=0.1).close()
+                break
+            except OSError:
+                time.sleep(0.1)
+        with tempfile.TemporaryDirectory() as fs:
+            cmd = [args.firmware, "--quiet", "--seconds", str(args.seconds),
+                   "--server", f"127.0.0.1:{port}", "--fs", fs, "--trace", trace_path]
+            for stall in stalls:
+                cmd += ["--stall", stall]
+            result = subprocess.run(cmd, stderr=subprocess.PIPE, text=True)
+            sys.stderr.write(result.stderr)
+            if result.returncode != 0:
+                sys.exit(f"firmware exited with {result.returncode}")
+            longest = re.search(r"longest loop pass, us of host CPU (\d+)", result.stderr)
+            return int(longest.group(1)) / 1000 if longest else None
+    finally:
+        server.terminate()
+        server.wait()
+
+
+def percentile(values, percent):
+    ordered = sorted(values)
+    rank = max(1, -(-len(ordered) * percent // 100))  # nearest rank
+    return ordered[rank - 1]
+
+
+def compare(golden, run, window_ms):
+    """Matches the run's transitions to the golden ones, in order."""
+    window = window_ms * 1000
+    lateness = []
+    missed = 0
+    extra = 0
+    j = 0
+    for at, levels in golden:
+        k = j
+        while k < len(run) and run[k][0] <= at + window:
+            if run[k][1] == levels and run[k][0] >= at - window:
+                break
+            k += 1
+        if k < len(run) and run[k][0] <= at + window:
+            extra += k - j
+            lateness.append(run[k][0] - at)
+            j = k + 1
+        else:
+            missed += 1
+    extra += len(run) - j
+    return lateness, missed, extra
+
+
+def report(golden, run, args, longest_pass=None):
+    lateness, missed, extra = compare(golden, run, args.window)
+    print(f"golden transitions {len(golden)}, run transitions {len(run)}")
+    if longest_pass is not None:
+        print(f"longest loop() pass: {longest_pass:.3f} ms of host CPU")
+    print(f"matched {len(lateness)}, missed {missed}, extra {extra}")
+    late_ms = [us / 1000 for us in lateness]
+    if late_ms:
+        print(f"lateness ms: mean {sum(late_ms) / len(late_ms):.3f}, p50 {percentile(late_ms, 50):.3f}, "
+              f"p99 {percentile(late_ms, 99):.3f}, max {max(late_ms):.3f}, earliest {min(late_ms):.3f}")
+    failed = missed > args.max_missed or extra > args.max_extra
+    if args.max_late is not None and late_ms and max(late_ms) > args.max_late:
+        failed = True
+    if args.max_pass is not None and longest_pass is not None and longest_pass > args.max_pass:
+        failed = True
+    if failed:
+        print("FAIL")
+    return 1 if failed else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--firmware", default=DEFAULT_FIRMWARE, help="native firmware binary")
+    parser.add_argument("--seconds", type=float, default=60, help="virtual seconds to run (default 60)")
+    parser.add_argument("--timelines", metavar="DIR", help="timelines to serve, see stub_api_server.py")
+    parser.add_argument("--events", type=int, default=200, help="events per made-up timeline")
+    parser.add_argument("--seed", type=int, default=1, help="seed for the made-up timelines")
+    parser.add_argument("--window", type=float, default=1000, help="ms either side to look for a match")
+    parser.add_argument("--max-late", type=float, help="fail if any transition is more ms late than this")
+    parser.add_argument("--max-missed", type=int, default=0, help="fail above this many missed (default 0)")
+    parser.add_argument("--max-extra", type=int, default=0, help="fail above this many extra (default 0)")
+    parser.add_argument("--max-pass", type=float, help="fail if a loop() pass takes more ms of host CPU than this")
+    commands = parser.add_subparsers(dest="command", required=True)
+    record = commands.add_parser("record", help="run without stalls and save the golden trace")
+    record.add_argument("golden")
+    check = commands.add_parser("check", help="run, with stalls if given, and compare with a golden trace")
+    check.add_argument("golden")
+    check.add_argument("--stall", action="append", default=[], metavar="AT:MS[:EVERY]")
+    check.add_argument("--keep", metavar="TRACE", help="keep the run's trace in this file")
+    check.add_argument("--shuffle", action="store_true", help="serve the timelines' events out of order")
+    offline = commands.add_parser("compare", help="compare two saved traces")
+    offline.add_argument("golden")
+    offline.add_argument("trace")
+    args = parser.parse_args()
+
+    if args.command == "record":
+        run_firmware(args, args.golden, [])
+        print(f"golden trace: {len(read_trace(args.golden))} transitions in {args.golden}")
+        return 0
+    if args.command == "compare":
+        return report(read_trace(args.golden), read_trace(args.trace), args)
+
+    trace = args.keep or tempfile.NamedTemporaryFile(suffix=".trace", delete=False).name
+    try:
+        longest_pass = run_firmware(args, trace, args.stall, args.shuffle)
+        return report(read_trace(args.golden), read_trace(trace), args, longest_pass)
+    finally:
+        if not args.keep:
+            os.unlink(trace)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
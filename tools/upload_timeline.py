@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Uploads a timeline to a poi over the LAN, through its local API (include/LocalApi.h).
+
+Sends the timeline JSON, {"<ms>": [r, g, b], ...} as served by load-timeline, to
+POST /api/timeline, then polls GET /api/status until the poi has compiled it:
+
+    python3 tools/upload_timeline.py 192.168.1.40 show.json --number 4 --play
+    python3 tools/upload_timeline.py 127.0.0.1:8180 show.json --number 4
+
+The second form is the native build (pio run -e native), which listens on 8180.
+"""
+
+import argparse
+import json
+import sys
+import time
+from http.client import HTTPConnection
+
+POLL_INTERVAL = 0.05  # seconds between status requests
+
+
+def request(host, method, path, body=None):
+    connection = HTTPConnection(host, timeout=10)
+    try:
+        headers = {"Content-Type": "application/json"} if body is not None else {}
+        connection.request(method, path, body=body, headers=headers)
+        response = connection.getresponse()
+        return response.status, response.read().decode(errors="replace")
+    finally:
+        connection.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host", help="poi address, HOST or HOST:PORT")
+    parser.add_argument("timeline", help="timeline JSON file")
+    parser.add_argument("--number", required=True, help="timeline number to save it as")
+    parser.add_argument("--play", action="store_true", help="switch to it once it is saved")
+    parser.add_argument("--timeout", type=float, default=30, help="seconds to wait for it to compile")
+    args = parser.parse_args()
+
+    with open(args.timeline, "rb") as f:
+        body = f.read()
+    path = f"/api/timeline?number={args.number}" + ("&play=1" if args.play else "")
+    started = time.monotonic()
+    status, text = request(args.host, "POST", path, body)
+    sent = time.monotonic()
+    if status != 202:
+        sys.exit(f"upload refused: {status} {text}")
+    print(f"sent {len(body)} bytes in {(sent - started) * 1000:.0f} ms: {text}")
+
+    while time.monotonic() - sent < args.timeout:
+        status, text = request(args.host, "GET", "/api/status")
+        upload = json.loads(text) if status == 200 else {}
+        if upload.get("number") == args.number and upload.get("upload") in ("done", "failed"):
+            break
+        time.sleep(POLL_INTERVAL)
+    else:
+        sys.exit("timed out waiting for the poi to compile the timeline")
+    if upload["upload"] == "failed":
+        sys.exit(f"poi could not save the timeline: {text}")
+    print(f"timeline {args.number} saved: {upload['received']} events received, {upload['compiled']} compiled, "
+          f"{(time.monotonic() - started) * 1000:.0f} ms in all ({upload['ms']} ms on the poi)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())